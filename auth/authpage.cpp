@@ -0,0 +1,77 @@
+#include "authpage.hpp"
+
+AuthPage::AuthPage(const QUrl &url, QWidget *parent)
+        : QWebEngineView(parent),
+          m_load_count(0),
+          m_finished(false)
+{
+    pageAction(QWebEnginePage::ViewSource)->setEnabled(false);
+    pageAction(QWebEnginePage::SavePage)->setEnabled(false);
+    pageAction(QWebEnginePage::InspectElement)->setEnabled(false);
+    pageAction(QWebEnginePage::DownloadMediaToDisk)->setEnabled(false);
+    pageAction(QWebEnginePage::DownloadImageToDisk)->setEnabled(false);
+    pageAction(QWebEnginePage::DownloadLinkToDisk)->setEnabled(false);
+    //OpenLinkInNewBackgroundTab OpenLinkInNewTab OpenLinkInNewWindow OpenLinkInThisWindow
+    //Reload?
+
+    //Initialize page object with off-the-record profile, i.e., private mode
+    //profile should not be deleted before page; therefore connecting delete...
+    //[WARNING] Release of profile requested but WebEnginePage still not deleted. Expect troubles !
+    QWebEngineProfile *profile = new QWebEngineProfile(); //temp. profile
+    QWebEnginePage *page = new QWebEnginePage(profile, this);
+    connect(this, SIGNAL(destroyed()), profile, SLOT(deleteLater()));
+    setPage(page);
+    page->setUrl(url);
+
+    setWindowTitle(tr("AUTHENTICATION"));
+    connect(this, &QWebEngineView::titleChanged, this, &QWidget::setWindowTitle);
+    connect(this, SIGNAL(loadFinished(bool)), SLOT(handleLoadedPage(bool)));
+}
+
+void
+AuthPage::closeEvent(QCloseEvent *event)
+{
+    //Closed by the user, no result
+    if (!m_finished)
+        QApplication::exit(1);
+    QWebEngineView::closeEvent(event);
+}
+
+void
+AuthPage::handleLoadedPage(bool ok)
+{
+    //A page has been loaded, first load is initial page (login form)
+    //second one is usually the expected result page
+    m_load_count++;
+    qInfo() << "page loaded" << ok << url().url() << "step" << m_load_count;
+
+    //count - first page is login page with username/password fields
+    //after entering credentials and confirming, that's the second page
+    //then we grab the result and forward it to be evaluated
+    //(action plan continues, finishes)
+    if (m_load_count == 2)
+    {
+        //final step
+        qInfo() << "final step, finishing action...";
+        QVariantMap map;
+        map["url"] = url().url();
+        map["ok"] = ok;
+        page()->toPlainText([this, map](const QString &text)
+        {
+            QVariantMap map2(map);
+            map2["text"] = text;
+            finish(map2);
+        });
+    }
+}
+
+void
+AuthPage::finish(const QVariantMap &result)
+{
+    if (m_finished) return;
+    m_finished = true;
+    QByteArray json = QJsonDocument::fromVariant(result).toJson(QJsonDocument::Compact);
+    fprintf(stdout, "%s\n", json.constData());
+    fflush(stdout);
+    QApplication::exit(0);
+}
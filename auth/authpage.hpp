@@ -0,0 +1,67 @@
+#ifndef AUTHPAGE_HPP
+#define AUTHPAGE_HPP
+
+#include <stdio.h>
+
+#include <QDebug>
+#include <QApplication>
+#include <QTimer>
+#include <QJsonDocument>
+#include <QCloseEvent>
+#include <QWebEngineView>
+#include <QWebEngineProfile>
+#include <QWebEnginePage>
+
+/**
+ * AuthPage shows the login page of a site (load_auth action),
+ * in the peerplayer-auth helper process, so that the player itself
+ * doesn't load QtWebEngine.
+ *
+ * The first page is the login form, the page loaded after that is the
+ * result. It's written to stdout as JSON {url, ok, text}, then the
+ * helper exits (code 0). Closing the window exits with code 1.
+ *
+ * QWebEngineProfile is a bit difficult to get running.
+ * The QtWebEngineProcess executable should be copied to the bin/ directory,
+ * otherwise the application may crash even if QTWEBENGINEPROCESS_PATH is set.
+ *
+ * The bin/ directory should contain a Qt config file called qt.conf:
+ * [Paths]
+ * Data = /build/.../qtwebengine/src/core/release
+ * Translations = /build/.../qtwebengine/src/core/release
+ *
+ * qDebug() << QLibraryInfo::location(QLibraryInfo::DataPath);
+ * qDebug() << QLibraryInfo::location(QLibraryInfo::TranslationsPath);
+ */
+class AuthPage : public QWebEngineView
+{
+    Q_OBJECT
+
+public:
+
+    AuthPage(const QUrl &url, QWidget *parent = 0);
+
+protected:
+
+    void
+    closeEvent(QCloseEvent *event);
+
+private slots:
+
+    void
+    handleLoadedPage(bool ok);
+
+private:
+
+    void
+    finish(const QVariantMap &result);
+
+    int
+    m_load_count;
+
+    bool
+    m_finished;
+
+};
+
+#endif
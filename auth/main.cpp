@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+#include <QApplication>
+#include <QCommandLineParser>
+
+#include "authpage.hpp"
+
+static void
+logMessage(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    //stdout is for the result, log goes to stderr
+    Q_UNUSED(context);
+    const char *prefix = "";
+    switch (type)
+    {
+    case QtDebugMsg: prefix = "[DEBUG]"; break;
+    case QtInfoMsg: prefix = "[INFO]"; break;
+    case QtWarningMsg: prefix = "[WARNING]"; break;
+    case QtCriticalMsg: prefix = "[CRITICAL]"; break;
+    case QtFatalMsg: prefix = "[FATAL]"; break;
+    }
+    fprintf(stderr, "[auth] %s %s\n", prefix, msg.toLocal8Bit().constData());
+}
+
+int main(int argc, char *argv[])
+{
+    //Started by the player for a load_auth action, see AuthPage
+    QApplication app(argc, argv);
+    app.setApplicationName(PROGRAM);
+    qInstallMessageHandler(logMessage);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("PeerPlayer login page, prints the result as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("url", "Address of the login page.");
+    parser.process(app);
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(2);
+
+    AuthPage page(QUrl(parser.positionalArguments().first()));
+    page.resize(800, 600);
+    page.show();
+
+    return app.exec();
+}
@@ -0,0 +1,69 @@
+#define DEFINE_GLOBALS
+#include <stdio.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+#include "version.hpp"
+
+#include "peerplayercli.hpp"
+
+static bool verbose = false;
+
+static void
+logMessage(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    //stdout is for the result, log goes to stderr (debug messages only if verbose)
+    Q_UNUSED(context);
+    if ((type == QtDebugMsg || type == QtInfoMsg) && !verbose) return;
+    const char *prefix = "";
+    switch (type)
+    {
+    case QtDebugMsg: prefix = "[DEBUG]"; break;
+    case QtInfoMsg: prefix = "[INFO]"; break;
+    case QtWarningMsg: prefix = "[WARNING]"; break;
+    case QtCriticalMsg: prefix = "[CRITICAL]"; break;
+    case QtFatalMsg: prefix = "[FATAL]"; break;
+    }
+    fprintf(stderr, "%s %s\n", prefix, msg.toLocal8Bit().constData());
+}
+
+int main(int argc, char *argv[])
+{
+    //No QApplication, no widgets - runs on a server without display
+    QCoreApplication app(argc, argv);
+    //Same name as the player, so the same profile (config dir) is used
+    app.setApplicationName(PROGRAM);
+    app.setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("PeerPlayer without GUI, prints JSON.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command",
+        "action <address> <action> [KEY=value ...] | refresh | feed | search <words> | download <address> [...]");
+    QCommandLineOption opt_limit("limit", "Maximum number of items (feed, search).", "n", "100");
+    QCommandLineOption opt_timeout("timeout", "Seconds until the command is aborted (0 = none).", "seconds", "120");
+    QCommandLineOption opt_pretty("pretty", "Indented JSON output.");
+    QCommandLineOption opt_verbose(QStringList() << "v" << "verbose", "Log messages on stderr.");
+    parser.addOption(opt_limit);
+    parser.addOption(opt_timeout);
+    parser.addOption(opt_pretty);
+    parser.addOption(opt_verbose);
+    parser.process(app);
+
+    verbose = parser.isSet(opt_verbose);
+    qInstallMessageHandler(logMessage);
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(2);
+
+    ProfileSettings::useDefaultProfile();
+
+    PeerPlayerCli cli(parser.positionalArguments());
+    cli.setLimit(parser.value(opt_limit).toInt());
+    cli.setTimeout(parser.value(opt_timeout).toInt());
+    cli.setPrettyOutput(parser.isSet(opt_pretty));
+    QTimer::singleShot(0, &cli, SLOT(run()));
+
+    return app.exec();
+}
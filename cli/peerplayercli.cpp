@@ -0,0 +1,313 @@
+#include "peerplayercli.hpp"
+
+PeerPlayerCli::PeerPlayerCli(const QStringList &args, QObject *parent)
+             : QObject(parent),
+               m_args(args),
+               m_limit(100),
+               m_pretty(false),
+               m_finished(false),
+               m_storage(0)
+{
+    m_tmr_timeout = new QTimer(this);
+    m_tmr_timeout->setSingleShot(true);
+    m_tmr_timeout->setInterval(120 * 1000);
+    connect(m_tmr_timeout, SIGNAL(timeout()), SLOT(timeout()));
+}
+
+void
+PeerPlayerCli::setLimit(int limit)
+{
+    m_limit = limit;
+}
+
+void
+PeerPlayerCli::setPrettyOutput(bool pretty)
+{
+    m_pretty = pretty;
+}
+
+void
+PeerPlayerCli::setTimeout(int seconds)
+{
+    m_tmr_timeout->setInterval(seconds * 1000);
+}
+
+void
+PeerPlayerCli::run()
+{
+    QString command = m_args.value(0);
+    if (m_tmr_timeout->interval() > 0)
+        m_tmr_timeout->start();
+
+    if (command == "action")
+        runAction();
+    else if (command == "refresh")
+        refreshFeed();
+    else if (command == "feed")
+        showFeed();
+    else if (command == "search")
+        search();
+    else if (command == "download")
+        download();
+    else
+        fail(QString("unknown command: %1").arg(command), 2);
+}
+
+void
+PeerPlayerCli::timeout()
+{
+    fail("timeout");
+}
+
+void
+PeerPlayerCli::runAction()
+{
+    if (m_args.size() < 3)
+        return fail("usage: action <address> <action> [KEY=value ...]", 2);
+    QString address = m_args[1];
+    QString action = m_args[2];
+
+    //Variables of the action plan, override the site's (PAGE_NUMBER=2)
+    QVariantMap params;
+    foreach (const QString &arg, m_args.mid(3))
+    {
+        int pos = arg.indexOf('=');
+        if (pos < 1) return fail(QString("invalid parameter: %1").arg(arg), 2);
+        params[arg.left(pos)] = arg.mid(pos + 1);
+    }
+
+    m_site = VSite::load(address, this);
+    if (!m_site) return fail(QString("address not recognized: %1").arg(address));
+    if (!m_site->hasAction(action)) return fail(QString("action not defined for this site: %1").arg(action));
+
+    //Channel actions need the channel info (get_channel) first, as in the channel view
+    if (action == "get_channel" || !action.contains("channel") || m_site->currentChannel().isEmpty())
+        return callAction(action, params);
+    ActionContextPtr ctx = m_site->loadChannel();
+    if (!ctx) return fail("cannot load channel");
+    ctx->enableSignal();
+    connect(ctx.data(), &ActionContext::finished, this, [this, action, params](const QVariant &value)
+    {
+        if (value.canConvert<QVariantMap>())
+            m_site->setChannel(value.toMap());
+        else
+            m_site->setChannel(value.toString());
+        callAction(action, params);
+    });
+    connect(ctx.data(), &ActionContext::failed, this, [this]()
+    {
+        fail("failed to load channel");
+    });
+}
+
+void
+PeerPlayerCli::callAction(const QString &action, const QVariantMap &params)
+{
+    ActionContextPtr ctx = m_site->callAsync(action, params);
+    if (!ctx) return fail(QString("cannot start action: %1").arg(action));
+    ctx->enableSignal(); //result via ctx, started after a short delay
+    connect(ctx.data(), &ActionContext::finished, this, [this, action](const QVariant &value)
+    {
+        QVariantMap result;
+        result["site"] = m_site->siteUrl().url();
+        result["channel"] = m_site->currentChannel();
+        result["action"] = action;
+        result["result"] = value;
+        finish(result);
+    });
+    connect(ctx.data(), &ActionContext::failed, this, [this, action]()
+    {
+        fail(QString("action failed: %1").arg(action));
+    });
+}
+
+void
+PeerPlayerCli::refreshFeed()
+{
+    FeedEngine *feed = FeedEngine::globalInstance();
+    connect(feed, &FeedEngine::refreshFinished, this, [this]()
+    {
+        QVariantMap result;
+        result["subscriptions"] = ProfileSettings::profile()->variant("subscription_list").toList().size();
+        result["feed"] = limitedFeed();
+        finish(result);
+    });
+    feed->refresh();
+}
+
+void
+PeerPlayerCli::showFeed()
+{
+    QVariantMap result;
+    result["feed"] = limitedFeed();
+    finish(result);
+}
+
+void
+PeerPlayerCli::search()
+{
+    QString query = m_args.mid(1).join(" ");
+    if (query.trimmed().isEmpty())
+        return fail("usage: search <words>", 2);
+
+    QVariantMap result;
+    result["query"] = query;
+    result["results"] = VideoCatalog::globalInstance()->search(query, m_limit);
+    finish(result);
+}
+
+void
+PeerPlayerCli::download()
+{
+    m_download_queue = m_args.mid(1);
+    if (m_download_queue.isEmpty())
+        return fail("usage: download <address> [...]", 2);
+
+    //Downloads take as long as they take
+    m_tmr_timeout->stop();
+    m_storage = new VideoStorage(this);
+    connect(m_storage, &VideoStorage::suggestFilename, this, [this](const QString &filename)
+    {
+        m_download_context["_suggested_filename"] = filename;
+    });
+    connect(m_storage, SIGNAL(downloadFinished(const QString&)), SLOT(importDownload(const QString&)));
+    connect(m_storage, &VideoStorage::downloadFailed, this, [this]()
+    {
+        addDownloadResult("download failed");
+    });
+    downloadNext();
+}
+
+void
+PeerPlayerCli::downloadNext()
+{
+    if (m_download_queue.isEmpty())
+    {
+        bool all_ok = true;
+        foreach (const QVariant &var, m_download_results)
+            all_ok = all_ok && !var.toMap().contains("error");
+        QVariantMap result;
+        result["downloads"] = m_download_results;
+        return finish(result, all_ok ? 0 : 1);
+    }
+    m_download_address = m_download_queue.takeFirst();
+    m_download_context.clear();
+    m_download_context["url"] = m_download_address;
+    qInfo() << "downloading" << m_download_address;
+
+    //Imported before, nothing to do
+    QString file = m_storage->findFileByAddress(m_download_address);
+    if (!file.isEmpty())
+        return addDownloadResult(QString(), file);
+
+    //Sources of the video (get_video_url), external downloader if the site has none
+    if (m_site) m_site->deleteLater();
+    m_site = VSite::load(m_download_address, this);
+    ActionContextPtr ctx = m_site ? m_site->loadVideo(m_download_address) : ActionContextPtr();
+    if (!ctx)
+    {
+        m_storage->downloadViaTool(m_download_address);
+        return;
+    }
+    ctx->enableSignal();
+    connect(ctx.data(), &ActionContext::finished, this, [this](const QVariant &value)
+    {
+        startDownload(value);
+    });
+    connect(ctx.data(), &ActionContext::failed, this, [this]()
+    {
+        addDownloadResult("failed to load video sources");
+    });
+}
+
+void
+PeerPlayerCli::startDownload(const QVariant &sources)
+{
+    //First source is the one the site prefers
+    QString url;
+    if (sources.canConvert<QVariantList>())
+    {
+        foreach (const QVariant &var, sources.toList())
+        {
+            QVariantMap item = var.toMap();
+            url = item.value("url").toString();
+            if (url.isEmpty()) continue;
+            foreach (const QString &key, item.keys())
+            {
+                if (!m_download_context.contains(key) && key != "url")
+                    m_download_context[key] = item[key];
+            }
+            break;
+        }
+    }
+    else
+    {
+        url = sources.toString();
+    }
+    if (url.isEmpty())
+        return addDownloadResult("no video file found");
+    m_storage->downloadFile(QUrl(url));
+}
+
+void
+PeerPlayerCli::importDownload(const QString &temp_file)
+{
+    //Import right here, no GUI to keep responsive
+    QString imported_file;
+    QMetaObject::Connection connection = connect(m_storage, &VideoStorage::fileImported, this,
+        [&imported_file](const QString &file)
+    {
+        imported_file = file;
+    });
+    m_storage->importFile(temp_file, m_download_address, m_download_context, true);
+    disconnect(connection);
+
+    if (imported_file.isEmpty())
+        return addDownloadResult("import failed");
+    addDownloadResult(QString(), imported_file);
+}
+
+void
+PeerPlayerCli::addDownloadResult(const QString &error, const QString &file)
+{
+    QVariantMap result;
+    result["address"] = m_download_address;
+    if (!error.isEmpty())
+    {
+        qWarning() << error << m_download_address;
+        result["error"] = error;
+    }
+    if (!file.isEmpty())
+        result["file"] = file;
+    m_download_results << result;
+    QTimer::singleShot(0, this, [this]()
+    {
+        downloadNext();
+    });
+}
+
+QVariantList
+PeerPlayerCli::limitedFeed() const
+{
+    return FeedEngine::globalInstance()->feed().mid(0, m_limit);
+}
+
+void
+PeerPlayerCli::finish(const QVariant &result, int code)
+{
+    if (m_finished) return;
+    m_finished = true;
+    QJsonDocument doc = QJsonDocument::fromVariant(result);
+    QByteArray json = doc.toJson(m_pretty ? QJsonDocument::Indented : QJsonDocument::Compact);
+    fprintf(stdout, "%s\n", json.constData());
+    fflush(stdout);
+    QCoreApplication::exit(code);
+}
+
+void
+PeerPlayerCli::fail(const QString &error, int code)
+{
+    QVariantMap result;
+    result["error"] = error;
+    finish(result, code);
+}
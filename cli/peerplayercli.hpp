@@ -0,0 +1,138 @@
+#ifndef PEERPLAYERCLI_HPP
+#define PEERPLAYERCLI_HPP
+
+#include <stdio.h>
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QJsonDocument>
+
+#include "profilesettings.hpp"
+#include "libraryindex.hpp"
+#include "vsite.hpp"
+#include "feedengine.hpp"
+#include "videocatalog.hpp"
+#include "videostorage.hpp"
+
+/**
+ * PeerPlayerCli runs one command without the GUI (no widgets, no WebEngine),
+ * for scripts and cron jobs on a server. It uses the same profile
+ * (settings, library index) as the player.
+ *
+ * The result is written to stdout as JSON, log messages go to stderr.
+ * The application exits when the command is done, with code 0 on success.
+ *
+ * Commands:
+ * action <address> <action> [KEY=value ...]  run an action plan of the site
+ * refresh                                   refresh the subscription feed
+ * feed                                      stored feed, newest first
+ * search <words>                            search the catalog of seen videos
+ * download <address> [...]                  download and import videos
+ */
+class PeerPlayerCli : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    PeerPlayerCli(const QStringList &args, QObject *parent = 0);
+
+    void
+    setLimit(int limit);
+
+    void
+    setPrettyOutput(bool pretty);
+
+    void
+    setTimeout(int seconds);
+
+public slots:
+
+    void
+    run();
+
+private slots:
+
+    void
+    timeout();
+
+    void
+    importDownload(const QString &temp_file);
+
+private:
+
+    void
+    runAction();
+
+    void
+    callAction(const QString &action, const QVariantMap &params);
+
+    void
+    refreshFeed();
+
+    void
+    showFeed();
+
+    void
+    search();
+
+    void
+    download();
+
+    void
+    downloadNext();
+
+    void
+    startDownload(const QVariant &sources);
+
+    void
+    addDownloadResult(const QString &error, const QString &file = QString());
+
+    QVariantList
+    limitedFeed() const;
+
+    void
+    finish(const QVariant &result, int code = 0);
+
+    void
+    fail(const QString &error, int code = 1);
+
+    QStringList
+    m_args;
+
+    int
+    m_limit;
+
+    bool
+    m_pretty;
+
+    bool
+    m_finished;
+
+    QTimer
+    *m_tmr_timeout;
+
+    QPointer<VSite>
+    m_site;
+
+    VideoStorage
+    *m_storage;
+
+    QStringList
+    m_download_queue;
+
+    QString
+    m_download_address;
+
+    QVariantMap
+    m_download_context;
+
+    QVariantList
+    m_download_results;
+
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef CACHEPROXY_HPP
+#define CACHEPROXY_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QDir>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QMap>
+#include <QSet>
+#include <QDateTime>
+#include <QRegExp>
+#include <QCryptographicHash>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#include "partialfile.hpp"
+#include "profilesettings.hpp"
+
+/**
+ * CacheProxy is a local (loopback) HTTP proxy for remote video files.
+ *
+ * The player plays the proxy url (see proxyUrl()) instead of the remote url.
+ * Requests (with byte ranges, the player seeks) are served from
+ * a sparse cache file, missing data is fetched from the remote server
+ * and written to the cache file while it's passed on to the player.
+ * So a video that is watched and then imported is downloaded only once,
+ * the import fetches the missing ranges only (see cacheFile()).
+ *
+ * Cache files are temp files, they're removed on exit.
+ * Their total size is limited (stream_cache_size, MiB), the least recently
+ * played files are removed first, except for those handed out for an import.
+ */
+class CacheProxy : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    static CacheProxy*
+    globalInstance();
+
+    CacheProxy(QObject *parent = 0);
+
+    ~CacheProxy();
+
+    void
+    setCacheDirectory(const QString &dir_path);
+
+    /**
+     * Returns the local url the remote url can be played from.
+     * Returns the remote url if the proxy can't be started.
+     */
+    QUrl
+    proxyUrl(const QUrl &url);
+
+    /**
+     * Returns the cache file of a remote url (if it has been played).
+     */
+    QSharedPointer<PartialFile>
+    cacheFile(const QUrl &url);
+
+public slots:
+
+    /**
+     * Forgets the cache file, it has been moved away (import).
+     * Clients streaming from it are disconnected, the player reconnects
+     * and gets a new cache file.
+     */
+    void
+    releaseFile(const QString &file_path);
+
+private slots:
+
+    void
+    handleConnection();
+
+    void
+    readRequest();
+
+    void
+    serveClients();
+
+private:
+
+    struct Entry
+    {
+        QUrl url;
+        QSharedPointer<PartialFile> file;
+        QPointer<QNetworkReply> upstream;
+        qint64 upstream_pos;
+        bool failed;
+        bool claimed; //handed out by cacheFile(), not removed
+        qint64 last_used;
+    };
+
+    struct Client
+    {
+        QString id;
+        QFile *file;
+        qint64 pos;
+        qint64 end; //last byte, -1 until size is known
+        bool range;
+        bool headers_sent;
+        QByteArray request;
+    };
+
+    bool
+    listen();
+
+    static QString
+    entryId(const QUrl &url);
+
+    void
+    removeEntry(const QString &id, bool remove_file);
+
+    /**
+     * Removes least recently used cache files above the size limit.
+     */
+    void
+    trimCache(const QString &keep_id);
+
+    void
+    serveClient(QTcpSocket *socket);
+
+    void
+    sendHeaders(QTcpSocket *socket, Client &client, qint64 size);
+
+    void
+    sendError(QTcpSocket *socket, const QByteArray &status);
+
+    /**
+     * Fetches the remote file from offset on (unless it's being fetched).
+     */
+    void
+    fetchUpstream(const QString &id, qint64 offset);
+
+    QTcpServer
+    *m_server;
+
+    QNetworkAccessManager
+    *m_network;
+
+    QString
+    m_cache_dir;
+
+    QMap<QString, Entry>
+    m_entries;
+
+    QMap<QTcpSocket*, Client>
+    m_clients;
+
+};
+
+#endif
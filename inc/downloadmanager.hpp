@@ -0,0 +1,217 @@
+#ifndef DOWNLOADMANAGER_HPP
+#define DOWNLOADMANAGER_HPP
+
+#include <functional>
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QMap>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QNetworkReply>
+
+#include <algorithm>
+
+#include "profilesettings.hpp"
+
+/**
+ * DownloadManager schedules the downloads of all views (tabs).
+ *
+ * A download is added as a job with a priority, it's started
+ * when a slot is free (download_max_concurrent), the highest priority first.
+ * A playback job (download that is being played) is started right away.
+ *
+ * The bandwidth of HTTP downloads is shaped by the manager:
+ * it reads from the network replies (limited read buffer),
+ * so a job only gets its share of the global limit (download_rate_limit),
+ * weighted by priority. While a video is playing (its stream is not
+ * a job, it's read by libvlc), background jobs are limited as well
+ * (download_rate_while_playing), so they don't stall the playback.
+ * External downloads get their share as rate limit on start.
+ */
+class DownloadManager : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    jobAdded(int id);
+
+    void
+    jobChanged(int id);
+
+    void
+    jobRemoved(int id);
+
+    /**
+     * First player started or last player stopped (see setPlaybackActive()).
+     */
+    void
+    playbackActiveChanged(bool active);
+
+public:
+
+    enum Priority
+    {
+        Background = 0, //import, prefetch
+        Normal = 1,
+        Playback = 2, //file is being played while it's downloaded
+    };
+
+    enum State
+    {
+        Queued,
+        Active,
+        Finished,
+        Failed,
+    };
+
+    static DownloadManager*
+    globalInstance();
+
+    DownloadManager(QObject *parent = 0);
+
+    int
+    maxConcurrent();
+
+    void
+    setMaxConcurrent(int count);
+
+    /**
+     * Global bandwidth limit in bytes per second, 0 means unlimited.
+     */
+    qint64
+    rateLimit();
+
+    void
+    setRateLimit(qint64 bytes_per_sec);
+
+    /**
+     * Adds a job, start is called with the job id when it's the job's turn.
+     * The job must report back with attachReply() or updateJob(),
+     * and finishJob() when it's done.
+     * Abort is called if the user cancels the job.
+     */
+    int
+    addJob(const QString &title, int priority, std::function<void(int)> start, std::function<void()> abort = nullptr);
+
+    void
+    setPriority(int id, int priority);
+
+    /**
+     * Lets the manager read the reply (rate limited), received data
+     * is passed to write. When the reply has finished, call drainReply().
+     */
+    void
+    attachReply(int id, QNetworkReply *reply, std::function<void(const QByteArray&)> write);
+
+    /**
+     * The reply has finished, the rest of its read buffer is passed
+     * to write at the job's rate, then done is called (queued).
+     */
+    void
+    drainReply(int id, std::function<void()> done);
+
+    void
+    updateJob(int id, qint64 bytes, qint64 total);
+
+    void
+    finishJob(int id, bool failed = false);
+
+    void
+    cancelJob(int id);
+
+    /**
+     * Removes finished and failed jobs from the list.
+     * Only the latest (download_history) are kept anyway.
+     */
+    void
+    clearFinished();
+
+    /**
+     * Returns the rate limit (bytes/s) a new external download should use,
+     * 0 if unlimited.
+     */
+    qint64
+    rateLimitFor(int id);
+
+    QList<int>
+    jobs();
+
+    /**
+     * { id, title, priority, state, bytes, total, speed }
+     */
+    QVariantMap
+    jobInfo(int id);
+
+    /**
+     * Players register while they're playing, background jobs
+     * are slowed down during that time.
+     */
+    void
+    setPlaybackActive(QObject *player, bool active);
+
+    bool
+    isPlaybackActive();
+
+private slots:
+
+    void
+    scheduleJobs();
+
+    void
+    tick();
+
+private:
+
+    struct Job
+    {
+        int id;
+        QString title;
+        int priority;
+        int state;
+        qint64 bytes;
+        qint64 total;
+        qint64 speed;
+        qint64 last_bytes;
+        qint64 tokens;
+        std::function<void(int)> start;
+        std::function<void()> abort;
+        QPointer<QNetworkReply> reply;
+        std::function<void(const QByteArray&)> write;
+        std::function<void()> done;
+    };
+
+    qint64
+    jobRate(const Job &job);
+
+    void
+    readReply(Job &job);
+
+    void
+    pruneFinished();
+
+    QMap<int, Job>
+    m_jobs;
+
+    int
+    m_next_id;
+
+    QSet<QObject*>
+    m_players;
+
+    QTimer
+    m_tmr_tick;
+
+    QElapsedTimer
+    m_tick_clock;
+
+    QElapsedTimer
+    m_report_clock;
+
+};
+
+#endif
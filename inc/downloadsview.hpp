@@ -0,0 +1,56 @@
+#ifndef DOWNLOADSVIEW_HPP
+#define DOWNLOADSVIEW_HPP
+
+#include <QDebug>
+#include <QWidget>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QProgressBar>
+#include <QLocale>
+
+#include "downloadmanager.hpp"
+
+/**
+ * DownloadsView lists the jobs of the download manager (all tabs)
+ * with their progress.
+ */
+class DownloadsView : public QWidget
+{
+    Q_OBJECT
+
+public:
+
+    DownloadsView(QWidget *parent = 0);
+
+private slots:
+
+    void
+    addJob(int id);
+
+    void
+    updateJob(int id);
+
+    void
+    removeJob(int id);
+
+    void
+    cancelSelected();
+
+    void
+    clearFinished();
+
+private:
+
+    QTreeWidget
+    *m_tree;
+
+    QMap<int, QTreeWidgetItem*>
+    m_items;
+
+};
+
+#endif
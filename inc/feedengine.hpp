@@ -0,0 +1,157 @@
+#ifndef FEEDENGINE_HPP
+#define FEEDENGINE_HPP
+
+#include <QDebug>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QDateTime>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "profilesettings.hpp"
+#include "libraryindex.hpp"
+#include "vsite.hpp"
+#include "videocatalog.hpp"
+
+/**
+ * FeedEngine builds the subscription feed, the newest videos
+ * of all subscribed channels in one list, newest first.
+ *
+ * The channels (subscription_list) are refreshed in the background,
+ * several at a time, but only a few per site (domain) so no server
+ * gets flooded. New videos of each channel are fetched (get_channel_videos)
+ * and stored in the library index; the feed is a merge of the per-channel
+ * lists (each sorted by publication time).
+ *
+ * Refreshes are incremental: the newest video seen (watermark) is stored
+ * per subscription, plans that can filter by date only return newer videos
+ * and paging stops at the first known video.
+ *
+ * The stored items are loaded on startup, so the feed can be shown
+ * right away, before the first refresh is done.
+ */
+class FeedEngine : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    feedChanged();
+
+    void
+    refreshFinished();
+
+public:
+
+    static FeedEngine*
+    globalInstance();
+
+    FeedEngine(QObject *parent = 0);
+
+    /**
+     * Merged feed, newest first. Items have the site's fields and
+     * subscription, channel_title, address (absolute url), published (ms).
+     */
+    QVariantList
+    feed() const;
+
+    bool
+    isRefreshing() const;
+
+    /**
+     * Refreshes the feed periodically (feed_refresh_minutes),
+     * the first time shortly after startup.
+     */
+    void
+    startSchedule();
+
+public slots:
+
+    /**
+     * Refreshes all subscriptions. If a refresh is running,
+     * another one is started when it's done.
+     */
+    void
+    refresh();
+
+private slots:
+
+    void
+    startJobs();
+
+private:
+
+    struct Job
+    {
+        QVariantMap subscription;
+        QString domain;
+        QPointer<VSite> site;
+        QTimer *tmr_timeout;
+        qint64 since; //watermark, ms
+        QString known_address;
+        int page;
+        QVariantList items; //new items
+    };
+
+    void
+    startJob(const QVariantMap &subscription);
+
+    void
+    loadPage(const QString &url, int index);
+
+    /**
+     * Keeps the items newer than the watermark,
+     * loads the next page unless a known item has been reached.
+     */
+    void
+    addPage(const QString &url, int index, const QVariantList &items);
+
+    void
+    finishJob(const QString &url, bool ok);
+
+    QVariantList
+    prepareItems(const QVariantMap &subscription, const QUrl &site_url, const QVariantList &items) const;
+
+    void
+    mergeFeed();
+
+    QMap<QString, QVariantList>
+    m_channels;
+
+    QVariantList
+    m_feed;
+
+    QList<QVariantMap>
+    m_queue;
+
+    QMap<QString, Job>
+    m_jobs;
+
+    QMap<QString, int>
+    m_domain_jobs;
+
+    bool
+    m_refresh_pending;
+
+    int
+    m_parallel_limit;
+
+    int
+    m_domain_limit;
+
+    int
+    m_feed_size;
+
+    QTimer
+    *m_tmr_refresh;
+
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FRAMEGRABBER_HPP
+#define FRAMEGRABBER_HPP
+
+#include <QDebug>
+#include <QFile>
+#include <QImage>
+#include <QSize>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <vlc/vlc.h>
+
+/**
+ * FrameGrabber decodes single frames of a video (local file or url)
+ * with a headless libvlc player (video callbacks, no window, no audio).
+ * The frames are small (RV32, scaled by vlc), they are used to compute
+ * perceptual hashes (fingerprints) and preview images.
+ *
+ * All functions are blocking, so this is meant to be used
+ * in a worker thread. The libvlc instance is not owned.
+ * Decoding uses a single thread, it's background work.
+ */
+class FrameGrabber
+{
+
+public:
+
+    /**
+     * Relative positions (0..1) of the frames that make up a fingerprint.
+     * Positions are relative, so they're the same in every encoding
+     * of a video (regardless of bitrate, resolution, keyframes).
+     */
+    static QList<double>
+    fingerprintPositions();
+
+    /**
+     * Difference hash (dHash) of a frame: the frame is reduced to 9x8
+     * gray pixels, each bit is set if a pixel is brighter than its neighbor.
+     * Similar images have hashes that differ in a few bits only.
+     * A flat (e.g., black) frame has no information, its hash is 0.
+     */
+    static quint64
+    dHash(const QImage &frame);
+
+    static QList<quint64>
+    fingerprint(const QList<QImage> &frames);
+
+    FrameGrabber(libvlc_instance_t *vlc_instance, const QAtomicInt *abort = 0, const QSize &size = QSize(160, 90));
+
+    /**
+     * Frames that could not be decoded are returned as null images
+     * instead of being left out, so the list matches the positions.
+     */
+    void
+    setKeepMissing(bool enabled);
+
+    /**
+     * While the flag is set (e.g., a video is being watched),
+     * the player is paused before the next position, nothing is decoded.
+     */
+    void
+    setPauseFlag(const QAtomicInt *pause);
+
+    /**
+     * Opens the media, seeks to each position and copies the frame.
+     * Frames that could not be decoded in time are left out (see above),
+     * an empty list is returned if the media cannot be played.
+     */
+    QList<QImage>
+    grabFrames(const QString &mrl, const QList<double> &positions, int timeout = 5000);
+
+    /**
+     * Duration (ms) of the media opened by the last grabFrames() call.
+     */
+    qint64
+    duration() const;
+
+private:
+
+    static void*
+    lockCallback(void *opaque, void **planes);
+
+    static void
+    unlockCallback(void *opaque, void *picture, void *const *planes);
+
+    static void
+    displayCallback(void *opaque, void *picture);
+
+    bool
+    waitForFrame(int serial, int timeout);
+
+    bool
+    isAborted() const;
+
+    bool
+    isPaused() const;
+
+    libvlc_instance_t
+    *m_vlc_instance;
+
+    const QAtomicInt
+    *m_abort;
+
+    const QAtomicInt
+    *m_pause;
+
+    QSize
+    m_size;
+
+    QImage
+    m_buffer;
+
+    QImage
+    m_frame;
+
+    int
+    m_frame_serial;
+
+    QMutex
+    m_mutex;
+
+    QWaitCondition
+    m_frame_ready;
+
+    qint64
+    m_duration;
+
+    bool
+    m_keep_missing;
+
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define IMAGELABEL_HPP
 
 #include <QDebug>
+#include <QApplication>
+#include <QThread>
 #include <QPixmap>
 #include <QLabel>
 #include <QResizeEvent>
@@ -9,7 +11,19 @@
 #include <QImageReader>
 #include <QPainter>
 #include <QTimer>
-
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+/**
+ * ImageWidget shows an image scaled to its width (keeping the aspect ratio).
+ *
+ * Encoded images (setPixmap(QByteArray), e.g., downloaded thumbnails)
+ * are decoded in a thread pool, directly at the size they're displayed in
+ * (QImageReader::setScaledSize), not at full resolution in the GUI thread.
+ * The scaled pixmap is cached for the current widget size,
+ * painting only draws it.
+ */
 class ImageWidget : public QLabel
 {
     Q_OBJECT
@@ -29,6 +43,15 @@ public:
     void
     setPixmap(const QPixmap &pixmap);
 
+    /**
+     * Shows an image that has been decoded already (see ThumbnailCache).
+     */
+    void
+    setImage(const QImage &image);
+
+    /**
+     * Decodes the image in the background, shown when done.
+     */
     void
     setPixmap(const QByteArray &bytes);
 
@@ -57,9 +80,50 @@ public slots:
 
 private:
 
+    struct DecodedImage
+    {
+        QImage image;
+        QSize source_size;
+    };
+
+    static QThreadPool*
+    decodePool();
+
+    static DecodedImage
+    decodeImage(const QByteArray &bytes, int width);
+
+    void
+    startDecoding();
+
+    void
+    updateScaledPixmap();
+
+    int
+    decodeWidth() const;
+
     QPixmap
     m_pixmap;
 
+    //Cached for the current widget size and pixmap (cache key)
+    QPixmap
+    m_scaled_pixmap;
+
+    qint64
+    m_scaled_key;
+
+    //Encoded image, decoded again if the widget grows
+    QByteArray
+    m_bytes;
+
+    QSize
+    m_source_size;
+
+    int
+    m_decode_serial;
+
+    bool
+    m_decoding;
+
     bool
     m_limit_h;
 
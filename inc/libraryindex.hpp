@@ -0,0 +1,283 @@
+#ifndef LIBRARYINDEX_HPP
+#define LIBRARYINDEX_HPP
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QMap>
+#include <QtAlgorithms>
+#include <QJsonDocument>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+#include "profilesettings.hpp"
+
+/**
+ * LibraryIndex is the persistent index of the local video library.
+ * It replaces the addr_map and file_map dictionaries that used to be
+ * kept in the settings file, which had to be loaded, modified
+ * and written back as a whole for every lookup and every import.
+ *
+ * The index is an SQLite database in the config directory.
+ * Each imported file has one record (file path, content hash, context)
+ * and any number of source addresses pointing to it,
+ * so a lookup by address, file path or hash is an indexed query
+ * and an import only writes the affected rows.
+ * The database runs in WAL mode, every change is committed
+ * in its own transaction, so a crash cannot corrupt the index.
+ *
+ * Like SettingsManager, there is a global instance,
+ * but it can be used from any thread (import runs in the background):
+ * each thread gets its own database connection.
+ */
+class LibraryIndex
+{
+
+public:
+
+    static LibraryIndex*
+    globalInstance();
+
+    /**
+     * Returns the attributes used to detect changed files:
+     * { size, mtime, inode }
+     * A file with the same size, mtime and inode as in the index
+     * is considered unchanged and does not have to be hashed again.
+     */
+    static QVariantMap
+    statFile(const QString &file);
+
+    LibraryIndex(const QString &db_path);
+
+    QString
+    databasePath() const;
+
+    bool
+    isOpen();
+
+    /**
+     * Returns the download item for a source address (forward lookup):
+     * { url, file, hash_md5 }
+     * or an empty map if the address is unknown.
+     */
+    QVariantMap
+    findByAddress(const QString &address);
+
+    /**
+     * Returns the context map saved with the specified file, if any.
+     */
+    QVariantMap
+    findFileContext(const QString &file);
+
+    QStringList
+    findFilesByHash(const QString &hash_md5);
+
+    QStringList
+    addressesOfFile(const QString &file);
+
+    /**
+     * Returns all groups of files with identical content (same hash),
+     * each group is a map: { hash_md5, size, files }
+     * The files of a group are ordered by import, oldest first.
+     */
+    QVariantList
+    duplicateGroups();
+
+    /**
+     * Returns the indexed attributes of a file:
+     * { file, hash_md5, size, mtime, inode, duration, width, height,
+     *   fingerprint_mtime }
+     * or an empty map if the file is not in the index.
+     */
+    QVariantMap
+    fileInfo(const QString &file);
+
+    /**
+     * Inserts the file if it's not known yet and updates
+     * the specified attributes (see fileInfo()), context and addresses
+     * are not touched.
+     */
+    bool
+    updateFileInfo(const QString &file, const QVariantMap &info);
+
+    /**
+     * Returns the indexed files directly inside the directory (not recursive).
+     */
+    QStringList
+    filesInDirectory(const QString &dir_path);
+
+    bool
+    hasFingerprint(const QString &file);
+
+    /**
+     * Stores the perceptual fingerprint of a file (one hash per frame,
+     * see FrameGrabber), replacing the old one.
+     */
+    bool
+    setFingerprint(const QString &file, const QList<quint64> &hashes);
+
+    /**
+     * Finds a file with a similar fingerprint, i.e., the same video
+     * in another encoding (different md5), or returns an empty string.
+     * A frame matches if at most max_distance bits differ,
+     * a file matches if most of its frames match.
+     * If the duration (ms) is known, files of other length are ignored.
+     */
+    QString
+    findByFingerprint(const QList<quint64> &hashes, qint64 duration = -1, int max_distance = 10);
+
+    /**
+     * Returns the saved playback position of a video:
+     * { time, duration } (ms), or an empty map.
+     * The key is a source address or content hash (see ResumePositions).
+     */
+    QVariantMap
+    resumePosition(const QString &key);
+
+    /**
+     * Saves playback positions (key => { time, duration }) in one transaction,
+     * a position without time is removed.
+     */
+    bool
+    setResumePositions(const QMap<QString, QVariantMap> &positions);
+
+    /**
+     * Returns the stored feed items of all subscriptions
+     * (subscription address => items, newest first).
+     */
+    QMap<QString, QVariantList>
+    feedItems();
+
+    /**
+     * Adds or updates the feed items of a subscription (items with "address"
+     * and "published"), only the newest ones (keep) are kept.
+     */
+    bool
+    setFeedItems(const QString &subscription, const QVariantList &items, int keep = 50);
+
+    /**
+     * Removes the feed items and the watermark of a subscription.
+     */
+    bool
+    removeFeedItems(const QString &subscription);
+
+    /**
+     * Returns the newest video seen in a subscription:
+     * { published (ms), address, updated }
+     * or an empty map if it has never been refreshed.
+     */
+    QVariantMap
+    feedWatermark(const QString &subscription);
+
+    bool
+    setFeedWatermark(const QString &subscription, qint64 published, const QString &address);
+
+    /**
+     * Adds or updates videos seen on the sites (catalog), in one transaction.
+     * Each video: { address, title, description, thumbnail, channel, site,
+     * published, item, tokens } where tokens maps each search token
+     * to its weight (see VideoCatalog). Tokens of a known video
+     * are only rewritten if its text has changed.
+     */
+    bool
+    addVideos(const QList<QVariantMap> &videos);
+
+    /**
+     * Returns the videos that match all terms (tokens, terms of 3+ chars
+     * also match as prefix), best match first, as items for the video list.
+     * Very frequent terms are matched exactly or ignored (stop words).
+     */
+    QVariantList
+    searchVideos(const QStringList &terms, int limit = 200);
+
+    /**
+     * Adds an imported file with its source address in one transaction.
+     * If the file is already known, its record is updated.
+     */
+    bool
+    addImportedFile(const QString &file, const QString &src_address, const QString &hash_md5, const QVariantMap &context);
+
+    /**
+     * Adds another source address (alias) for a known file.
+     */
+    bool
+    addAddress(const QString &address, const QString &file);
+
+    /**
+     * Removes a file (which does not exist anymore) from the index,
+     * the old record is moved to the trash table.
+     */
+    bool
+    removeFile(const QString &file);
+
+private:
+
+    /**
+     * Connection of one thread, owned by the thread (QThreadStorage)
+     * and removed when the thread ends, so pool threads don't leak
+     * connections and a new thread never gets the one of a dead thread.
+     */
+    struct ThreadConnection
+    {
+        ~ThreadConnection();
+
+        QString
+        name;
+    };
+
+    QSqlDatabase
+    connection();
+
+    bool
+    initSchema();
+
+    /**
+     * Runs the statements of a schema version in one transaction,
+     * sets user_version on success.
+     */
+    bool
+    migrate(QSqlDatabase &db, int version, const QStringList &statements);
+
+    bool
+    migrateSettings();
+
+    qint64
+    fileId(QSqlDatabase &db, const QString &file);
+
+    static QStringList
+    chunkNeighbours(int chunk, int radius, int first_bit = 0);
+
+    static QString
+    encodeContext(const QVariantMap &context);
+
+    static QVariantMap
+    decodeContext(const QString &text);
+
+    QString
+    m_db_path;
+
+    QString
+    m_conn_prefix;
+
+    QMutex
+    m_init_mutex;
+
+    QThreadStorage<ThreadConnection*>
+    m_connections;
+
+    QAtomicInt
+    m_conn_count;
+
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef LIBRARYSCANNER_HPP
+#define LIBRARYSCANNER_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QMimeDatabase>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QMutex>
+#include <QSet>
+#include <QTimer>
+#include <QPointer>
+#include <QUrl>
+#include <QAtomicInt>
+#include <QtConcurrent>
+
+#include <vlc/vlc.h>
+
+#include "libraryindex.hpp"
+#include "videostorage.hpp"
+#include "framegrabber.hpp"
+#include "vlcinstance.hpp"
+
+/**
+ * LibraryScanner indexes the video files in the import directory,
+ * including files which have not been imported through this program.
+ *
+ * The directory is walked once on start, new or changed files
+ * (size, mtime or inode differs from the index) are hashed
+ * and probed (duration, resolution) by libvlc in a thread pool.
+ * A perceptual fingerprint is taken as well (see FrameGrabber),
+ * it links re-encoded copies of a video, which have different hashes.
+ * Each file is committed to the index when it's done,
+ * so the index fills up incrementally.
+ * Afterwards, the directories are watched (inotify on Linux)
+ * and only a changed directory is scanned again.
+ */
+class LibraryScanner : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    scanStarted();
+
+    void
+    fileIndexed(const QString &file);
+
+    void
+    scanFinished();
+
+    /**
+     * A local file with the same fingerprint as the remote video was found,
+     * the address has been added to the file in the index.
+     */
+    void
+    remoteMatched(const QString &address, const QString &file);
+
+public:
+
+    static LibraryScanner*
+    globalInstance();
+
+    LibraryScanner(QObject *parent = 0);
+
+    ~LibraryScanner();
+
+    static bool
+    isVideoFile(const QString &file);
+
+    bool
+    isActive() const;
+
+public slots:
+
+    /**
+     * Scans the directory (recursively) and starts watching it.
+     */
+    void
+    start(const QString &dir_path, bool recursive = true);
+
+    /**
+     * Hashes and probes a single file (if changed) in the background.
+     */
+    void
+    scheduleFile(const QString &file);
+
+    /**
+     * Fingerprints a remote video (a few frames decoded from the stream)
+     * and looks for a local copy in another encoding, see remoteMatched().
+     * Off by default (match_remote_videos), it costs one seek
+     * and decode per fingerprint frame on every remote video opened.
+     */
+    void
+    matchRemote(const QString &address, const QUrl &url);
+
+private slots:
+
+    void
+    scheduleDirectory(const QString &dir_path);
+
+    void
+    scanPendingDirectories();
+
+    void
+    taskDone(const QString &file, bool indexed);
+
+private:
+
+    /**
+     * Lists the directory in the pool, schedules its video files
+     * and enters sub directories which are not watched yet.
+     */
+    void
+    scanDirectory(const QString &dir_path);
+
+    void
+    watchDirectory(const QString &dir_path);
+
+    void
+    indexFile(const QString &file);
+
+    QVariantMap
+    probeFile(const QString &file);
+
+    bool
+    fingerprintFile(const QString &file);
+
+    libvlc_instance_t*
+    vlcInstance();
+
+    QThreadPool
+    m_pool;
+
+    QFileSystemWatcher
+    *m_watcher;
+
+    QSet<QString>
+    m_pending_dirs;
+
+    QSet<QString>
+    m_queued_files;
+
+    QTimer
+    m_tmr_dirs;
+
+    int
+    m_active_tasks;
+
+    QAtomicInt
+    m_stop;
+
+    QMutex
+    m_vlc_mutex;
+
+    libvlc_instance_t
+    *m_vlc_instance;
+
+    bool
+    m_recursive;
+
+};
+
+#endif
@@ -11,10 +11,16 @@
 #include <QProcessEnvironment>
 #include <QFontDatabase>
 #include <QLibraryInfo>
+#include <QElapsedTimer>
 
 #include "version.hpp"
 
+#include "startupprofiler.hpp"
 #include "profilesettings.hpp"
+#include "libraryindex.hpp"
+#include "libraryscanner.hpp"
+#include "feedengine.hpp"
+#include "videostorage.hpp"
 #include "peerplayermain.hpp"
 #include "vlcplayer.hpp"
 
@@ -0,0 +1,179 @@
+#ifndef PARTIALFILE_HPP
+#define PARTIALFILE_HPP
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <vlc/vlc.h>
+
+/**
+ * PartialFile is a file that is being downloaded, it knows which byte
+ * ranges have been written, so it can be played before it's complete.
+ *
+ * The downloads write data at any offset (sequential download,
+ * range requests after a seek). Readers (libvlc input threads,
+ * see the vlc* callbacks) block until the requested bytes are there.
+ * If a reader waits for an offset that's far ahead of the downloaded data,
+ * rangeRequested() is emitted, so the data can be fetched from there.
+ *
+ * A file written by another process (external downloader) is "growing":
+ * only its size on disk is known, which is checked while a reader waits.
+ */
+class PartialFile : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    /**
+     * A reader waits for data at offset (emitted from the reader's thread).
+     */
+    void
+    rangeRequested(qint64 offset);
+
+    /**
+     * Data has been written (emitted from the writer's thread).
+     */
+    void
+    dataWritten(qint64 offset, qint64 size);
+
+public:
+
+    PartialFile(const QString &file_path, QObject *parent = 0);
+
+    ~PartialFile();
+
+    QString
+    filePath() const;
+
+    /**
+     * Total size, -1 if unknown.
+     */
+    qint64
+    size();
+
+    void
+    setSize(qint64 size);
+
+    void
+    setGrowing(bool growing);
+
+    bool
+    write(qint64 offset, const QByteArray &data);
+
+    /**
+     * Download is complete (or failed), readers get EOF
+     * instead of waiting at the end of the data.
+     */
+    void
+    setFinished(bool failed = false);
+
+    bool
+    isFinished();
+
+    /**
+     * Number of bytes available at offset (contiguous).
+     */
+    qint64
+    availableFrom(qint64 offset);
+
+    /**
+     * First offset (from offset on) that has not been written,
+     * -1 if the file is complete (size known).
+     */
+    qint64
+    missingFrom(qint64 offset);
+
+    /**
+     * Number of bytes written (all ranges).
+     */
+    qint64
+    bytesAvailable();
+
+    int
+    openReader();
+
+    /**
+     * Reads up to max_size bytes at offset, blocks until data is available.
+     * Returns 0 at the end of the file, -1 on error or if interrupted.
+     */
+    qint64
+    read(int reader, qint64 offset, char *data, qint64 max_size);
+
+    void
+    closeReader(int reader);
+
+    /**
+     * Wakes up all waiting readers and makes them fail,
+     * must be called before the player is stopped (it waits for its reader).
+     */
+    void
+    interruptReaders();
+
+    static int
+    vlcOpen(void *opaque, void **datap, uint64_t *sizep);
+
+    static ssize_t
+    vlcRead(void *opaque, unsigned char *buf, size_t len);
+
+    static int
+    vlcSeek(void *opaque, uint64_t offset);
+
+    static void
+    vlcClose(void *opaque);
+
+private:
+
+    void
+    addRange(qint64 start, qint64 end);
+
+    qint64
+    availableFromLocked(qint64 offset);
+
+    QString
+    m_file_path;
+
+    QFile
+    m_write_file;
+
+    QMap<qint64, qint64>
+    m_ranges; //start -> end (exclusive)
+
+    qint64
+    m_size;
+
+    bool
+    m_growing;
+
+    bool
+    m_finished;
+
+    bool
+    m_failed;
+
+    QMap<int, QFile*>
+    m_readers;
+
+    QSet<int>
+    m_interrupted;
+
+    int
+    m_next_reader;
+
+    qint64
+    m_requested_offset;
+
+    QMutex
+    m_mutex;
+
+    QWaitCondition
+    m_data_ready;
+
+};
+
+#endif
@@ -8,13 +8,20 @@
 #include <QLibraryInfo>
 #include <QTabWidget>
 #include <QTabBar>
-
-#include <QWebEngineView>
-#include <QWebEngineProfile>
+#include <QTimer>
+#include <QPointer>
+#include <QDateTime>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QJsonDocument>
+#include <QMessageBox>
 
 #include "subscriptionsview.hpp"
 #include "siteview.hpp"
 #include "videoview.hpp"
+#include "downloadsview.hpp"
+#include "searchview.hpp"
+#include "startupprofiler.hpp"
 #include "profilesettings.hpp"
 #include "gui.hpp"
 #include "settingswindow.hpp"
@@ -37,6 +44,12 @@ private slots:
     void
     addSubscriptionsTab();
 
+    void
+    addDownloadsTab();
+
+    void
+    addSearchTab();
+
     void
     showSettings();
 
@@ -59,19 +72,38 @@ private slots:
     checkLastTabClosed();
 
     void
-    openVideo(const QString &url, const QVariantMap &item = QVariantMap(), bool in_background = false);
+    openVideo(const QString &url, const QVariantMap &item = QVariantMap(), bool in_background = false, const QVariantMap &state = QVariantMap());
 
     void
-    showPage(const QString &url, const ActionContextRef &ctx);
+    activateTab(int index);
 
     void
-    handleLoadedPage(QWebEngineView *view, bool ok, const ActionContextRef &ctx);
+    hibernateTabs();
+
+    void
+    showPage(const QString &url, const ActionContextRef &ctx);
 
 private:
 
     void
     initNewTabWidget(QWidget *widget, const QString &type, const QString &address, const QVariantMap &item = QVariantMap());
 
+    SiteView*
+    createSiteView(const QString &address);
+
+    VideoView*
+    createVideoView(const QString &url, const QVariantMap &item, const QVariantMap &state, bool autoplay);
+
+    /**
+     * Adds a lightweight placeholder for a site or video tab,
+     * the view is created when the tab is shown.
+     */
+    QWidget*
+    addTabPlaceholder(const QString &type, const QString &url, const QVariantMap &item, const QVariantMap &state, const QString &name, int index = -1);
+
+    void
+    materializeTab(int index);
+
     int
     m_tab_id;
 
@@ -81,9 +113,21 @@ private:
     QMap<int, QVariantMap>
     m_loaded_tabs;
 
+    QPointer<QWidget>
+    m_active_tab;
+
+    QTimer
+    *m_tmr_hibernate;
+
     QAction
     *m_act_subscriptions;
 
+    QAction
+    *m_act_downloads;
+
+    QAction
+    *m_act_search;
+
     QAction
     *m_act_settings;
 
@@ -0,0 +1,68 @@
+#ifndef RESUMEPOSITIONS_HPP
+#define RESUMEPOSITIONS_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QStringList>
+#include <QMap>
+#include <QTimer>
+
+#include "libraryindex.hpp"
+
+/**
+ * ResumePositions remembers where each video was left,
+ * so playback continues there when it's opened again.
+ *
+ * A video is identified by one or more keys: its source address
+ * and, for a local file, its content hash (or path if not hashed yet),
+ * so the position is found whether the stream or the imported copy is opened.
+ *
+ * Players report their time continuously, the positions are collected
+ * and written to the library index in one transaction every few seconds,
+ * and on exit. A video that has been watched to the end is forgotten.
+ */
+class ResumePositions : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    static ResumePositions*
+    globalInstance();
+
+    ResumePositions(QObject *parent = 0);
+
+    ~ResumePositions();
+
+    /**
+     * Returns the keys of a video, see above.
+     */
+    static QStringList
+    keysFor(const QString &address, const QUrl &source);
+
+    /**
+     * Returns the saved time (ms) for the first key that's known, 0 if none.
+     */
+    qint64
+    position(const QStringList &keys);
+
+    void
+    setPosition(const QStringList &keys, qint64 time, qint64 duration);
+
+public slots:
+
+    void
+    flush();
+
+private:
+
+    QMap<QString, QVariantMap>
+    m_pending;
+
+    QTimer
+    m_tmr_flush;
+
+};
+
+#endif
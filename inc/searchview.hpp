@@ -0,0 +1,73 @@
+#ifndef SEARCHVIEW_HPP
+#define SEARCHVIEW_HPP
+
+#include <QDebug>
+#include <QWidget>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QLineEdit>
+#include <QListView>
+#include <QScrollBar>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include "videocatalog.hpp"
+#include "videolistmodel.hpp"
+
+/**
+ * SearchView searches the videos of all sites seen so far (VideoCatalog),
+ * offline, while typing.
+ */
+class SearchView : public QWidget
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    openVideoSignal(const QString &url, const QVariantMap &item);
+
+public:
+
+    SearchView(QWidget *parent = 0);
+
+private slots:
+
+    void
+    search();
+
+    void
+    updateVisibleRows();
+
+    void
+    openVideo(const QModelIndex &index);
+
+private:
+
+    QLineEdit
+    *m_txt_query;
+
+    QLabel
+    *m_lbl_status;
+
+    VideoListModel
+    *m_model;
+
+    QListView
+    *m_list;
+
+    QTimer
+    *m_tmr_search;
+
+    QTimer
+    *m_tmr_visible;
+
+    int
+    m_search_serial;
+
+};
+
+#endif
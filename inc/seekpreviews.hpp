@@ -0,0 +1,152 @@
+#ifndef SEEKPREVIEWS_HPP
+#define SEEKPREVIEWS_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QPointer>
+#include <QSet>
+#include <QCache>
+#include <QImage>
+#include <QPainter>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QtConcurrent>
+
+#include <vlc/vlc.h>
+
+#include "profilesettings.hpp"
+#include "framegrabber.hpp"
+#include "vlcinstance.hpp"
+#include "downloadmanager.hpp"
+
+/**
+ * SeekPreviews generates the preview frames that are shown
+ * when the mouse is over the position slider of a player.
+ *
+ * Small frames are taken at fixed intervals (every 10 seconds,
+ * at most 100 frames) by a headless player (see FrameGrabber)
+ * and stored as one JPEG sprite sheet (plus a JSON file describing
+ * the grid) in the previews directory of the config directory.
+ *
+ * Only complete local files are processed, one at a time,
+ * in a thread with idle priority, decoded by a single thread.
+ * While a video is playing, generation is suspended (before the next frame,
+ * the headless player is paused), so it doesn't compete with the playback
+ * for i/o and decoder time.
+ * It resumes when playback stops.
+ */
+class SeekPreviews : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    previewReady(const QString &file);
+
+public:
+
+    static SeekPreviews*
+    globalInstance();
+
+    SeekPreviews(QObject *parent = 0);
+
+    ~SeekPreviews();
+
+    bool
+    hasPreview(const QString &file);
+
+    /**
+     * Returns the preview frame for the time (ms) in the file,
+     * a null image if there is no preview (yet).
+     */
+    QImage
+    frameAt(const QString &file, qint64 time);
+
+public slots:
+
+    /**
+     * Generates the preview of the file in the background,
+     * unless it has been generated already.
+     */
+    void
+    request(const QString &file);
+
+private slots:
+
+    void
+    generated(const QString &file, bool ok);
+
+    void
+    setPlaybackActive(bool active);
+
+private:
+
+    struct Sheet
+    {
+        QImage image;
+        qint64 interval;
+        int count;
+        int columns;
+        QSize tile;
+    };
+
+    /**
+     * Path of the sheet without extension, changes with the file.
+     */
+    QString
+    sheetPath(const QString &file);
+
+    bool
+    generate(const QString &file, const QString &sheet_path);
+
+    /**
+     * Blocks the generating thread while a video is playing.
+     * Returns false if it's being stopped.
+     */
+    bool
+    waitForIdle();
+
+    libvlc_instance_t*
+    vlcInstance();
+
+    QString
+    m_cache_dir;
+
+    QThreadPool
+    m_pool;
+
+    QSet<QString>
+    m_queued;
+
+    QCache<QString, Sheet>
+    m_sheets;
+
+    QAtomicInt
+    m_stop;
+
+    QAtomicInt
+    m_playback_active;
+
+    QMutex
+    m_idle_mutex;
+
+    QWaitCondition
+    m_idle;
+
+    QMutex
+    m_vlc_mutex;
+
+    libvlc_instance_t
+    *m_vlc_instance;
+
+};
+
+#endif
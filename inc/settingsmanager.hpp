@@ -4,7 +4,7 @@
 #include <cassert>
 
 #include <QDebug>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QStandardPaths>
 #include <QTemporaryDir>
 #include <QJsonDocument>
@@ -148,6 +148,13 @@ public:
     QVariant
     setDefaultVariant(const QString &key, const QVariant &default_value);
 
+    /**
+     * Removes the element at the specified key (if it exists),
+     * key is interpreted in the same way as in the getter function.
+     */
+    void
+    removeVariant(const QString &key);
+
     QStringList
     keys(const QString &key = "", bool with_sub_maps = false) const;
 
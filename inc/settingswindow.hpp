@@ -12,8 +12,12 @@
 #include <QFormLayout>
 #include <QMessageBox>
 #include <QTextEdit>
+#include <QSpinBox>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 #include "videostorage.hpp"
+#include "downloadmanager.hpp"
 
 class MainSettingsWidget;
 
@@ -59,8 +63,23 @@ private slots:
     void
     setDlpUpdate(bool enabled);
 
+    void
+    updateLibraryFields();
+
+    void
+    showLibraryReport(const QVariantMap &report);
+
+    void
+    linkDuplicates();
+
 private:
 
+    QLabel
+    *lbl_library_dups;
+
+    QPushButton
+    *btn_library_link;
+
     QPushButton
     *btn_dlp_manage_own;
 
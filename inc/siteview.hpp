@@ -15,10 +15,17 @@
 #include <QImageReader>
 #include <QBuffer>
 #include <QPainter>
+#include <QListView>
+#include <QDateTime>
+#include <QMap>
+#include <QScrollBar>
+#include <QTimer>
 
 #include "vsite.hpp"
 #include "imagewidget.hpp"
 #include "videostorage.hpp"
+#include "thumbnailcache.hpp"
+#include "videolistmodel.hpp"
 #include "gui.hpp"
 
 //class ImageWidget;
@@ -96,6 +103,17 @@ private:
 
 };
 
+/**
+ * VideoListView shows the videos of a channel in a list view,
+ * rows are painted by a delegate (no widgets per video).
+ * Thumbnails are loaded for the visible rows and one screen
+ * above and below, once scrolling has stopped.
+ *
+ * The list scrolls continuously: the next page is requested when
+ * the viewport gets near the end. Only a window of pages around
+ * the viewport is kept, pages scrolled back to are loaded again
+ * (from the site's response cache).
+ */
 class VideoListView : public QFrame
 {
     Q_OBJECT
@@ -107,21 +125,11 @@ signals:
 
 public:
 
-    struct Item
-    {
-        QPointer<QObject> thumb;
-        QPointer<QObject> lbl_title;
-        QPointer<QObject> lbl_description;
-    };
-
     //ChannelView(VSiteBase *site, QString name, bool full_view = false, QWidget *parent = 0);
     VideoListView(VSiteBase *site, const QVariantMap &channel, QFrame *parent = 0);
 
 public slots:
 
-    void
-    loadThumbnail(const QString &url, ImageWidget *thumb);
-
     void
     setVideoList(const QVariantList &items);
 
@@ -129,19 +137,24 @@ public slots:
     loadPage(int index);
 
     void
-    loadPreviousPage();
-
-    void
-    loadNextPage();
+    addVideoPage(int index, const QVariantList &items);
 
     void
     openVideo(const QVariantMap &item);
 
     void
-    openVideo();
+    openVideo(const QModelIndex &index);
 
 private slots:
 
+    void
+    updateVisibleRows();
+
+protected:
+
+    void
+    resizeEvent(QResizeEvent *event);
+
 //TODO sort
 private:
 
@@ -151,21 +164,28 @@ private:
     VideoStorage
     *m_storage;
 
-    QList<Item>
-    m_items;
+    VideoListModel
+    *m_model;
 
     QVariantMap
     m_ch_info;
 
-    QWidget
-    *wid_list;
+    QListView
+    *m_list;
+
+    QTimer
+    *m_tmr_visible;
+
+    //Pending page requests, request time (ms since epoch)
+    QMap<int, qint64>
+    m_page_requests;
+
+    bool
+    m_at_end;
 
     QLabel
     *lbl_title;
 
-    int
-    m_current_page;
-
     int
     m_page_size; // 5
 
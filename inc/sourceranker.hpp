@@ -0,0 +1,139 @@
+#ifndef SOURCERANKER_HPP
+#define SOURCERANKER_HPP
+
+#include <QDebug>
+#include <QObject>
+#include <QUrl>
+#include <QMap>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+#include <algorithm>
+
+/**
+ * SourceRanker orders the sources (versions) of a video
+ * by the time it's expected to take until playback can start.
+ *
+ * All remote sources are probed at the same time with a small
+ * range request (first 256 KB), which yields the time to first byte
+ * and the throughput of each server. Local files always come first,
+ * sources that could not be reached last. Sources with about the same
+ * expected start time keep the order of the site (preferred version first).
+ *
+ * Results are kept per url, ranking the list again after a source
+ * has been added only probes the new one.
+ *
+ * A source that is good enough (expected start below a threshold)
+ * is reported right away, so playback doesn't wait for the slowest probe.
+ */
+class SourceRanker : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    /**
+     * Probes are done (or timed out), order contains the urls
+     * of the items passed to rank(), best source first.
+     * Urls, not indexes, the list of the caller may have changed since.
+     */
+    void
+    ranked(const QList<QUrl> &order);
+
+    /**
+     * First probe whose expected start is below the threshold
+     * passed to rank(), url of the item. Emitted once per ranking.
+     */
+    void
+    sourceReady(const QUrl &url);
+
+public:
+
+    SourceRanker(QObject *parent = 0);
+
+    /**
+     * Probes the sources (items with "url"), emits ranked() when done.
+     * Probes that aren't done after timeout (ms) are aborted.
+     * A source expected to start within good_enough (ms) is reported
+     * by sourceReady() as soon as its probe is done, 0 to wait for all.
+     */
+    void
+    rank(const QList<QVariantMap> &items, int timeout = 3000, qint64 good_enough = 0);
+
+    QList<QUrl>
+    order() const;
+
+    /**
+     * Stops the running ranking, nothing is emitted for it.
+     * Unfinished probes are dropped, they're started again by the next rank().
+     */
+    void
+    abort();
+
+    /**
+     * Expected start time (ms) of the source, 0 for local files,
+     * -1 if unknown or unreachable.
+     */
+    qint64
+    expectedStart(const QUrl &url) const;
+
+private slots:
+
+    void
+    finishRanking();
+
+private:
+
+    struct Probe
+    {
+        QPointer<QNetworkReply> reply;
+        QElapsedTimer timer;
+        qint64 ttfb;
+        qint64 elapsed;
+        qint64 bytes;
+        bool adaptive;
+        bool done;
+        bool failed;
+    };
+
+    void
+    startProbe(const QUrl &url, bool adaptive);
+
+    void
+    finishProbe(const QUrl &url, bool failed);
+
+    bool
+    isProbing() const;
+
+    void
+    checkReady(const QUrl &url);
+
+    QNetworkAccessManager
+    *m_network;
+
+    QMap<QUrl, Probe>
+    m_probes;
+
+    QList<QVariantMap>
+    m_items;
+
+    QList<QUrl>
+    m_order;
+
+    qint64
+    m_good_enough;
+
+    bool
+    m_ready_sent;
+
+    QTimer
+    *m_tmr_timeout;
+
+};
+
+#endif
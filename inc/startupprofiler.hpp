@@ -0,0 +1,83 @@
+#ifndef STARTUPPROFILER_HPP
+#define STARTUPPROFILER_HPP
+
+#include <stdio.h>
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QWidget>
+#include <QEvent>
+#include <QTimer>
+#include <QList>
+#include <QPair>
+
+/**
+ * StartupProfiler measures the phases of the startup,
+ * from main() to the first frame of the main window.
+ *
+ * Each mark() ends a phase. With --startup-profile, the phases are
+ * printed (stderr) once the window has been painted, otherwise mark()
+ * does nothing.
+ */
+class StartupProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    static StartupProfiler*
+    globalInstance();
+
+    StartupProfiler(QObject *parent = 0);
+
+    void
+    setEnabled(bool enabled);
+
+    bool
+    isEnabled() const;
+
+    /**
+     * Starts measuring, timer should be started at the beginning of main().
+     */
+    void
+    start(const QElapsedTimer &timer);
+
+    /**
+     * Ends the current phase (time since the previous mark).
+     */
+    void
+    mark(const QString &phase);
+
+    /**
+     * Marks the first frame when the window is painted, then prints the phases.
+     */
+    void
+    watchFirstFrame(QWidget *window);
+
+    void
+    print();
+
+protected:
+
+    bool
+    eventFilter(QObject *obj, QEvent *event);
+
+private:
+
+    bool
+    m_enabled;
+
+    QElapsedTimer
+    m_timer;
+
+    qint64
+    m_last;
+
+    QList<QPair<QString, qint64>>
+    m_phases;
+
+};
+
+#endif
@@ -13,8 +13,14 @@
 #include <QMessageBox>
 #include <QMenu>
 #include <QKeyEvent>
+#include <QSplitter>
+#include <QListView>
+#include <QScrollBar>
+#include <QTimer>
 
 #include "vsite.hpp"
+#include "feedengine.hpp"
+#include "videolistmodel.hpp"
 
 class SubscriptionsView : public QWidget
 {
@@ -25,6 +31,9 @@ signals:
     void
     openRequested(const QString &address);
 
+    void
+    openVideoSignal(const QString &url, const QVariantMap &item);
+
 public:
 
     SubscriptionsView(QWidget *parent = 0, Qt::WindowFlags flags = 0);
@@ -51,6 +60,18 @@ private slots:
     void
     renameItem(int index);
 
+    /**
+     * Shows the newest videos of all subscriptions (see FeedEngine).
+     */
+    void
+    updateFeed();
+
+    void
+    updateVisibleRows();
+
+    void
+    openFeedItem(const QModelIndex &index);
+
 private:
 
     ProfileSettings
@@ -62,13 +83,24 @@ private:
     QScrollArea
     *m_scr_main;
 
+    QLabel
+    *m_lbl_feed;
+
+    VideoListModel
+    *m_feed_model;
+
+    QListView
+    *m_feed_list;
+
+    QTimer
+    *m_tmr_visible;
+
     QLineEdit
     *m_txt_addr;
 
     QPushButton
     *m_btn_add;
 
-
 };
 
 #endif
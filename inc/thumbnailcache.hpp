@@ -0,0 +1,149 @@
+#ifndef THUMBNAILCACHE_HPP
+#define THUMBNAILCACHE_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QUrl>
+#include <QMap>
+#include <QCache>
+#include <QImage>
+#include <QImageReader>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QRegExp>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QtConcurrent>
+
+#include <functional>
+
+#include "profilesettings.hpp"
+
+/**
+ * ThumbnailCache loads the thumbnails (preview images) of videos and channels,
+ * it's shared by all views.
+ *
+ * Decoded images are kept in memory (LRU, limited by size in bytes),
+ * downloaded images are kept on disk (thumbnails directory in the config dir,
+ * files named by url hash) along with their HTTP validators (ETag, Last-Modified)
+ * and expiry time (server's max-age, default if there is none; no-store
+ * isn't stored). A thumbnail in memory or fresh on disk is shown
+ * without network traffic, a stale one is revalidated (conditional GET).
+ * The disk cache is limited in size, least recently validated files go first.
+ * A url that failed to load is not requested again for a while.
+ *
+ * Requests for a url that is already being loaded are added to that request,
+ * the image is downloaded and decoded once.
+ */
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    typedef std::function<void(const QImage&)> Callback;
+
+    typedef std::function<void()> FailureCallback;
+
+    static ThumbnailCache*
+    globalInstance();
+
+    ThumbnailCache(QObject *parent = 0);
+
+    /**
+     * Loads the image, callback is called with it when it's available
+     * (right away if it's in memory), unless the receiver has been deleted.
+     * If the image cannot be loaded, failed_cb is called instead (if set).
+     */
+    void
+    load(const QUrl &url, QObject *receiver, Callback cb, FailureCallback failed_cb = FailureCallback());
+
+    /**
+     * Image if it's in memory, null image otherwise.
+     */
+    QImage
+    cachedImage(const QUrl &url);
+
+private:
+
+    struct Request
+    {
+        QPointer<QObject> receiver;
+        Callback cb;
+        FailureCallback failed_cb;
+    };
+
+    struct Entry
+    {
+        QString etag;
+        QString last_modified;
+        qint64 expires; //ms since epoch
+    };
+
+    static QImage
+    decodeImage(const QByteArray &bytes);
+
+    QString
+    filePath(const QUrl &url, const QString &suffix) const;
+
+    bool
+    readEntry(const QUrl &url, Entry &entry);
+
+    void
+    writeEntry(const QUrl &url, const Entry &entry);
+
+    void
+    fetch(const QUrl &url, const Entry &cached, bool has_cached);
+
+    /**
+     * Decodes the data (in the pool), writes it to disk if store is set.
+     * Without data, the file on disk is decoded.
+     */
+    void
+    decode(const QUrl &url, const QByteArray &bytes, bool store);
+
+    void
+    deliver(const QUrl &url, const QImage &image);
+
+    void
+    pruneDisk();
+
+    QString
+    m_cache_dir;
+
+    qint64
+    m_max_age; //ms, if the server doesn't say
+
+    qint64
+    m_max_disk_size; //bytes
+
+    int
+    m_stored_count; //since the last pruning
+
+    //Url -> time (ms since epoch) until it's not requested again
+    QMap<QString, qint64>
+    m_failed;
+
+    QCache<QString, QImage>
+    m_images;
+
+    QMap<QString, QList<Request>>
+    m_pending;
+
+    QNetworkAccessManager
+    *m_network;
+
+    QThreadPool
+    m_pool;
+
+};
+
+#endif
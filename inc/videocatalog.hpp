@@ -0,0 +1,82 @@
+#ifndef VIDEOCATALOG_HPP
+#define VIDEOCATALOG_HPP
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+#include <QMap>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "profilesettings.hpp"
+#include "libraryindex.hpp"
+
+/**
+ * VideoCatalog keeps the metadata of every video the sites have returned
+ * (channel pages, feed refreshes) in the library index, so videos
+ * can be found again offline, across all sites.
+ *
+ * Titles, descriptions and channel names are split into tokens
+ * (lower case, without accents), each token is stored with a weight
+ * (title words count more than description words). A search looks up
+ * the tokens of the query (the index is sorted by token, so a prefix
+ * is a range lookup) and ranks the videos by the sum of the weights.
+ *
+ * Items are written in the background, searching runs in the caller's thread.
+ */
+class VideoCatalog : public QObject
+{
+    Q_OBJECT
+
+signals:
+
+    void
+    updated();
+
+public:
+
+    static VideoCatalog*
+    globalInstance();
+
+    /**
+     * Splits the text into search tokens (words, numbers),
+     * lower case, accents removed.
+     */
+    static QStringList
+    tokenize(const QString &text);
+
+    /**
+     * Publication time (ms since epoch) of a video item,
+     * the site's "published" value may be in seconds or an ISO date.
+     */
+    static qint64
+    publishedTime(const QVariantMap &item);
+
+    VideoCatalog(QObject *parent = 0);
+
+    /**
+     * Adds the video items of a site (list returned by get_channel_videos).
+     */
+    void
+    addItems(const QUrl &site_url, const QString &channel, const QVariantList &items);
+
+    /**
+     * Videos matching all words of the query, best match first.
+     */
+    QVariantList
+    search(const QString &query, int limit = 200);
+
+private:
+
+    static QList<QVariantMap>
+    prepareVideos(const QUrl &site_url, const QString &channel, const QVariantList &items);
+
+    QThreadPool
+    m_pool;
+
+};
+
+#endif
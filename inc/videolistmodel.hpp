@@ -0,0 +1,166 @@
+#ifndef VIDEOLISTMODEL_HPP
+#define VIDEOLISTMODEL_HPP
+
+#include <QDebug>
+#include <QAbstractListModel>
+#include <QStyledItemDelegate>
+#include <QAbstractItemView>
+#include <QListView>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QApplication>
+#include <QSet>
+#include <QUrl>
+
+#include "thumbnailcache.hpp"
+
+/**
+ * VideoListModel holds the video items of a channel (or search),
+ * as returned by the site (maps with title, url, thumbnail...).
+ *
+ * Thumbnails are not kept in the model, they're taken from the
+ * ThumbnailCache when a row is painted. The view requests them
+ * for the rows around the viewport only (fetchThumbnails()).
+ *
+ * Items are added page by page (infinite scroll). Pages far from
+ * the viewport can be evicted, their rows stay (as empty placeholders)
+ * so the scroll position doesn't change, until the page is set again.
+ */
+class VideoListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+
+    enum Role
+    {
+        ItemRole = Qt::UserRole, //QVariantMap
+        ThumbnailUrlRole,
+    };
+
+    VideoListModel(QObject *parent = 0);
+
+    /**
+     * Relative thumbnail and video urls are resolved against the site url.
+     */
+    void
+    setSiteUrl(const QUrl &url);
+
+    /**
+     * Replaces the list with the first page, page numbers are the site's (0-based).
+     */
+    void
+    setItems(const QVariantList &items, int page = 0, int page_size = 20);
+
+    /**
+     * Sets the items of a page, the next page is appended.
+     * Returns false if the page doesn't fit (gap or before first page).
+     */
+    bool
+    setPage(int page, const QVariantList &items);
+
+    /**
+     * Drops the items of the pages outside of the range.
+     */
+    void
+    evictPages(int first_keep, int last_keep);
+
+    bool
+    isPageLoaded(int page) const;
+
+    int
+    pageOfRow(int row) const;
+
+    int
+    firstPage() const;
+
+    /**
+     * Page after the last row.
+     */
+    int
+    nextPage() const;
+
+    QVariantMap
+    item(int row) const;
+
+    int
+    rowCount(const QModelIndex &parent = QModelIndex()) const;
+
+    QVariant
+    data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    /**
+     * Loads the thumbnails of the rows (disk or network),
+     * rows are updated when they're available.
+     */
+    void
+    fetchThumbnails(int first, int last);
+
+    /**
+     * List view of the model, rows painted by VideoListDelegate
+     * (uniform height, scrolled per pixel, no selection).
+     */
+    QListView*
+    createListView(QWidget *parent = 0);
+
+    /**
+     * Rows in the viewport of the list, false if there are none
+     * (empty list or not laid out yet).
+     */
+    static bool
+    visibleRows(QListView *list, int &first, int &last);
+
+private:
+
+    QVariantMap
+    prepareItem(const QVariantMap &item) const;
+
+    QUrl
+    m_site_url;
+
+    QVariantList
+    m_items;
+
+    int
+    m_first_page;
+
+    int
+    m_page_size;
+
+    QSet<int>
+    m_loaded_pages;
+
+    //Thumbnails being loaded
+    QSet<QString>
+    m_fetching;
+
+};
+
+/**
+ * VideoListDelegate paints a row of the video list:
+ * thumbnail on the left, title (link) on the right, line below.
+ * Scaled thumbnails are kept in the QPixmapCache, scrolling only blits them.
+ */
+class VideoListDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+
+    VideoListDelegate(QObject *parent = 0);
+
+    void
+    paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    QSize
+    sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    /**
+     * Rect of the thumbnail in a row.
+     */
+    static QRect
+    thumbnailRect(const QRect &row_rect);
+
+};
+
+#endif
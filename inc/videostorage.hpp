@@ -12,12 +12,24 @@
 #include <QMimeDatabase>
 #include <QCryptographicHash>
 #include <QTemporaryFile>
+#include <QSet>
+#include <QSharedPointer>
+#include <QAtomicInt>
 #include <QFuture>
 #include <QtConcurrent>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
 #include "profilesettings.hpp"
+#include "libraryindex.hpp"
+#include "downloadmanager.hpp"
+#include "partialfile.hpp"
+#include "cacheproxy.hpp"
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
 class DLWatcher;
 class VideoStorage : public QObject
@@ -60,10 +72,10 @@ public:
 
     ~VideoStorage();
 
-    QString
+    static QString
     tempPath();
 
-    QString
+    static QString
     importPath();
 
     QFile*
@@ -106,6 +118,20 @@ public:
     DLWatcher*
     downloadViaTool(const QString &address, QString temp_file = "");
 
+    /**
+     * Priority of the downloads started by this instance,
+     * see DownloadManager::Priority. Running downloads are updated.
+     */
+    void
+    setDownloadPriority(int priority);
+
+    /**
+     * Returns the temp file of a running (or completed) download
+     * of this instance, to be played while it's downloaded.
+     */
+    QSharedPointer<PartialFile>
+    partialFile(const QString &file_path);
+
     /**
      * Start HTTP download and run callback (cb) when done.
      * If temp_file is blank, a new temp file is created.
@@ -157,9 +183,40 @@ public:
     //bool
     //contains(const QVariantMap &context); //TODO remove this because calculating hash is slow
 
+    /**
+     * Hashes the file (md5, hex) in chunks, returns an empty string
+     * if it cannot be read or if abort is set while reading.
+     */
+    static QString
+    fileHash(const QString &file_path, const QAtomicInt *abort = 0);
+
+    /**
+     * Looks for a file in the library with the same content
+     * as the specified file (content-addressed lookup by hash and size).
+     * Returns { hash_md5 } and, if a matching file exists, { file }.
+     */
     QVariantMap
     findMatchingFile(const QString &copy_file_path);
 
+    /**
+     * Summarizes duplicate files in the library (same content):
+     * { groups, files, reclaimable }
+     * Files that are already hard links to the same data
+     * are not counted as reclaimable.
+     * Stats every file, should not run in the GUI thread.
+     */
+    static QVariantMap
+    duplicateReport();
+
+    /**
+     * Replaces duplicate files in the library with hard links
+     * to the oldest copy, returns the number of bytes freed.
+     * Files on different volumes or changed since indexing are skipped.
+     * Data of a duplicate counts as freed when its last link is replaced.
+     */
+    static qint64
+    linkDuplicates();
+
     QString
     determineImportFilename(const QString &file_path, const QVariantMap &context);
 
@@ -190,8 +247,40 @@ public:
     void
     scheduleImportFile(const QString &file_path, const QString &src_address, const QVariantMap &context, bool move_file = false);
 
+private slots:
+
+    /**
+     * Download of the file is over, it's no longer found by partialFile().
+     */
+    void
+    releasePartialFile(const QString &file_path);
+
 private:
 
+    /**
+     * Tells the cache proxy that an imported file has been moved away.
+     */
+    void
+    releaseCacheFile(const QString &file_path);
+
+    QNetworkReply*
+    startHttpDownload(int job, const QUrl &url, QFile *file);
+
+    void
+    fetchRange(const QString &file_path, qint64 offset);
+
+    /**
+     * Downloads the missing ranges of a partial file, one after the other,
+     * each one until it runs into data that's already there
+     * (cache file of a streamed video, see CacheProxy, or seek ranges).
+     * The partial file is the temp file of the download.
+     */
+    void
+    downloadPartialFile(const QUrl &url, QSharedPointer<PartialFile> cache);
+
+    void
+    fetchMissingRange(int job, const QUrl &url, QSharedPointer<PartialFile> cache, QSharedPointer<QPointer<QNetworkReply>> reply_ptr);
+
     //QPointer<ProfileSettings> //TODO parent pointer
     //m_settings;
     ProfileSettings
@@ -203,6 +292,18 @@ private:
     QPointer<QNetworkAccessManager>
     m_network;
 
+    int
+    m_download_priority;
+
+    QList<int>
+    m_download_jobs;
+
+    QMap<QString, QSharedPointer<PartialFile>>
+    m_partial_files;
+
+    QMap<QString, QPointer<QNetworkReply>>
+    m_range_replies;
+
 };
 
 class DLWatcher : public QObject
@@ -220,6 +321,12 @@ signals:
     void
     downloadProgressed(double p);
 
+    /**
+     * Downloaded bytes, total is -1 if unknown.
+     */
+    void
+    downloadBytesProgressed(qint64 bytes, qint64 total);
+
     void
     downloadFailed(const QString &err = "");
 
@@ -248,6 +355,9 @@ private:
     void
     init_dst(QFile *dst_file);
 
+    static QStringList
+    progressArguments();
+
     void
     tryDetermineFilename();
 
@@ -256,11 +366,26 @@ public:
     QString
     filePath();
 
+    /**
+     * Limits the download rate (bytes per second), before start().
+     */
+    void
+    setRateLimit(qint64 bytes_per_sec);
+
+    /**
+     * Total size is exact (total_bytes), not an estimate.
+     */
+    bool
+    isTotalExact() const;
+
 public slots:
 
     void
     start();
 
+    void
+    stop();
+
 private slots:
 
     void
@@ -270,10 +395,10 @@ private slots:
     transferChunk();
 
     void
-    checkStatus(const QString &line);
+    readStatusError();
 
     void
-    checkStatus();
+    emitProgress();
 
     void
     checkStateError(QProcess::ProcessError error);
@@ -286,6 +411,16 @@ private slots:
 
 private:
 
+    /**
+     * Reads complete lines from the process output (partial line is kept
+     * in buffer for the next call), updates progress.
+     */
+    void
+    readStatus(const QByteArray &data, QByteArray &buffer);
+
+    bool
+    checkStatus(const QByteArray &line);
+
     QPointer<ProfileSettings>
     m_settings;
 
@@ -310,6 +445,27 @@ private:
     QString
     m_tpl_filename;
 
+    QByteArray
+    m_out_buffer;
+
+    QByteArray
+    m_err_buffer;
+
+    QByteArray
+    m_err_output;
+
+    qint64
+    m_bytes_done;
+
+    qint64
+    m_bytes_total;
+
+    bool
+    m_bytes_total_exact;
+
+    double
+    m_percent;
+
 };
 
 #endif
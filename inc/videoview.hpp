@@ -18,6 +18,9 @@
 #include "vlcplayer.hpp"
 #include "vsite.hpp"
 #include "videostorage.hpp"
+#include "libraryscanner.hpp"
+#include "resumepositions.hpp"
+#include "sourceranker.hpp"
 #include "gui.hpp"
 
 class VideoView : public QWidget
@@ -44,11 +47,31 @@ private:
     void
     initWidgets();
 
+    void
+    ensurePlayer();
+
     void
     recreatePlayer();
 
 public:
 
+    /**
+     * Idle views can be replaced by a placeholder (tab hibernation),
+     * not while playing or downloading.
+     */
+    bool
+    canHibernate();
+
+    /**
+     * { source, time } - selected source and playback time (ms),
+     * to continue there when the view is created again.
+     */
+    QVariantMap
+    state();
+
+    void
+    restoreState(const QVariantMap &state);
+
     void
     setPlayOnSelect(bool enabled = true);
 
@@ -70,6 +93,11 @@ public:
     void
     loadContext();
 
+protected:
+
+    void
+    showEvent(QShowEvent *event);
+
 private slots:
 
     void
@@ -93,6 +121,9 @@ private slots:
     void
     completeDownloadedVideo();
 
+    void
+    handleRemoteMatch(const QString &address, const QString &file);
+
     //void
     //addContext(const QVariantMap &ctx);
 
@@ -129,14 +160,38 @@ private slots:
     void
     selectSource();
 
+    void
+    sourcesRanked(const QList<QUrl> &order);
+
+    /**
+     * A source is good enough to start with, before all probes are done.
+     */
+    void
+    sourceReady(const QUrl &url);
+
+    /**
+     * Playback stalled or failed, continues with the next best source.
+     */
+    void
+    handlePlaybackStall();
+
     void
     importVideo();
 
 private:
 
+    void
+    connectPlayer();
+
+    static bool
+    isAdaptiveStream(const QVariantMap &item);
+
     bool
     isEmpty();
 
+    bool
+    isPlaying();
+
     int
     indexOfSourceItem(const QUrl &url);
 
@@ -163,6 +218,20 @@ private:
     int
     m_src_index;
 
+    //Sources ordered by expected start time, see SourceRanker
+    QList<QUrl>
+    m_src_order;
+
+    QList<QUrl>
+    m_stalled_sources;
+
+    bool
+    m_src_user_selected;
+
+    //Started with a good enough source, not replaced by the ranking
+    bool
+    m_src_ready_selected;
+
     QString
     m_temp_file;
 
@@ -184,6 +253,18 @@ private:
     bool
     m_play_on_select;
 
+    bool
+    m_match_requested;
+
+    QUrl
+    m_restore_source;
+
+    qint64
+    m_restore_time;
+
+    QStringList
+    m_resume_keys;
+
     QWidget
     *m_wid_player;
 
@@ -226,6 +307,9 @@ private:
     VideoStorage
     *m_storage;
 
+    SourceRanker
+    *m_ranker;
+
 };
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef VLCINSTANCE_HPP
+#define VLCINSTANCE_HPP
+
+#include <QDebug>
+#include <QStringList>
+#include <QMutex>
+#include <QVector>
+
+#include <vlc/vlc.h>
+
+/**
+ * VlcInstance is the libvlc instance shared by all players
+ * (and the library scanner) of the process.
+ *
+ * Creating a libvlc instance loads the plugin cache and module bank,
+ * with a few restored video tabs, that dominated startup time and memory.
+ * The instance is created when it's acquired the first time
+ * and destroyed when the last user has released it.
+ *
+ * Arguments (caching etc.) apply to the next instance that is created,
+ * options of a single video are set on its media instead.
+ */
+class VlcInstance
+{
+
+public:
+
+    static void
+    setArguments(const QStringList &args);
+
+    static QStringList
+    arguments();
+
+    /**
+     * Returns the shared instance (with a new reference), 0 on error.
+     */
+    static libvlc_instance_t*
+    acquire();
+
+    static void
+    release(libvlc_instance_t *instance);
+
+private:
+
+    static QMutex
+    m_mutex;
+
+    static QStringList
+    m_args;
+
+    static libvlc_instance_t
+    *m_instance;
+
+    static int
+    m_refs;
+
+};
+
+#endif
@@ -11,9 +11,19 @@
 #include <QUrl>
 #include <QDateTime>
 #include <QLabel>
+#include <QMouseEvent>
+#include <QStyle>
+#include <QPainter>
+
+#include <QSharedPointer>
+#include <QAtomicInt>
 
 #include <vlc/vlc.h>
 
+#include "partialfile.hpp"
+#include "vlcinstance.hpp"
+#include "seekpreviews.hpp"
+
 class VlcPlayer : public QWidget
 {
     Q_OBJECT
@@ -26,6 +36,31 @@ signals:
     void
     stopped();
 
+    /**
+     * libvlc reports that playback is running (true)
+     * or paused/stopped (false).
+     */
+    void
+    playingChanged(bool playing);
+
+    /**
+     * Playback failed (libvlc error), the player has been stopped.
+     */
+    void
+    failed();
+
+    /**
+     * Playback has not advanced for the stall timeout (waiting for data).
+     */
+    void
+    stalled();
+
+    /**
+     * Playback time (ms) has changed, emitted while playing.
+     */
+    void
+    timeChanged(qint64 time);
+
 public:
 
     VlcPlayer(const QUrl &url = QUrl(), QWidget *parent = 0);
@@ -40,11 +75,48 @@ public:
     double
     position() const;
 
+    /**
+     * Playback time in ms, -1 if nothing is loaded.
+     */
+    qint64
+    time() const;
+
+    /**
+     * The next video that is loaded starts at the given time (ms).
+     */
+    void
+    setStartTime(qint64 time);
+
+    /**
+     * Adds a media option (":name=value") to the next video that is loaded.
+     */
+    void
+    addMediaOption(const QString &option);
+
+    /**
+     * Length of the video in ms, 0 if unknown.
+     */
+    qint64
+    duration() const;
+
+    /**
+     * Time (ms) without progress after which stalled() is emitted, 0 to disable.
+     */
+    void
+    setStallTimeout(int timeout);
+
 public slots:
 
     void
     load(const QUrl &url);
 
+    /**
+     * Plays a file that's still being downloaded, libvlc reads it
+     * through the PartialFile (reads wait for the data).
+     */
+    void
+    load(QSharedPointer<PartialFile> stream);
+
     void
     integrateWidget();
 
@@ -69,11 +141,53 @@ public slots:
     void
     updateInterface();
 
+protected:
+
+    void
+    showEvent(QShowEvent *event);
+
+    /**
+     * Shows the seek preview while the mouse is over the position slider.
+     */
+    bool
+    eventFilter(QObject *watched, QEvent *event);
+
 private:
 
+    void
+    showSeekPreview(int x);
+
+    /**
+     * Receives player events (position, length, state) in a libvlc thread,
+     * they're passed on to the GUI thread, so there's no polling.
+     */
+    static void
+    vlcEvent(const libvlc_event_t *event, void *opaque);
+
+    static QList<int>
+    playerEventTypes();
+
+    void
+    attachEvents();
+
+    void
+    detachEvents();
+
+    void
+    handleEvent(int serial, int type, double position, qint64 ms); //ms: length or time
+
     void
     init();
 
+    void
+    setMedia(libvlc_media_t *media);
+
+    void
+    releaseStream();
+
+    void
+    applyMediaOptions();
+
     libvlc_instance_t
     *m_vlc_instance;
 
@@ -86,6 +200,24 @@ private:
     QUrl
     m_url;
 
+    QSharedPointer<PartialFile>
+    m_stream;
+
+    qint64
+    m_start_time;
+
+    QStringList
+    m_media_options;
+
+    QAtomicInt
+    m_media_serial;
+
+    double
+    m_position;
+
+    qint64
+    m_duration; //ms
+
     int
     m_last_volume;
 
@@ -110,6 +242,15 @@ private:
     QSlider
     *m_position_slider;
 
+    QString
+    m_preview_file;
+
+    QLabel
+    *m_lbl_preview;
+
+    QTimer
+    *m_tmr_stall;
+
     QWidget
     *m_video_widget;
 
@@ -14,8 +14,12 @@
 #include <QRegExp>
 #include <QPixmap>
 #include <QElapsedTimer>
+#include <QCache>
+#include <QDateTime>
 
 #include "profilesettings.hpp"
+#include "thumbnailcache.hpp"
+#include "videocatalog.hpp"
 
 class ActionContext;
 typedef QSharedPointer<ActionContext> ActionContextPtr;
@@ -68,6 +72,14 @@ public:
     virtual void
     loadVideos(int index = -1) = 0;
 
+    /**
+     * Loads a page of the current video list (channel or search)
+     * without moving the page cursor, the result is sent with loadedVideoPage()
+     * only. Pages loaded recently are taken from the response cache.
+     */
+    virtual void
+    loadVideoPage(int index) = 0;
+
     QString
     currentChannel() const;
 
@@ -152,6 +164,13 @@ public slots:
     void
     setValue(const QVariant &value);
 
+    /**
+     * The view could not provide the value (e.g., page helper failed),
+     * the action fails.
+     */
+    void
+    setError();
+
 signals:
 
     void
@@ -166,6 +185,9 @@ signals:
     void
     gotResult(const QVariant &value, ActionContextRef ctx = ActionContextRef());
 
+    void
+    gotError(ActionContextRef ctx);
+
     void
     finished(const QVariant &value);
     //ctx is passed as QPointer because caller should not prevent deletion
@@ -201,6 +223,12 @@ signals:
     void
     loadedVideoList(const QVariantList &items);
 
+    /**
+     * Page of the video list, also sent for loadChannelVideos() and loadVideos().
+     */
+    void
+    loadedVideoPage(int index, const QVariantList &items);
+
     void
     loadedThumbnail(const QPixmap &pixmap, QObject *obj = 0);
 
@@ -310,6 +338,17 @@ public slots:
     void
     loadVideos(int index = -1);
 
+    void
+    loadVideoPage(int index);
+
+    /**
+     * Loads a page of the channel's videos published after since (ms),
+     * without moving the page cursor. Plans that cannot filter by date
+     * return the whole page. Sent with loadedVideoPage(), not cached.
+     */
+    ActionContextPtr
+    loadChannelVideosSince(qint64 since, int index = 0);
+
     void
     loadThumbnail(const QString &url, QObject *obj);
 
@@ -336,6 +375,9 @@ private slots:
     void
     handleError(const ActionContextPtr ctx);
 
+    void
+    handleError(const ActionContextRef ref);
+
     void
     parseReply(QNetworkReply *reply);
 
@@ -401,6 +443,12 @@ private:
     QVariantMap
     globalVariables();
 
+    QVariantMap
+    pageVariables(int index);
+
+    QString
+    pageCacheKey(const QString &action, int index);
+
     VSite*
     getOrCreateControlInstance();
 
@@ -425,6 +473,16 @@ private:
     QPointer<VSite>
     _auth_instance;
 
+    struct CachedPage
+    {
+        QVariantList items;
+        qint64 time;
+    };
+
+    //Video list responses by action, channel and page, cost is the item count
+    QCache<QString, CachedPage>
+    _page_cache;
+
 };
 
 #endif
@@ -0,0 +1,21 @@
+TARGET = peerplayer-auth
+DESTDIR = bin/
+
+# Login page helper, the only part that uses QtWebEngine
+# started by the player when a site needs it (load_auth)
+CONFIG -= app_bundle
+
+HEADERS = auth/authpage.hpp
+SOURCES = auth/main.cpp auth/authpage.cpp
+OBJECTS_DIR = obj-auth/
+MOC_DIR = obj-auth/
+INCLUDEPATH = auth/
+
+QT += widgets
+QT += webengine
+QT += webenginewidgets
+
+DEFINES += PROGRAM=\\\"PeerPlayer\\\"
+DEFINES += QT_MESSAGELOGCONTEXT
+
+QMAKE_CXXFLAGS += -Werror=return-type
@@ -0,0 +1,53 @@
+TARGET = peerplayer-cli
+DESTDIR = bin/
+
+# Console version, only the modules that don't need widgets
+# (site actions, feed, catalog, library, downloads)
+CONFIG += console
+CONFIG -= app_bundle
+
+HEADERS = \
+    cli/peerplayercli.hpp \
+    inc/version.hpp \
+    inc/settingsmanager.hpp \
+    inc/profilesettings.hpp \
+    inc/libraryindex.hpp \
+    inc/thumbnailcache.hpp \
+    inc/videocatalog.hpp \
+    inc/vsite.hpp \
+    inc/feedengine.hpp \
+    inc/partialfile.hpp \
+    inc/cacheproxy.hpp \
+    inc/downloadmanager.hpp \
+    inc/videostorage.hpp
+SOURCES = \
+    cli/main.cpp \
+    cli/peerplayercli.cpp \
+    src/settingsmanager.cpp \
+    src/profilesettings.cpp \
+    src/libraryindex.cpp \
+    src/thumbnailcache.cpp \
+    src/videocatalog.cpp \
+    src/vsite.cpp \
+    src/feedengine.cpp \
+    src/partialfile.cpp \
+    src/cacheproxy.cpp \
+    src/downloadmanager.cpp \
+    src/videostorage.cpp
+OBJECTS_DIR = obj-cli/
+MOC_DIR = obj-cli/
+RCC_DIR = obj-cli/
+INCLUDEPATH = inc/ cli/
+
+RESOURCES += cli/cli.qrc
+
+# QtGui for QImage (thumbnails), no widgets, no webengine
+QT -= widgets
+QT += network
+QT += concurrent
+QT += sql
+
+DEFINES += PROGRAM=\\\"PeerPlayer\\\"
+DEFINES += QT_MESSAGELOGCONTEXT
+
+QMAKE_CXXFLAGS += -Werror=return-type
@@ -10,9 +10,8 @@ RESOURCES += res/res.qrc
 
 QT += widgets
 QT += network
-QT += webengine
-QT += webenginewidgets
 QT += concurrent
+QT += sql
 
 DEFINES += PROGRAM=\\\"PeerPlayer\\\"
 # TODO TEST
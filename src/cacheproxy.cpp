@@ -0,0 +1,448 @@
+#include "cacheproxy.hpp"
+
+CacheProxy*
+CacheProxy::globalInstance()
+{
+    static QPointer<CacheProxy> global_instance;
+    if (!global_instance)
+        global_instance = new CacheProxy(qApp);
+    return global_instance;
+}
+
+CacheProxy::CacheProxy(QObject *parent)
+          : QObject(parent),
+            m_server(new QTcpServer(this)),
+            m_network(new QNetworkAccessManager(this)),
+            m_cache_dir(QDir::tempPath())
+{
+    ProfileSettings::profile()->setDefaultVariant("stream_cache_size", 4096);
+
+    connect(m_server, SIGNAL(newConnection()), SLOT(handleConnection()));
+}
+
+CacheProxy::~CacheProxy()
+{
+    //Cache files are not kept, an imported video has been copied
+    foreach (const Entry &entry, m_entries)
+    {
+        if (entry.upstream) entry.upstream->abort();
+        entry.file->interruptReaders();
+        QFile::remove(entry.file->filePath());
+    }
+    foreach (const Client &client, m_clients)
+        delete client.file;
+}
+
+void
+CacheProxy::setCacheDirectory(const QString &dir_path)
+{
+    m_cache_dir = dir_path;
+}
+
+QUrl
+CacheProxy::proxyUrl(const QUrl &url)
+{
+    if (!listen()) return url;
+
+    QString id = entryId(url);
+    //Cache file moved or removed by someone else, start over
+    if (m_entries.contains(id) && m_entries[id].file->bytesAvailable() > 0 &&
+        !QFile::exists(m_entries[id].file->filePath()))
+        removeEntry(id, false);
+    if (!m_entries.contains(id))
+    {
+        QString file_path = QDir(m_cache_dir).absoluteFilePath(QString("stream.%1.part").arg(id));
+        QFile::remove(file_path); //left over, ranges unknown
+        Entry entry;
+        entry.url = url;
+        entry.file = QSharedPointer<PartialFile>(new PartialFile(file_path));
+        entry.upstream_pos = -1;
+        entry.failed = false;
+        entry.claimed = false;
+        connect(entry.file.data(), SIGNAL(dataWritten(qint64, qint64)), SLOT(serveClients()));
+        m_entries[id] = entry;
+        qDebug() << "cache proxy - new entry" << id << url;
+    }
+    m_entries[id].last_used = QDateTime::currentMSecsSinceEpoch();
+    trimCache(id);
+
+    //File name is kept, the player may look at the extension
+    QUrl proxy_url;
+    proxy_url.setScheme("http");
+    proxy_url.setHost("127.0.0.1");
+    proxy_url.setPort(m_server->serverPort());
+    proxy_url.setPath(QString("/%1/%2").arg(id).arg(url.fileName()));
+    return proxy_url;
+}
+
+QSharedPointer<PartialFile>
+CacheProxy::cacheFile(const QUrl &url)
+{
+    QString id = entryId(url);
+    if (!m_entries.contains(id)) return QSharedPointer<PartialFile>();
+    m_entries[id].claimed = true;
+    return m_entries[id].file;
+}
+
+void
+CacheProxy::releaseFile(const QString &file_path)
+{
+    foreach (const QString &id, m_entries.keys())
+    {
+        if (m_entries[id].file->filePath() == file_path)
+            removeEntry(id, false);
+    }
+}
+
+void
+CacheProxy::handleConnection()
+{
+    while (m_server->hasPendingConnections())
+    {
+        QTcpSocket *socket = m_server->nextPendingConnection();
+        Client client;
+        client.file = 0;
+        client.pos = 0;
+        client.end = -1;
+        client.range = false;
+        client.headers_sent = false;
+        m_clients[socket] = client;
+
+        connect(socket, SIGNAL(readyRead()), SLOT(readRequest()));
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]()
+        {
+            serveClient(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            delete m_clients.take(socket).file;
+            socket->deleteLater();
+        });
+    }
+}
+
+void
+CacheProxy::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !m_clients.contains(socket)) return;
+    Client &client = m_clients[socket];
+    if (!client.id.isEmpty()) return; //one request per connection
+    client.request += socket->readAll();
+
+    //Wait for complete request header
+    int header_end = client.request.indexOf("\r\n\r\n");
+    if (header_end == -1)
+    {
+        if (client.request.size() > 16384) sendError(socket, "400 Bad Request");
+        return;
+    }
+    QString header = QString::fromLatin1(client.request.left(header_end));
+    QString request_line = header.section("\r\n", 0, 0);
+    QString method = request_line.section(' ', 0, 0);
+    QString path = request_line.section(' ', 1, 1);
+    QString id = path.section('/', 1, 1);
+    if (method != "GET" || !m_entries.contains(id))
+    {
+        sendError(socket, method != "GET" ? "405 Method Not Allowed" : "404 Not Found");
+        return;
+    }
+
+    //Player seeks with range requests
+    QRegExp rx_range("\\nRange:\\s*bytes=(\\d+)-(\\d*)", Qt::CaseInsensitive);
+    if (rx_range.indexIn(header) != -1)
+    {
+        client.range = true;
+        client.pos = rx_range.cap(1).toLongLong();
+        if (!rx_range.cap(2).isEmpty())
+            client.end = rx_range.cap(2).toLongLong();
+    }
+    client.id = id;
+    client.file = new QFile(m_entries[id].file->filePath());
+    m_entries[id].last_used = QDateTime::currentMSecsSinceEpoch();
+    qDebug() << "cache proxy - request" << id << client.pos << client.end;
+
+    serveClient(socket);
+}
+
+void
+CacheProxy::serveClients()
+{
+    foreach (QTcpSocket *socket, m_clients.keys())
+        serveClient(socket);
+}
+
+void
+CacheProxy::serveClient(QTcpSocket *socket)
+{
+    if (!m_clients.contains(socket)) return;
+    Client &client = m_clients[socket];
+    if (client.id.isEmpty() || socket->state() != QAbstractSocket::ConnectedState) return;
+    if (!m_entries.contains(client.id))
+    {
+        socket->disconnectFromHost();
+        return;
+    }
+    QSharedPointer<PartialFile> file = m_entries[client.id].file;
+
+    //Size must be known for the response header, it's in the first upstream response
+    if (!client.headers_sent)
+    {
+        qint64 size = file->size();
+        if (size < 0)
+        {
+            if (m_entries[client.id].failed && !m_entries[client.id].upstream)
+                sendError(socket, "502 Bad Gateway");
+            else
+                fetchUpstream(client.id, client.pos);
+            return;
+        }
+        sendHeaders(socket, client, size);
+        if (!client.headers_sent) return;
+    }
+
+    //Pass on cached data, don't buffer more than necessary
+    while (client.pos <= client.end && socket->bytesToWrite() < 1024 * 1024)
+    {
+        qint64 available = file->availableFrom(client.pos);
+        if (available <= 0)
+        {
+            if (m_entries[client.id].failed && !m_entries[client.id].upstream)
+                socket->disconnectFromHost();
+            else
+                fetchUpstream(client.id, client.pos);
+            return;
+        }
+        if (!client.file->isOpen() && !client.file->open(QIODevice::ReadOnly))
+        {
+            socket->disconnectFromHost();
+            return;
+        }
+        qint64 count = qMin(qMin(available, client.end + 1 - client.pos), (qint64)256 * 1024);
+        if (!client.file->seek(client.pos)) break;
+        QByteArray data = client.file->read(count);
+        if (data.isEmpty()) break;
+        socket->write(data);
+        client.pos += data.size();
+    }
+
+    //Response complete, connection is closed when the data has been sent
+    if (client.pos > client.end)
+        socket->disconnectFromHost();
+}
+
+void
+CacheProxy::sendHeaders(QTcpSocket *socket, Client &client, qint64 size)
+{
+    if (client.pos >= size && size > 0)
+    {
+        socket->write(QString("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%1\r\n"
+            "Content-Length: 0\r\nConnection: close\r\n\r\n").arg(size).toLatin1());
+        socket->disconnectFromHost();
+        return;
+    }
+    if (client.end < 0 || client.end >= size)
+        client.end = size - 1;
+
+    QString header;
+    if (client.range)
+    {
+        header += "HTTP/1.1 206 Partial Content\r\n";
+        header += QString("Content-Range: bytes %1-%2/%3\r\n").arg(client.pos).arg(client.end).arg(size);
+    }
+    else
+    {
+        header += "HTTP/1.1 200 OK\r\n";
+    }
+    header += QString("Content-Length: %1\r\n").arg(client.end + 1 - client.pos);
+    header += "Content-Type: application/octet-stream\r\n";
+    header += "Accept-Ranges: bytes\r\n";
+    header += "Connection: close\r\n\r\n";
+    socket->write(header.toLatin1());
+    client.headers_sent = true;
+}
+
+void
+CacheProxy::sendError(QTcpSocket *socket, const QByteArray &status)
+{
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    socket->disconnectFromHost();
+}
+
+void
+CacheProxy::fetchUpstream(const QString &id, qint64 offset)
+{
+    if (!m_entries.contains(id)) return;
+    Entry &entry = m_entries[id];
+
+    //Running fetch will get there soon
+    if (entry.upstream && entry.upstream_pos <= offset && offset - entry.upstream_pos < 4 * 1024 * 1024)
+        return;
+    if (entry.upstream)
+    {
+        entry.upstream->setProperty("stopped", true);
+        entry.upstream->abort();
+    }
+
+    QNetworkRequest req(entry.url);
+    req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    if (offset > 0)
+        req.setRawHeader("Range", QString("bytes=%1-").arg(offset).toLatin1());
+    QNetworkReply *reply = m_network->get(req);
+    entry.upstream = reply;
+    entry.upstream_pos = offset;
+    entry.failed = false;
+    qDebug() << "cache proxy - fetching" << entry.url << "from" << offset;
+
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, id, reply]()
+    {
+        if (!m_entries.contains(id) || m_entries[id].upstream != reply) return;
+        Entry &entry = m_entries[id];
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status >= 300 && status < 400) return; //redirect is followed
+        if (status != 200 && status != 206)
+        {
+            //Error page must not end up in the cache file
+            reply->setProperty("bad_status", status);
+            QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+            return;
+        }
+        if (status == 206)
+        {
+            //Content-Range: bytes 100-199/1000
+            QString range = QString::fromLatin1(reply->rawHeader("Content-Range"));
+            qint64 total = range.section('/', 1, 1).toLongLong();
+            if (total > 0) entry.file->setSize(total);
+        }
+        else if (status == 200)
+        {
+            //Server ignored the range, data starts at the beginning
+            entry.upstream_pos = 0;
+            qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+            if (total > 0) entry.file->setSize(total);
+        }
+        serveClients();
+    });
+    connect(reply, &QNetworkReply::readyRead, this, [this, id, reply]()
+    {
+        if (!m_entries.contains(id) || m_entries[id].upstream != reply) return;
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status != 200 && status != 206)
+        {
+            reply->setProperty("bad_status", status);
+            QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+            return;
+        }
+        QSharedPointer<PartialFile> file = m_entries[id].file;
+        qint64 pos = m_entries[id].upstream_pos;
+        QByteArray data = reply->readAll();
+        m_entries[id].upstream_pos = pos + data.size();
+        file->write(pos, data);
+        pos += data.size();
+
+        //Stop when the fetch runs into cached data
+        qint64 size = file->size();
+        if (file->availableFrom(pos) > 0 || (size >= 0 && pos >= size))
+        {
+            reply->setProperty("stopped", true);
+            QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, id, reply]()
+    {
+        reply->deleteLater();
+        if (!m_entries.contains(id) || m_entries[id].upstream != reply) return;
+        Entry &entry = m_entries[id];
+        entry.upstream = 0;
+        if (reply->property("bad_status").isValid())
+        {
+            qWarning() << "cache proxy - fetch failed" << entry.url << "status" << reply->property("bad_status").toInt();
+            entry.failed = true;
+        }
+        else if (reply->error() != QNetworkReply::NoError && !reply->property("stopped").toBool())
+        {
+            qWarning() << "cache proxy - fetch failed" << entry.url << reply->errorString();
+            entry.failed = true;
+        }
+        else if (entry.file->size() < 0)
+        {
+            //No content length, complete now
+            entry.file->setSize(entry.upstream_pos);
+        }
+        serveClients();
+        trimCache(id);
+    });
+}
+
+bool
+CacheProxy::listen()
+{
+    if (m_server->isListening()) return true;
+    if (!m_server->listen(QHostAddress::LocalHost, 0))
+    {
+        qWarning() << "cache proxy - cannot listen" << m_server->errorString();
+        return false;
+    }
+    qInfo() << "cache proxy listening on port" << m_server->serverPort();
+    return true;
+}
+
+QString
+CacheProxy::entryId(const QUrl &url)
+{
+    return QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex().left(16);
+}
+
+void
+CacheProxy::removeEntry(const QString &id, bool remove_file)
+{
+    if (!m_entries.contains(id)) return;
+    Entry entry = m_entries.take(id);
+    if (entry.upstream)
+    {
+        entry.upstream->setProperty("stopped", true);
+        entry.upstream->abort();
+    }
+    entry.file->interruptReaders();
+    entry.file->disconnect(this);
+    if (remove_file) QFile::remove(entry.file->filePath());
+
+    //Player requests the proxy url again
+    foreach (QTcpSocket *socket, m_clients.keys())
+    {
+        if (m_clients[socket].id == id)
+            socket->disconnectFromHost();
+    }
+    qDebug() << "cache proxy - removed entry" << id << entry.url;
+}
+
+void
+CacheProxy::trimCache(const QString &keep_id)
+{
+    qint64 limit = ProfileSettings::profile()->variant("stream_cache_size").toLongLong() * 1024 * 1024;
+    if (limit <= 0) return; //unlimited
+
+    qint64 total = 0;
+    foreach (const Entry &entry, m_entries)
+        total += entry.file->bytesAvailable();
+
+    //Files being played or imported are kept
+    QSet<QString> busy;
+    busy << keep_id;
+    foreach (const Client &client, m_clients)
+        busy << client.id;
+    while (total > limit)
+    {
+        QString oldest;
+        foreach (const QString &id, m_entries.keys())
+        {
+            const Entry &entry = m_entries[id];
+            if (busy.contains(id) || entry.claimed) continue;
+            if (oldest.isEmpty() || entry.last_used < m_entries[oldest].last_used)
+                oldest = id;
+        }
+        if (oldest.isEmpty()) break;
+        total -= m_entries[oldest].file->bytesAvailable();
+        removeEntry(oldest, true);
+    }
+}
@@ -0,0 +1,387 @@
+#include "downloadmanager.hpp"
+
+DownloadManager*
+DownloadManager::globalInstance()
+{
+    static QPointer<DownloadManager> global_instance;
+    if (!global_instance)
+        global_instance = new DownloadManager(qApp);
+    return global_instance;
+}
+
+DownloadManager::DownloadManager(QObject *parent)
+               : QObject(parent),
+                 m_next_id(1)
+{
+    //Rates are configured in KiB/s, 0 means unlimited
+    ProfileSettings *settings = ProfileSettings::profile();
+    settings->setDefaultVariant("download_max_concurrent", 2);
+    settings->setDefaultVariant("download_rate_limit", 0);
+    settings->setDefaultVariant("download_rate_while_playing", 1024);
+    settings->setDefaultVariant("download_history", 20);
+
+    //Bandwidth is handed out in small slices, progress is reported less often
+    m_tmr_tick.setInterval(100);
+    connect(&m_tmr_tick, SIGNAL(timeout()), SLOT(tick()));
+}
+
+int
+DownloadManager::maxConcurrent()
+{
+    return qMax(1, ProfileSettings::profile()->variant("download_max_concurrent").toInt());
+}
+
+void
+DownloadManager::setMaxConcurrent(int count)
+{
+    ProfileSettings::profile()->setVariant("download_max_concurrent", qMax(1, count));
+    scheduleJobs();
+}
+
+qint64
+DownloadManager::rateLimit()
+{
+    return ProfileSettings::profile()->variant("download_rate_limit").toLongLong() * 1024;
+}
+
+void
+DownloadManager::setRateLimit(qint64 bytes_per_sec)
+{
+    ProfileSettings::profile()->setVariant("download_rate_limit", qMax((qint64)0, bytes_per_sec / 1024));
+}
+
+int
+DownloadManager::addJob(const QString &title, int priority, std::function<void(int)> start, std::function<void()> abort)
+{
+    Job job;
+    job.id = m_next_id++;
+    job.title = title;
+    job.priority = priority;
+    job.state = Queued;
+    job.bytes = 0;
+    job.total = -1;
+    job.speed = 0;
+    job.last_bytes = 0;
+    job.tokens = 0;
+    job.start = start;
+    job.abort = abort;
+    m_jobs[job.id] = job;
+    qDebug() << "download job added:" << job.id << title << "priority" << priority;
+    emit jobAdded(job.id);
+
+    //Start it (or not) when the caller has connected its signals
+    QTimer::singleShot(0, this, SLOT(scheduleJobs()));
+    return job.id;
+}
+
+void
+DownloadManager::setPriority(int id, int priority)
+{
+    if (!m_jobs.contains(id) || m_jobs[id].priority == priority) return;
+    m_jobs[id].priority = priority;
+    emit jobChanged(id);
+    scheduleJobs();
+}
+
+void
+DownloadManager::attachReply(int id, QNetworkReply *reply, std::function<void(const QByteArray&)> write)
+{
+    if (!m_jobs.contains(id)) return;
+    Job &job = m_jobs[id];
+    job.reply = reply;
+    job.write = write;
+
+    //Limited read buffer: if the job does not read, Qt stops reading
+    //from the socket, so the sender has to slow down (TCP flow control)
+    qint64 rate = jobRate(job);
+    reply->setReadBufferSize(rate ? qMax(rate, (qint64)65536) : 0);
+    job.tokens = rate / 4;
+    connect(reply, &QNetworkReply::readyRead, this, [this, id]()
+    {
+        if (m_jobs.contains(id)) readReply(m_jobs[id]);
+    });
+}
+
+void
+DownloadManager::drainReply(int id, std::function<void()> done)
+{
+    if (!m_jobs.contains(id) || !m_jobs[id].reply || !m_jobs[id].write)
+    {
+        QTimer::singleShot(0, this, done);
+        return;
+    }
+    m_jobs[id].done = done;
+    readReply(m_jobs[id]);
+}
+
+void
+DownloadManager::updateJob(int id, qint64 bytes, qint64 total)
+{
+    if (!m_jobs.contains(id)) return;
+    m_jobs[id].bytes = bytes;
+    m_jobs[id].total = total;
+}
+
+void
+DownloadManager::finishJob(int id, bool failed)
+{
+    if (!m_jobs.contains(id)) return;
+    Job &job = m_jobs[id];
+    if (job.state == Finished || job.state == Failed) return;
+    job.state = failed ? Failed : Finished;
+    job.reply = 0;
+    job.write = nullptr;
+    job.done = nullptr;
+    job.speed = 0;
+    qDebug() << "download job done:" << id << (failed ? "failed" : "finished");
+    emit jobChanged(id);
+    pruneFinished();
+
+    //Free slot for next job
+    scheduleJobs();
+}
+
+void
+DownloadManager::cancelJob(int id)
+{
+    if (!m_jobs.contains(id)) return;
+    std::function<void()> abort = m_jobs[id].abort;
+    if (m_jobs[id].state == Active && abort)
+        abort();
+    finishJob(id, true);
+}
+
+void
+DownloadManager::clearFinished()
+{
+    foreach (int id, m_jobs.keys())
+    {
+        int state = m_jobs[id].state;
+        if (state != Finished && state != Failed) continue;
+        m_jobs.remove(id);
+        emit jobRemoved(id);
+    }
+}
+
+void
+DownloadManager::pruneFinished()
+{
+    //Oldest first (ids are ascending)
+    int keep = ProfileSettings::profile()->variant("download_history").toInt();
+    QList<int> done;
+    foreach (const Job &job, m_jobs)
+    {
+        if (job.state == Finished || job.state == Failed)
+            done << job.id;
+    }
+    for (int i = 0; i < done.size() - qMax(keep, 0); i++)
+    {
+        m_jobs.remove(done[i]);
+        emit jobRemoved(done[i]);
+    }
+}
+
+qint64
+DownloadManager::rateLimitFor(int id)
+{
+    if (!m_jobs.contains(id)) return 0;
+    return jobRate(m_jobs[id]);
+}
+
+QList<int>
+DownloadManager::jobs()
+{
+    return m_jobs.keys();
+}
+
+QVariantMap
+DownloadManager::jobInfo(int id)
+{
+    QVariantMap info;
+    if (!m_jobs.contains(id)) return info;
+    const Job &job = m_jobs[id];
+    info["id"] = job.id;
+    info["title"] = job.title;
+    info["priority"] = job.priority;
+    info["state"] = job.state;
+    info["bytes"] = job.bytes;
+    info["total"] = job.total;
+    info["speed"] = job.speed;
+    return info;
+}
+
+void
+DownloadManager::setPlaybackActive(QObject *player, bool active)
+{
+    bool was_active = isPlaybackActive();
+    if (active && !m_players.contains(player))
+    {
+        m_players << player;
+        connect(player, &QObject::destroyed, this, [this, player]()
+        {
+            m_players.remove(player);
+            if (m_players.isEmpty())
+                emit playbackActiveChanged(false);
+        });
+    }
+    else if (!active && m_players.contains(player))
+    {
+        m_players.remove(player);
+        disconnect(player, SIGNAL(destroyed(QObject*)), this, 0);
+    }
+    if (isPlaybackActive() != was_active)
+        emit playbackActiveChanged(isPlaybackActive());
+}
+
+bool
+DownloadManager::isPlaybackActive()
+{
+    return !m_players.isEmpty();
+}
+
+void
+DownloadManager::scheduleJobs()
+{
+    int active = 0;
+    QList<int> queued;
+    foreach (const Job &job, m_jobs)
+    {
+        if (job.state == Active)
+            active++;
+        else if (job.state == Queued)
+            queued << job.id;
+    }
+
+    //Highest priority first, oldest first (ids are ascending)
+    std::stable_sort(queued.begin(), queued.end(), [this](int a, int b)
+    {
+        return m_jobs[a].priority > m_jobs[b].priority;
+    });
+    foreach (int id, queued)
+    {
+        //A start function may finish its job right away, which schedules again:
+        //jobs started by that nested call are skipped, active is counted anew
+        if (!m_jobs.contains(id) || m_jobs[id].state != Queued) continue;
+        active = 0;
+        foreach (const Job &job, m_jobs)
+            if (job.state == Active) active++;
+
+        //A playback job does not wait, the user is watching it
+        if (m_jobs[id].priority < Playback && active >= maxConcurrent()) continue;
+        m_jobs[id].state = Active;
+        active++;
+        qDebug() << "download job started:" << id << m_jobs[id].title;
+        emit jobChanged(id);
+        std::function<void(int)> start = m_jobs[id].start;
+        if (start) start(id);
+    }
+
+    active = 0;
+    foreach (const Job &job, m_jobs)
+        if (job.state == Active) active++;
+    if (active && !m_tmr_tick.isActive())
+    {
+        m_tick_clock.start();
+        m_report_clock.start();
+        m_tmr_tick.start();
+    }
+}
+
+void
+DownloadManager::tick()
+{
+    qint64 ms = m_tick_clock.restart();
+    bool report = m_report_clock.elapsed() >= 500;
+    qint64 report_ms = report ? m_report_clock.restart() : 0;
+
+    int active = 0;
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ++it)
+    {
+        Job &job = it.value();
+        if (job.state != Active) continue;
+        active++;
+
+        //Refill token bucket (max. half a second worth of data)
+        if (job.reply)
+        {
+            qint64 rate = jobRate(job);
+            if (rate)
+            {
+                job.tokens = qMin(job.tokens + rate * ms / 1000, qMax(rate / 2, (qint64)16384));
+                job.reply->setReadBufferSize(qMax(rate, (qint64)65536));
+            }
+            else
+            {
+                job.reply->setReadBufferSize(0);
+            }
+            readReply(job);
+        }
+
+        if (report && report_ms > 0)
+        {
+            job.speed = (job.bytes - job.last_bytes) * 1000 / report_ms;
+            job.last_bytes = job.bytes;
+            emit jobChanged(job.id);
+        }
+    }
+
+    if (!active)
+        m_tmr_tick.stop();
+}
+
+qint64
+DownloadManager::jobRate(const Job &job)
+{
+    //Weight by priority: background 1, normal 2, playback 4
+    int weight = 1 << job.priority;
+    int weight_sum = 0, weight_sum_bg = 0;
+    foreach (const Job &other, m_jobs)
+    {
+        if (other.state != Active) continue;
+        weight_sum += 1 << other.priority;
+        if (other.priority < Playback)
+            weight_sum_bg += 1 << other.priority;
+    }
+    weight_sum = qMax(weight_sum, weight);
+    weight_sum_bg = qMax(weight_sum_bg, weight);
+
+    //Share of the global limit
+    qint64 rate = 0;
+    qint64 limit = rateLimit();
+    if (limit > 0)
+        rate = qMax((qint64)1024, limit * weight / weight_sum);
+
+    //Share of the limit for jobs that compete with a playing stream
+    qint64 limit_playing = ProfileSettings::profile()->variant("download_rate_while_playing").toLongLong() * 1024;
+    if (isPlaybackActive() && job.priority < Playback && limit_playing > 0)
+    {
+        qint64 rate_bg = qMax((qint64)1024, limit_playing * weight / weight_sum_bg);
+        rate = rate ? qMin(rate, rate_bg) : rate_bg;
+    }
+
+    return rate;
+}
+
+void
+DownloadManager::readReply(Job &job)
+{
+    if (!job.reply || !job.write) return;
+    qint64 rate = jobRate(job);
+    qint64 size = job.reply->bytesAvailable();
+    if (rate) size = qMin(size, job.tokens);
+    if (size > 0)
+    {
+        QByteArray data = job.reply->read(size);
+        if (rate) job.tokens -= data.size();
+        job.bytes += data.size();
+        job.write(data);
+    }
+
+    //Finished reply has been read completely
+    //done is queued, it finishes the job (called while iterating the jobs)
+    if (job.done && job.reply->isFinished() && !job.reply->bytesAvailable())
+    {
+        QTimer::singleShot(0, this, job.done);
+        job.done = nullptr;
+    }
+}
@@ -0,0 +1,110 @@
+#include "downloadsview.hpp"
+
+DownloadsView::DownloadsView(QWidget *parent)
+             : QWidget(parent)
+{
+    QVBoxLayout *vbox = new QVBoxLayout;
+    setLayout(vbox);
+
+    m_tree = new QTreeWidget;
+    m_tree->setRootIsDecorated(false);
+    m_tree->setHeaderLabels(QStringList() << tr("Video") << tr("Status") << tr("Progress") << tr("Speed"));
+    m_tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    vbox->addWidget(m_tree);
+
+    QHBoxLayout *hbox_buttons = new QHBoxLayout;
+    QPushButton *btn_cancel = new QPushButton(tr("Cancel"));
+    connect(btn_cancel, SIGNAL(clicked()), SLOT(cancelSelected()));
+    hbox_buttons->addWidget(btn_cancel);
+    QPushButton *btn_clear = new QPushButton(tr("Clear finished"));
+    connect(btn_clear, SIGNAL(clicked()), SLOT(clearFinished()));
+    hbox_buttons->addWidget(btn_clear);
+    hbox_buttons->addStretch();
+    vbox->addLayout(hbox_buttons);
+
+    //Show current jobs, then follow the manager
+    DownloadManager *manager = DownloadManager::globalInstance();
+    foreach (int id, manager->jobs())
+        addJob(id);
+    connect(manager, SIGNAL(jobAdded(int)), SLOT(addJob(int)));
+    connect(manager, SIGNAL(jobChanged(int)), SLOT(updateJob(int)));
+    connect(manager, SIGNAL(jobRemoved(int)), SLOT(removeJob(int)));
+
+}
+
+void
+DownloadsView::addJob(int id)
+{
+    if (m_items.contains(id)) return;
+    QTreeWidgetItem *item = new QTreeWidgetItem(m_tree);
+    item->setData(0, Qt::UserRole, id);
+    QProgressBar *bar = new QProgressBar;
+    bar->setRange(0, 0); //busy until the size is known
+    m_tree->setItemWidget(item, 2, bar);
+    m_items[id] = item;
+    updateJob(id);
+}
+
+void
+DownloadsView::updateJob(int id)
+{
+    if (!m_items.contains(id)) return;
+    QVariantMap info = DownloadManager::globalInstance()->jobInfo(id);
+    QTreeWidgetItem *item = m_items[id];
+
+    item->setText(0, info["title"].toString());
+    item->setToolTip(0, info["title"].toString());
+    int state = info["state"].toInt();
+    QString status;
+    if (state == DownloadManager::Queued)
+        status = tr("Queued");
+    else if (state == DownloadManager::Active)
+        status = info["priority"].toInt() == DownloadManager::Playback ? tr("Playing") : tr("Downloading");
+    else if (state == DownloadManager::Finished)
+        status = tr("Finished");
+    else
+        status = tr("Failed");
+    item->setText(1, status);
+
+    QProgressBar *bar = qobject_cast<QProgressBar*>(m_tree->itemWidget(item, 2));
+    qint64 bytes = info["bytes"].toLongLong();
+    qint64 total = info["total"].toLongLong();
+    if (bar && state == DownloadManager::Finished)
+    {
+        bar->setRange(0, 100);
+        bar->setValue(100);
+    }
+    else if (bar && total > 0)
+    {
+        bar->setRange(0, 1000);
+        bar->setValue(bytes * 1000 / total);
+    }
+    else if (bar && state != DownloadManager::Active)
+    {
+        bar->setRange(0, 100);
+        bar->setValue(0);
+    }
+
+    qint64 speed = info["speed"].toLongLong();
+    item->setText(3, state == DownloadManager::Active ? locale().formattedDataSize(speed) + "/s" : "");
+}
+
+void
+DownloadsView::removeJob(int id)
+{
+    if (!m_items.contains(id)) return;
+    delete m_items.take(id);
+}
+
+void
+DownloadsView::cancelSelected()
+{
+    foreach (QTreeWidgetItem *item, m_tree->selectedItems())
+        DownloadManager::globalInstance()->cancelJob(item->data(0, Qt::UserRole).toInt());
+}
+
+void
+DownloadsView::clearFinished()
+{
+    DownloadManager::globalInstance()->clearFinished();
+}
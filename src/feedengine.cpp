@@ -0,0 +1,377 @@
+#include "feedengine.hpp"
+
+//Head of a channel list in the feed merge
+struct FeedHead
+{
+    qint64 published;
+    int channel;
+    int index;
+};
+
+//Newest first, ties in channel order
+struct FeedHeadOrder
+{
+    bool
+    operator()(const FeedHead &a, const FeedHead &b) const
+    {
+        if (a.published != b.published) return a.published < b.published;
+        if (a.channel != b.channel) return a.channel > b.channel;
+        return a.index > b.index;
+    }
+};
+
+FeedEngine*
+FeedEngine::globalInstance()
+{
+    static QPointer<FeedEngine> global_instance;
+    if (!global_instance)
+        global_instance = new FeedEngine(qApp);
+    return global_instance;
+}
+
+FeedEngine::FeedEngine(QObject *parent)
+          : QObject(parent),
+            m_refresh_pending(false)
+{
+    ProfileSettings *settings = ProfileSettings::profile();
+    m_parallel_limit = qMax(1, settings->setDefaultVariant("feed_parallel_limit", 6).toInt());
+    m_domain_limit = qMax(1, settings->setDefaultVariant("feed_domain_limit", 2).toInt());
+    m_feed_size = settings->setDefaultVariant("feed_size", 200).toInt();
+
+    //Stored feed, shown before the first refresh
+    m_channels = LibraryIndex::globalInstance()->feedItems();
+    mergeFeed();
+
+    m_tmr_refresh = new QTimer(this);
+    connect(m_tmr_refresh, SIGNAL(timeout()), SLOT(refresh()));
+}
+
+void
+FeedEngine::startSchedule()
+{
+    int minutes = ProfileSettings::profile()->setDefaultVariant("feed_refresh_minutes", 30).toInt();
+    if (minutes <= 0) return;
+    m_tmr_refresh->start(minutes * 60 * 1000);
+    //First refresh after startup, when the main window is up
+    QTimer::singleShot(5000, this, SLOT(refresh()));
+}
+
+QVariantList
+FeedEngine::feed() const
+{
+    return m_feed;
+}
+
+bool
+FeedEngine::isRefreshing() const
+{
+    return !m_queue.isEmpty() || !m_jobs.isEmpty();
+}
+
+void
+FeedEngine::refresh()
+{
+    //Subscription list changed during a refresh, refresh again when it's done
+    if (isRefreshing())
+    {
+        m_refresh_pending = true;
+        return;
+    }
+    m_refresh_pending = false;
+
+    QSet<QString> urls;
+    foreach (const QVariant &var, ProfileSettings::profile()->variant("subscription_list").toList())
+    {
+        QVariantMap subscription = var.toMap();
+        QString url = subscription.value("url").toString();
+        if (url.isEmpty() || urls.contains(url)) continue;
+        urls << url;
+        m_queue << subscription;
+    }
+
+    //Forget channels that have been unsubscribed
+    bool removed = false;
+    foreach (const QString &url, m_channels.keys())
+    {
+        if (urls.contains(url)) continue;
+        m_channels.remove(url);
+        LibraryIndex::globalInstance()->removeFeedItems(url);
+        removed = true;
+    }
+    if (removed)
+    {
+        mergeFeed();
+        emit feedChanged();
+    }
+
+    qInfo() << "refreshing subscription feed" << m_queue.size();
+    if (m_queue.isEmpty())
+        emit refreshFinished();
+    startJobs();
+}
+
+void
+FeedEngine::startJobs()
+{
+    //Start queued channels, skipping those whose site is busy
+    int i = 0;
+    while (i < m_queue.size() && m_jobs.size() < m_parallel_limit)
+    {
+        QString domain = QUrl(m_queue[i].value("url").toString()).host();
+        if (m_domain_jobs.value(domain) >= m_domain_limit)
+        {
+            i++;
+            continue;
+        }
+        startJob(m_queue.takeAt(i));
+    }
+}
+
+void
+FeedEngine::startJob(const QVariantMap &subscription)
+{
+    QString url = subscription.value("url").toString();
+    Job &job = m_jobs[url];
+    job.subscription = subscription;
+    job.domain = QUrl(url).host();
+    job.since = 0;
+    job.page = 0;
+    m_domain_jobs[job.domain]++;
+
+    //Jobs that hang (no reply, login page) don't block the queue
+    job.tmr_timeout = new QTimer(this);
+    job.tmr_timeout->setSingleShot(true);
+    connect(job.tmr_timeout, &QTimer::timeout, this, [this, url]()
+    {
+        qInfo() << "subscription feed - timeout" << url;
+        finishJob(url, false);
+    });
+    job.tmr_timeout->start(60 * 1000);
+
+    //Compatibility check may run an event loop, the job may have timed out
+    QPointer<VSite> site = VSite::load(url, this);
+    if (!m_jobs.contains(url))
+    {
+        if (site) site->deleteLater();
+        return;
+    }
+    m_jobs[url].site = site;
+    if (!site)
+    {
+        qWarning() << "subscription feed - cannot load site" << url;
+        finishJob(url, false);
+        return;
+    }
+
+    //Newest video seen in the last refresh, only newer ones are requested
+    QVariantMap watermark = LibraryIndex::globalInstance()->feedWatermark(url);
+    m_jobs[url].since = watermark.value("published").toLongLong();
+    m_jobs[url].known_address = watermark.value("address").toString();
+
+    connect(site, &VSite::loadedVideoPage, this, [this, url](int index, const QVariantList &items)
+    {
+        addPage(url, index, items);
+    });
+
+    //Channel info saved with the subscription, no need to ask the site again
+    QVariantMap channel = subscription.value("channel").toMap();
+    if (!channel.isEmpty())
+    {
+        site->setChannel(channel);
+        loadPage(url, 0);
+        return;
+    }
+
+    //Channel info first (sets the channel), then its videos
+    auto load_videos = [this, url]()
+    {
+        loadPage(url, 0);
+    };
+    connect(site, &VSite::gotChannelInfo, this, load_videos);
+    connect(site, &VSite::gotChannelName, this, load_videos);
+    ActionContextPtr ctx = site->loadChannel();
+    if (!ctx)
+    {
+        finishJob(url, false);
+        return;
+    }
+    connect(ctx.data(), &ActionContext::failed, this, [this, url]()
+    {
+        finishJob(url, false);
+    });
+}
+
+void
+FeedEngine::loadPage(const QString &url, int index)
+{
+    if (!m_jobs.contains(url)) return;
+    Job &job = m_jobs[url];
+    if (!job.site) return;
+    job.page = index;
+    ActionContextPtr ctx = job.site->loadChannelVideosSince(job.since, index);
+    if (!ctx)
+    {
+        finishJob(url, false);
+        return;
+    }
+    connect(ctx.data(), &ActionContext::failed, this, [this, url]()
+    {
+        finishJob(url, false);
+    });
+}
+
+void
+FeedEngine::addPage(const QString &url, int index, const QVariantList &items)
+{
+    if (!m_jobs.contains(url)) return;
+    Job &job = m_jobs[url];
+    if (!job.site || index != job.page) return;
+
+    //Items up to the watermark are stored already, paging stops there
+    //(sites that can filter by date don't send them in the first place)
+    bool has_watermark = job.since > 0 || !job.known_address.isEmpty();
+    bool reached_known = false;
+    foreach (const QVariant &var, prepareItems(job.subscription, job.site->siteUrl(), items))
+    {
+        QVariantMap item = var.toMap();
+        qint64 published = item.value("published").toLongLong();
+        if (has_watermark && ((published > 0 && published <= job.since) ||
+            item.value("address").toString() == job.known_address))
+        {
+            reached_known = true;
+            continue;
+        }
+        job.items << item;
+    }
+
+    //Whole page is new, there may be more (first refresh only takes one page)
+    int max_pages = ProfileSettings::profile()->setDefaultVariant("feed_max_pages", 5).toInt();
+    if (has_watermark && !reached_known && items.size() >= job.site->pageSize() && index + 1 < max_pages)
+    {
+        loadPage(url, index + 1);
+        return;
+    }
+    finishJob(url, true);
+}
+
+void
+FeedEngine::finishJob(const QString &url, bool ok)
+{
+    if (!m_jobs.contains(url)) return;
+    Job job = m_jobs.take(url);
+    job.tmr_timeout->deleteLater();
+    if (--m_domain_jobs[job.domain] <= 0)
+        m_domain_jobs.remove(job.domain);
+
+    if (ok && job.items.isEmpty())
+    {
+        qDebug() << "subscription feed - no new videos" << url;
+    }
+    else if (ok)
+    {
+        //New items are added to the stored ones, the oldest are dropped
+        int keep = ProfileSettings::profile()->setDefaultVariant("feed_channel_items", 50).toInt();
+        QVariantList new_items = job.items;
+        LibraryIndex::globalInstance()->setFeedItems(url, new_items, keep);
+
+        QSet<QString> addresses;
+        foreach (const QVariant &var, new_items)
+            addresses << var.toMap().value("address").toString();
+        QVariantList channel_items = new_items;
+        foreach (const QVariant &var, m_channels.value(url))
+        {
+            if (!addresses.contains(var.toMap().value("address").toString()))
+                channel_items << var;
+        }
+        std::stable_sort(channel_items.begin(), channel_items.end(), [](const QVariant &a, const QVariant &b)
+        {
+            return a.toMap().value("published").toLongLong() > b.toMap().value("published").toLongLong();
+        });
+        m_channels[url] = channel_items.mid(0, keep);
+
+        //Next refresh starts after the newest video
+        QVariantMap newest = channel_items.first().toMap();
+        LibraryIndex::globalInstance()->setFeedWatermark(url,
+            newest.value("published").toLongLong(), newest.value("address").toString());
+
+        mergeFeed();
+        emit feedChanged();
+    }
+    else
+    {
+        qInfo() << "subscription feed - failed to refresh" << url;
+    }
+
+    //Don't delete the site in its own signal
+    if (job.site)
+    {
+        job.site->disconnect(this);
+        job.site->deleteLater();
+    }
+
+    if (!isRefreshing())
+    {
+        qInfo() << "subscription feed refreshed" << m_feed.size();
+        emit refreshFinished();
+        if (m_refresh_pending)
+            QMetaObject::invokeMethod(this, "refresh", Qt::QueuedConnection);
+        return;
+    }
+    QMetaObject::invokeMethod(this, "startJobs", Qt::QueuedConnection);
+}
+
+QVariantList
+FeedEngine::prepareItems(const QVariantMap &subscription, const QUrl &site_url, const QVariantList &items) const
+{
+    //Feed mixes sites, relative addresses are resolved here
+    QVariantList prepared;
+    foreach (const QVariant &var, items)
+    {
+        QVariantMap item = var.toMap();
+        QString video_url = item.value("url").toString();
+        if (video_url.isEmpty()) continue;
+        item["address"] = site_url.resolved(QUrl(video_url)).toString();
+        QString thumbnail_url = item.value("thumbnail").toString();
+        if (thumbnail_url.startsWith("/"))
+            item["thumbnail"] = site_url.resolved(QUrl(thumbnail_url)).toString();
+        item["_site_url"] = site_url.url();
+        item["subscription"] = subscription.value("url");
+        item["channel_title"] = subscription.value("title");
+        item["published"] = VideoCatalog::publishedTime(item);
+        prepared << item;
+    }
+    return prepared;
+}
+
+void
+FeedEngine::mergeFeed()
+{
+    //k-way merge of the channel lists (each sorted newest first),
+    //stops when the feed is full, the rest is never looked at
+    QList<QVariantList> lists = m_channels.values();
+    std::priority_queue<FeedHead, std::vector<FeedHead>, FeedHeadOrder> heads;
+    for (int i = 0; i < lists.size(); i++)
+    {
+        if (lists[i].isEmpty()) continue;
+        heads.push({ lists[i][0].toMap().value("published").toLongLong(), i, 0 });
+    }
+
+    QVariantList feed;
+    QSet<QString> addresses;
+    while (!heads.empty() && feed.size() < m_feed_size)
+    {
+        FeedHead head = heads.top();
+        heads.pop();
+        QVariantMap item = lists[head.channel][head.index].toMap();
+        QString address = item.value("address").toString();
+        if (!addresses.contains(address))
+        {
+            addresses << address;
+            feed << item;
+        }
+        int next = head.index + 1;
+        if (next < lists[head.channel].size())
+            heads.push({ lists[head.channel][next].toMap().value("published").toLongLong(), head.channel, next });
+    }
+    m_feed = feed;
+}
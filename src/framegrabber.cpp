@@ -0,0 +1,207 @@
+#include "framegrabber.hpp"
+
+QList<double>
+FrameGrabber::fingerprintPositions()
+{
+    //8 frames, leave out intro and credits
+    QList<double> positions;
+    for (int i = 1; i <= 8; i++)
+        positions << 0.1 * i;
+    return positions;
+}
+
+quint64
+FrameGrabber::dHash(const QImage &frame)
+{
+    if (frame.isNull()) return 0;
+    QImage gray = frame.convertToFormat(QImage::Format_Grayscale8)
+        .scaled(9, 8, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    quint64 hash = 0;
+    for (int y = 0; y < 8; y++)
+    {
+        const uchar *line = gray.constScanLine(y);
+        for (int x = 0; x < 8; x++)
+        {
+            hash <<= 1;
+            if (line[x] < line[x + 1])
+                hash |= 1;
+        }
+    }
+    return hash;
+}
+
+QList<quint64>
+FrameGrabber::fingerprint(const QList<QImage> &frames)
+{
+    QList<quint64> hashes;
+    foreach (const QImage &frame, frames)
+        hashes << dHash(frame);
+    return hashes;
+}
+
+FrameGrabber::FrameGrabber(libvlc_instance_t *vlc_instance, const QAtomicInt *abort, const QSize &size)
+            : m_vlc_instance(vlc_instance),
+              m_abort(abort),
+              m_pause(0),
+              m_size(size),
+              m_frame_serial(0),
+              m_duration(-1),
+              m_keep_missing(false)
+{
+    //Buffer vlc decodes into (RV32 is QImage::Format_RGB32)
+    m_buffer = QImage(m_size, QImage::Format_RGB32);
+}
+
+void
+FrameGrabber::setKeepMissing(bool enabled)
+{
+    m_keep_missing = enabled;
+}
+
+void
+FrameGrabber::setPauseFlag(const QAtomicInt *pause)
+{
+    m_pause = pause;
+}
+
+QList<QImage>
+FrameGrabber::grabFrames(const QString &mrl, const QList<double> &positions, int timeout)
+{
+    QList<QImage> frames;
+    m_duration = -1;
+    if (!m_vlc_instance) return frames;
+
+    libvlc_media_t *media;
+    if (mrl.contains("://"))
+        media = libvlc_media_new_location(m_vlc_instance, mrl.toUtf8().constData());
+    else
+        media = libvlc_media_new_path(m_vlc_instance, QFile::encodeName(mrl).constData());
+    if (!media) return frames;
+    libvlc_media_add_option(media, ":no-audio");
+    libvlc_media_add_option(media, ":no-spu");
+    libvlc_media_add_option(media, ":no-osd");
+    libvlc_media_add_option(media, ":avcodec-threads=1");
+
+    //Render into our buffer instead of a window
+    libvlc_media_player_t *player = libvlc_media_player_new_from_media(media);
+    libvlc_media_release(media);
+    if (!player) return frames;
+    libvlc_video_set_callbacks(player, lockCallback, unlockCallback, displayCallback, this);
+    libvlc_video_set_format(player, "RV32", m_size.width(), m_size.height(), m_size.width() * 4);
+
+    m_mutex.lock();
+    m_frame_serial = 0;
+    m_mutex.unlock();
+    libvlc_media_player_play(player);
+
+    //Wait for playback to start (first frame), then jump to each position
+    if (waitForFrame(1, timeout * 2))
+    {
+        m_duration = libvlc_media_player_get_length(player);
+        foreach (double pos, positions)
+        {
+            if (isAborted()) break;
+            if (isPaused())
+            {
+                libvlc_media_player_set_pause(player, 1);
+                while (isPaused() && !isAborted())
+                    QThread::msleep(100);
+                libvlc_media_player_set_pause(player, 0);
+                if (isAborted()) break;
+            }
+            m_mutex.lock();
+            int serial = m_frame_serial;
+            m_mutex.unlock();
+            libvlc_media_player_set_position(player, pos);
+
+            //Frames decoded right after the seek may be from before the seek
+            //Wait until the player reports the new position
+            QElapsedTimer timer;
+            timer.start();
+            bool found = false;
+            while (!found && timer.elapsed() < timeout && !isAborted())
+            {
+                if (!waitForFrame(++serial, timeout - timer.elapsed())) break;
+                found = qAbs(libvlc_media_player_get_position(player) - pos) < 0.02;
+            }
+            if (!found)
+            {
+                qDebug() << "frame grabber - no frame at" << pos << mrl;
+                if (m_keep_missing) frames << QImage();
+                continue;
+            }
+            QMutexLocker locker(&m_mutex);
+            frames << m_frame;
+        }
+    }
+    else
+    {
+        qDebug() << "frame grabber - cannot play" << mrl;
+    }
+
+    libvlc_media_player_stop(player);
+    libvlc_media_player_release(player);
+    return frames;
+}
+
+qint64
+FrameGrabber::duration() const
+{
+    return m_duration;
+}
+
+void*
+FrameGrabber::lockCallback(void *opaque, void **planes)
+{
+    FrameGrabber *grabber = static_cast<FrameGrabber*>(opaque);
+    planes[0] = grabber->m_buffer.bits();
+    return 0;
+}
+
+void
+FrameGrabber::unlockCallback(void *opaque, void *picture, void *const *planes)
+{
+    Q_UNUSED(opaque);
+    Q_UNUSED(picture);
+    Q_UNUSED(planes);
+}
+
+void
+FrameGrabber::displayCallback(void *opaque, void *picture)
+{
+    Q_UNUSED(picture);
+    FrameGrabber *grabber = static_cast<FrameGrabber*>(opaque);
+    QMutexLocker locker(&grabber->m_mutex);
+    grabber->m_frame = grabber->m_buffer.copy();
+    grabber->m_frame_serial++;
+    grabber->m_frame_ready.wakeAll();
+}
+
+bool
+FrameGrabber::waitForFrame(int serial, int timeout)
+{
+    QMutexLocker locker(&m_mutex);
+    QElapsedTimer timer;
+    timer.start();
+    while (m_frame_serial < serial)
+    {
+        //Wake up now and then to check abort flag
+        int left = timeout - timer.elapsed();
+        if (left <= 0 || isAborted()) return false;
+        m_frame_ready.wait(&m_mutex, qMin(left, 200));
+    }
+    return true;
+}
+
+bool
+FrameGrabber::isAborted() const
+{
+    return m_abort && m_abort->loadRelaxed();
+}
+
+bool
+FrameGrabber::isPaused() const
+{
+    return m_pause && m_pause->loadRelaxed();
+}
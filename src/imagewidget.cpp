@@ -2,6 +2,9 @@
 
 ImageWidget::ImageWidget(bool fixed, QWidget *parent)
            : QLabel(parent),
+             m_scaled_key(0),
+             m_decode_serial(0),
+             m_decoding(false),
              m_limit_h(false),
              m_last_adjusted_height(0)
 {
@@ -39,19 +42,62 @@ ImageWidget::enforceHeight(bool fixed)
 void
 ImageWidget::setPixmap(const QPixmap &pixmap)
 {
+    //Pixmap replaces any image that is still being decoded
+    m_decode_serial++;
+    m_decoding = false;
+    m_bytes.clear();
+    m_source_size = pixmap.size();
     m_pixmap = pixmap;
+    updateScaledPixmap();
+    updateSize();
+    updateGeometry();
     update();
 }
 
+void
+ImageWidget::setImage(const QImage &image)
+{
+    setPixmap(QPixmap::fromImage(image));
+}
+
 void
 ImageWidget::setPixmap(const QByteArray &bytes)
 {
+    m_bytes = bytes;
+    m_source_size = QSize();
+    startDecoding();
+}
+
+QThreadPool*
+ImageWidget::decodePool()
+{
+    //Shared by all image widgets, leaves cores for the player
+    static QThreadPool *pool = 0;
+    if (!pool)
+    {
+        pool = new QThreadPool(qApp);
+        pool->setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));
+    }
+    return pool;
+}
+
+ImageWidget::DecodedImage
+ImageWidget::decodeImage(const QByteArray &bytes, int width)
+{
+    //Called in the decoding pool
+    DecodedImage decoded;
     QByteArray bytes_copy(bytes);
     QBuffer buffer(&bytes_copy);
     buffer.open(QIODevice::ReadOnly);
     QImageReader reader(&buffer);
-    QPixmap pix = QPixmap::fromImageReader(&reader);
-    if (pix.isNull())
+    reader.setAutoTransform(true);
+
+    //JPEG decoder can scale while decoding, much faster than scaling afterwards
+    decoded.source_size = reader.size();
+    if (width > 0 && decoded.source_size.width() > width)
+        reader.setScaledSize(decoded.source_size.scaled(width, decoded.source_size.height(), Qt::KeepAspectRatio));
+    decoded.image = reader.read();
+    if (decoded.image.isNull())
     {
         //failed to parse pixmap
         //if bytes > 0: check if imageformats dir/link exists in bin/
@@ -66,7 +112,62 @@ ImageWidget::setPixmap(const QByteArray &bytes)
         }
         qInfo() << "supported image formats:" << formats.join(", ").toUtf8().data();
     }
-    setPixmap(pix);
+    return decoded;
+}
+
+void
+ImageWidget::startDecoding()
+{
+    if (m_bytes.isEmpty()) return;
+    int serial = ++m_decode_serial;
+    m_decoding = true;
+
+    //Result of an older request (widget resized, new image) is dropped
+    QByteArray bytes = m_bytes;
+    int width = decodeWidth();
+    QFutureWatcher<DecodedImage> *watcher = new QFutureWatcher<DecodedImage>(this);
+    connect(watcher, &QFutureWatcher<DecodedImage>::finished, this, [this, watcher, serial]()
+    {
+        watcher->deleteLater();
+        if (serial != m_decode_serial) return;
+        m_decoding = false;
+        DecodedImage decoded = watcher->result();
+        m_source_size = decoded.source_size;
+        m_pixmap = QPixmap::fromImage(decoded.image);
+        updateScaledPixmap();
+        updateSize();
+        updateGeometry();
+        update();
+    });
+    watcher->setFuture(QtConcurrent::run(decodePool(), &ImageWidget::decodeImage, bytes, width));
+}
+
+void
+ImageWidget::updateScaledPixmap()
+{
+    //Scaled once per size, not in every paint event
+    if (m_pixmap.isNull())
+    {
+        m_scaled_pixmap = QPixmap();
+        m_scaled_key = 0;
+        return;
+    }
+    QSize size = m_pixmap.size();
+    size.scale(this->size(), Qt::KeepAspectRatio);
+    if (size.isEmpty()) return;
+    if (m_scaled_key == m_pixmap.cacheKey() && m_scaled_pixmap.size() == size) return;
+    m_scaled_key = m_pixmap.cacheKey();
+    if (size == m_pixmap.size())
+        m_scaled_pixmap = m_pixmap;
+    else
+        m_scaled_pixmap = m_pixmap.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+int
+ImageWidget::decodeWidth() const
+{
+    //Widget may not have its final size yet (not laid out), 320 is a typical thumbnail width
+    return qMax(width(), 320) * devicePixelRatioF();
 }
 
 QSize
@@ -128,22 +229,9 @@ ImageWidget::paintEvent(QPaintEvent *event)
     if (m_pixmap.isNull())
         return;
 
-    //Create painter
+    //Draw the pixmap, scaled to width in advance (see resizeEvent)
     QPainter painter(this);
-
-    //Scale to width
-    //there's also event->rect() and it looks kind of funny
-    //QSize size = pixmapSize();
-    QSize size = m_pixmap.size();
-    size.scale(this->size(), Qt::KeepAspectRatio);
-
-    //Resize pixmap
-    QPixmap pixmap = m_pixmap.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-    //Draw the pixmap
-    painter.drawPixmap(QPoint(), pixmap);
-
-    QTimer::singleShot(0, this, SLOT(updateSize()));
+    painter.drawPixmap(QPoint(), m_scaled_pixmap);
 }
 
 void
@@ -153,6 +241,12 @@ ImageWidget::resizeEvent(QResizeEvent *event)
     //This can be used if the vertical space is unlimited like in a scroll area
     //This should not be used if the space is restricted like in a dialog
     updateSize();
+    updateScaledPixmap();
+
+    //Grown beyond the decoded size, decode again with more detail
+    if (!m_bytes.isEmpty() && !m_decoding && m_source_size.isValid() &&
+        m_pixmap.width() < qMin(width() * devicePixelRatioF(), (qreal)m_source_size.width()))
+        startDecoding();
 
     QLabel::resizeEvent(event);
 }
@@ -0,0 +1,1153 @@
+#include "libraryindex.hpp"
+
+//Search terms matching more tokens are too frequent to narrow down the results
+static const int MAX_TERM_ROWS = 20000;
+
+LibraryIndex*
+LibraryIndex::globalInstance()
+{
+    //$HOME/.config/PeerPlayer/library.db
+    static LibraryIndex global_instance(
+        ProfileSettings::profile()->configDirectory(true).absoluteFilePath("library.db"));
+    return &global_instance;
+}
+
+QVariantMap
+LibraryIndex::statFile(const QString &file)
+{
+    QVariantMap info;
+    QFileInfo fi(file);
+    if (!fi.exists()) return info;
+    info["size"] = fi.size();
+    info["mtime"] = fi.lastModified().toSecsSinceEpoch();
+#if defined(Q_OS_UNIX)
+    //QFileInfo does not provide the inode, a replaced file (same name)
+    //should not be mistaken for the old one
+    struct stat st;
+    if (::stat(QFile::encodeName(file).constData(), &st) == 0)
+        info["inode"] = (qint64)st.st_ino;
+#endif
+    return info;
+}
+
+LibraryIndex::LibraryIndex(const QString &db_path)
+            : m_db_path(db_path)
+{
+    //Connection names must be unique per database and thread
+    m_conn_prefix = QString("library_%1_").arg((quintptr)this);
+
+    //Create tables, then move old maps from the settings into the index
+    //(only done once, the settings keys are removed afterwards)
+    if (initSchema())
+        migrateSettings();
+}
+
+QString
+LibraryIndex::databasePath() const
+{
+    return m_db_path;
+}
+
+bool
+LibraryIndex::isOpen()
+{
+    return connection().isOpen();
+}
+
+QVariantMap
+LibraryIndex::findByAddress(const QString &address)
+{
+    QVariantMap vid_dl;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare(
+        "SELECT files.path, files.hash_md5 FROM addresses "
+        "JOIN files ON files.id = addresses.file_id "
+        "WHERE addresses.address = ?");
+    query.addBindValue(address);
+    if (!query.exec())
+    {
+        qWarning() << "library lookup failed:" << query.lastError().text();
+        return vid_dl;
+    }
+    if (query.next())
+    {
+        vid_dl["url"] = address;
+        vid_dl["file"] = query.value(0).toString();
+        vid_dl["hash_md5"] = query.value(1).toString();
+    }
+    return vid_dl;
+}
+
+QVariantMap
+LibraryIndex::findFileContext(const QString &file)
+{
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare("SELECT context FROM files WHERE path = ?");
+    query.addBindValue(file);
+    if (!query.exec() || !query.next()) return QVariantMap();
+    return decodeContext(query.value(0).toString());
+}
+
+QStringList
+LibraryIndex::findFilesByHash(const QString &hash_md5)
+{
+    QStringList files;
+    if (hash_md5.isEmpty()) return files;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare("SELECT path FROM files WHERE hash_md5 = ? ORDER BY id");
+    query.addBindValue(hash_md5);
+    if (!query.exec()) return files;
+    while (query.next())
+        files << query.value(0).toString();
+    return files;
+}
+
+QStringList
+LibraryIndex::addressesOfFile(const QString &file)
+{
+    QStringList addresses;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare(
+        "SELECT addresses.address FROM addresses "
+        "JOIN files ON files.id = addresses.file_id "
+        "WHERE files.path = ?");
+    query.addBindValue(file);
+    if (!query.exec()) return addresses;
+    while (query.next())
+        addresses << query.value(0).toString();
+    return addresses;
+}
+
+QVariantList
+LibraryIndex::duplicateGroups()
+{
+    QVariantList groups;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    //Uses the hash index, only hashes with more than one file are returned
+    query.prepare(
+        "SELECT hash_md5, path, size FROM files WHERE hash_md5 IN "
+        "(SELECT hash_md5 FROM files WHERE hash_md5 != '' "
+        "GROUP BY hash_md5 HAVING COUNT(*) > 1) "
+        "ORDER BY hash_md5, id");
+    if (!query.exec()) return groups;
+    QVariantMap group;
+    while (query.next())
+    {
+        QString hash_md5 = query.value(0).toString();
+        if (group.value("hash_md5") != hash_md5)
+        {
+            if (!group.isEmpty()) groups << group;
+            group.clear();
+            group["hash_md5"] = hash_md5;
+        }
+        if (!query.isNull(2))
+            group["size"] = query.value(2);
+        group["files"] = group["files"].toStringList() << query.value(1).toString();
+    }
+    if (!group.isEmpty()) groups << group;
+    return groups;
+}
+
+QVariantMap
+LibraryIndex::fileInfo(const QString &file)
+{
+    QVariantMap info;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare(
+        "SELECT hash_md5, size, mtime, inode, duration, width, height, fingerprint_mtime "
+        "FROM files WHERE path = ?");
+    query.addBindValue(file);
+    if (!query.exec() || !query.next()) return info;
+    info["file"] = file;
+    QStringList columns = QStringList() << "hash_md5" << "size" << "mtime" << "inode" << "duration" << "width" << "height" << "fingerprint_mtime";
+    for (int i = 0; i < columns.size(); i++)
+    {
+        //Unset (null) columns are left out
+        if (!query.isNull(i))
+            info[columns[i]] = query.value(i);
+    }
+    return info;
+}
+
+bool
+LibraryIndex::updateFileInfo(const QString &file, const QVariantMap &info)
+{
+    QStringList columns = QStringList() << "hash_md5" << "size" << "mtime" << "inode" << "duration" << "width" << "height" << "fingerprint_mtime";
+    QStringList set_list;
+    QVariantList values;
+    foreach (QString column, columns)
+    {
+        if (!info.contains(column)) continue;
+        set_list << column + " = ?";
+        values << info[column];
+    }
+
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO files (path, added) VALUES (?, ?)");
+    query.addBindValue(file);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    bool ok = query.exec();
+    if (ok && !set_list.isEmpty())
+    {
+        query.prepare(QString("UPDATE files SET %1 WHERE path = ?").arg(set_list.join(", ")));
+        foreach (QVariant value, values)
+            query.addBindValue(value);
+        query.addBindValue(file);
+        ok = query.exec();
+    }
+    if (!ok)
+    {
+        qWarning() << "failed to update file in library:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QStringList
+LibraryIndex::filesInDirectory(const QString &dir_path)
+{
+    QStringList files;
+    QString prefix = QDir(dir_path).absolutePath() + "/";
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    //Range query on the unique path index (prefix match)
+    query.prepare("SELECT path FROM files WHERE path >= ? AND path < ?");
+    query.addBindValue(prefix);
+    query.addBindValue(prefix.left(prefix.size() - 1) + QChar('/' + 1));
+    if (!query.exec()) return files;
+    while (query.next())
+    {
+        QString file = query.value(0).toString();
+        if (file.indexOf('/', prefix.size()) != -1) continue; //sub directory
+        files << file;
+    }
+    return files;
+}
+
+QVariantMap
+LibraryIndex::resumePosition(const QString &key)
+{
+    QVariantMap position;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare("SELECT time, duration FROM resume_positions WHERE key = ?");
+    query.addBindValue(key);
+    if (!query.exec() || !query.next()) return position;
+    position["time"] = query.value(0).toLongLong();
+    position["duration"] = query.value(1).toLongLong();
+    return position;
+}
+
+bool
+LibraryIndex::setResumePositions(const QMap<QString, QVariantMap> &positions)
+{
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+
+    QSqlQuery query_set(db), query_del(db);
+    query_set.prepare(
+        "INSERT OR REPLACE INTO resume_positions (key, time, duration, updated) "
+        "VALUES (?, ?, ?, ?)");
+    query_del.prepare("DELETE FROM resume_positions WHERE key = ?");
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    bool ok = true;
+    for (auto it = positions.constBegin(); ok && it != positions.constEnd(); ++it)
+    {
+        qint64 time = it.value().value("time").toLongLong();
+        if (time > 0)
+        {
+            query_set.addBindValue(it.key());
+            query_set.addBindValue(time);
+            query_set.addBindValue(it.value().value("duration").toLongLong());
+            query_set.addBindValue(now);
+            ok = query_set.exec();
+        }
+        else
+        {
+            query_del.addBindValue(it.key());
+            ok = query_del.exec();
+        }
+    }
+
+    if (!ok)
+    {
+        qWarning() << "failed to save resume positions:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QMap<QString, QVariantList>
+LibraryIndex::feedItems()
+{
+    QMap<QString, QVariantList> feed;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    if (!query.exec("SELECT subscription, item FROM feed_items ORDER BY subscription, published DESC"))
+        return feed;
+    while (query.next())
+        feed[query.value(0).toString()] << decodeContext(query.value(1).toString());
+    return feed;
+}
+
+bool
+LibraryIndex::setFeedItems(const QString &subscription, const QVariantList &items, int keep)
+{
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+
+    QSqlQuery query_set(db), query_trim(db);
+    query_set.prepare(
+        "INSERT OR REPLACE INTO feed_items (subscription, address, published, item) "
+        "VALUES (?, ?, ?, ?)");
+    bool ok = true;
+    foreach (const QVariant &var, items)
+    {
+        QVariantMap item = var.toMap();
+        QString address = item.value("address").toString();
+        if (address.isEmpty()) continue;
+        query_set.addBindValue(subscription);
+        query_set.addBindValue(address);
+        query_set.addBindValue(item.value("published").toLongLong());
+        query_set.addBindValue(encodeContext(item));
+        if (!(ok = query_set.exec())) break;
+    }
+
+    //Only the newest items of each channel are kept
+    if (ok)
+    {
+        query_trim.prepare(
+            "DELETE FROM feed_items WHERE subscription = ? AND address NOT IN "
+            "(SELECT address FROM feed_items WHERE subscription = ? ORDER BY published DESC LIMIT ?)");
+        query_trim.addBindValue(subscription);
+        query_trim.addBindValue(subscription);
+        query_trim.addBindValue(keep);
+        ok = query_trim.exec();
+    }
+
+    if (!ok)
+    {
+        qWarning() << "failed to save feed items:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+bool
+LibraryIndex::removeFeedItems(const QString &subscription)
+{
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+
+    QSqlQuery query_items(db), query_mark(db);
+    query_items.prepare("DELETE FROM feed_items WHERE subscription = ?");
+    query_items.addBindValue(subscription);
+    query_mark.prepare("DELETE FROM feed_watermarks WHERE subscription = ?");
+    query_mark.addBindValue(subscription);
+    if (!query_items.exec() || !query_mark.exec())
+    {
+        qWarning() << "failed to remove feed items:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QVariantMap
+LibraryIndex::feedWatermark(const QString &subscription)
+{
+    QVariantMap watermark;
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare("SELECT published, address, updated FROM feed_watermarks WHERE subscription = ?");
+    query.addBindValue(subscription);
+    if (!query.exec() || !query.next()) return watermark;
+    watermark["published"] = query.value(0).toLongLong();
+    watermark["address"] = query.value(1).toString();
+    watermark["updated"] = query.value(2).toLongLong();
+    return watermark;
+}
+
+bool
+LibraryIndex::setFeedWatermark(const QString &subscription, qint64 published, const QString &address)
+{
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare(
+        "INSERT OR REPLACE INTO feed_watermarks (subscription, published, address, updated) "
+        "VALUES (?, ?, ?, ?)");
+    query.addBindValue(subscription);
+    query.addBindValue(published);
+    query.addBindValue(address);
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    if (!query.exec())
+    {
+        qWarning() << "failed to save feed watermark:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool
+LibraryIndex::addVideos(const QList<QVariantMap> &videos)
+{
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+
+    QSqlQuery query_find(db), query_touch(db), query_update(db), query_insert(db);
+    QSqlQuery query_untoken(db), query_token(db);
+    query_find.prepare("SELECT id, title, description, channel FROM videos WHERE address = ?");
+    query_touch.prepare("UPDATE videos SET thumbnail = ?, site = ?, published = ?, item = ?, seen = ? WHERE id = ?");
+    query_update.prepare(
+        "UPDATE videos SET title = ?, description = ?, thumbnail = ?, channel = ?, site = ?, "
+        "published = ?, item = ?, seen = ? WHERE id = ?");
+    query_insert.prepare(
+        "INSERT INTO videos (address, title, description, thumbnail, channel, site, published, item, seen) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query_untoken.prepare("DELETE FROM video_tokens WHERE video_id = ?");
+    query_token.prepare("INSERT OR REPLACE INTO video_tokens (token, video_id, weight) VALUES (?, ?, ?)");
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    bool ok = true;
+    foreach (const QVariantMap &video, videos)
+    {
+        QString address = video.value("address").toString();
+        if (address.isEmpty()) continue;
+        QString title = video.value("title").toString();
+        QString description = video.value("description").toString();
+        QString channel = video.value("channel").toString();
+        QString item = encodeContext(video.value("item").toMap());
+
+        //Known video, the tokens only change with the text
+        query_find.addBindValue(address);
+        if (!(ok = query_find.exec())) break;
+        qint64 id = -1;
+        bool text_changed = true;
+        if (query_find.next())
+        {
+            id = query_find.value(0).toLongLong();
+            text_changed = query_find.value(1).toString() != title ||
+                query_find.value(2).toString() != description ||
+                query_find.value(3).toString() != channel;
+        }
+        query_find.finish();
+
+        if (id != -1 && !text_changed)
+        {
+            query_touch.addBindValue(video.value("thumbnail").toString());
+            query_touch.addBindValue(video.value("site").toString());
+            query_touch.addBindValue(video.value("published").toLongLong());
+            query_touch.addBindValue(item);
+            query_touch.addBindValue(now);
+            query_touch.addBindValue(id);
+            if (!(ok = query_touch.exec())) break;
+            continue;
+        }
+
+        QSqlQuery &query_set = id != -1 ? query_update : query_insert;
+        if (id == -1) query_set.addBindValue(address);
+        query_set.addBindValue(title);
+        query_set.addBindValue(description);
+        query_set.addBindValue(video.value("thumbnail").toString());
+        query_set.addBindValue(channel);
+        query_set.addBindValue(video.value("site").toString());
+        query_set.addBindValue(video.value("published").toLongLong());
+        query_set.addBindValue(item);
+        query_set.addBindValue(now);
+        if (id != -1) query_set.addBindValue(id);
+        if (!(ok = query_set.exec())) break;
+        if (id == -1)
+        {
+            id = query_set.lastInsertId().toLongLong();
+        }
+        else
+        {
+            query_untoken.addBindValue(id);
+            if (!(ok = query_untoken.exec())) break;
+        }
+
+        QVariantMap tokens = video.value("tokens").toMap();
+        for (auto it = tokens.constBegin(); ok && it != tokens.constEnd(); ++it)
+        {
+            query_token.addBindValue(it.key());
+            query_token.addBindValue(id);
+            query_token.addBindValue(it.value().toInt());
+            ok = query_token.exec();
+        }
+        if (!ok) break;
+    }
+
+    if (!ok)
+    {
+        qWarning() << "failed to save videos:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QVariantList
+LibraryIndex::searchVideos(const QStringList &terms, int limit)
+{
+    QVariantList results;
+    if (terms.isEmpty()) return results;
+
+    QSqlDatabase db = connection();
+
+    //Frequent terms ("the", a prefix like "vid") would make every video
+    //a candidate: a frequent prefix is only matched exactly,
+    //a frequent word is left out (stop word) unless all terms are frequent
+    QSqlQuery query_prefix(db), query_exact(db);
+    query_prefix.prepare("SELECT COUNT(*) FROM (SELECT 1 FROM video_tokens WHERE token >= ? AND token < ? LIMIT ?)");
+    query_exact.prepare("SELECT COUNT(*) FROM (SELECT 1 FROM video_tokens WHERE token = ? LIMIT ?)");
+    QStringList prefix_terms, exact_terms, stop_words;
+    foreach (const QString &term, terms)
+    {
+        if (term.size() >= 3)
+        {
+            QString upper = term;
+            upper[upper.size() - 1] = QChar(upper[upper.size() - 1].unicode() + 1);
+            query_prefix.addBindValue(term);
+            query_prefix.addBindValue(upper);
+            query_prefix.addBindValue(MAX_TERM_ROWS + 1);
+            if (query_prefix.exec() && query_prefix.next() && query_prefix.value(0).toInt() <= MAX_TERM_ROWS)
+            {
+                prefix_terms << term;
+                continue;
+            }
+        }
+        query_exact.addBindValue(term);
+        query_exact.addBindValue(MAX_TERM_ROWS + 1);
+        if (query_exact.exec() && query_exact.next() && query_exact.value(0).toInt() <= MAX_TERM_ROWS)
+            exact_terms << term;
+        else
+            stop_words << term;
+    }
+    if (prefix_terms.isEmpty() && exact_terms.isEmpty())
+        exact_terms = stop_words;
+    else if (!stop_words.isEmpty())
+        qDebug() << "video search - ignoring frequent terms" << stop_words;
+
+    //One row per term and matching video (best token of the term),
+    //a video must match all terms, score is the sum of the term weights
+    //Longer terms are prefixes (token >= term and < term with last char + 1),
+    //an exact match counts twice
+    QStringList sub_queries;
+    QVariantList bind_values;
+    foreach (const QString &term, prefix_terms)
+    {
+        QString upper = term;
+        upper[upper.size() - 1] = QChar(upper[upper.size() - 1].unicode() + 1);
+        sub_queries << "SELECT video_id, MAX(CASE WHEN token = ? THEN weight * 2 ELSE weight END) AS score "
+            "FROM video_tokens WHERE token >= ? AND token < ? GROUP BY video_id";
+        bind_values << term << term << upper;
+    }
+    foreach (const QString &term, exact_terms)
+    {
+        sub_queries << "SELECT video_id, weight * 2 AS score FROM video_tokens WHERE token = ?";
+        bind_values << term;
+    }
+    QString sql = QString(
+        "SELECT v.address, v.item, v.title, v.description, v.thumbnail, v.channel, v.published, SUM(m.score) AS total "
+        "FROM (%1) m JOIN videos v ON v.id = m.video_id "
+        "GROUP BY m.video_id HAVING COUNT(*) = ? "
+        "ORDER BY total DESC, v.published DESC LIMIT ?").arg(sub_queries.join(" UNION ALL "));
+    bind_values << sub_queries.size() << limit;
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(sql);
+    foreach (const QVariant &value, bind_values)
+        query.addBindValue(value);
+    if (!query.exec())
+    {
+        qWarning() << "video search failed:" << query.lastError().text();
+        return results;
+    }
+    while (query.next())
+    {
+        //Item as returned by the site, columns if it's missing
+        QVariantMap item = decodeContext(query.value(1).toString());
+        item["address"] = query.value(0).toString();
+        if (!item.contains("url")) item["url"] = query.value(0).toString();
+        if (!item.contains("title")) item["title"] = query.value(2).toString();
+        if (!item.contains("description")) item["description"] = query.value(3).toString();
+        if (!item.contains("thumbnail")) item["thumbnail"] = query.value(4).toString();
+        item["channel_title"] = query.value(5).toString();
+        item["published"] = query.value(6).toLongLong();
+        item["score"] = query.value(7).toLongLong();
+        results << item;
+    }
+    return results;
+}
+
+bool
+LibraryIndex::addImportedFile(const QString &file, const QString &src_address, const QString &hash_md5, const QVariantMap &context)
+{
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+
+    //Insert or update file record (the path is unique)
+    QSqlQuery query(db);
+    query.prepare(
+        "INSERT INTO files (path, hash_md5, context, added) VALUES (?, ?, ?, ?) "
+        "ON CONFLICT(path) DO UPDATE SET "
+        "hash_md5 = excluded.hash_md5, context = excluded.context");
+    query.addBindValue(file);
+    query.addBindValue(hash_md5);
+    query.addBindValue(encodeContext(context));
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    if (!query.exec())
+    {
+        qWarning() << "failed to add file to library:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    //Point source address to file record
+    qint64 id = fileId(db, file);
+    if (!src_address.isEmpty())
+    {
+        query.prepare("INSERT OR REPLACE INTO addresses (address, file_id) VALUES (?, ?)");
+        query.addBindValue(src_address);
+        query.addBindValue(id);
+        if (!query.exec())
+        {
+            qWarning() << "failed to add address to library:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+
+    return db.commit();
+}
+
+bool
+LibraryIndex::addAddress(const QString &address, const QString &file)
+{
+    if (address.isEmpty()) return false;
+    QSqlDatabase db = connection();
+    qint64 id = fileId(db, file);
+    if (id < 0) return false;
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO addresses (address, file_id) VALUES (?, ?)");
+    query.addBindValue(address);
+    query.addBindValue(id);
+    return query.exec();
+}
+
+bool
+LibraryIndex::removeFile(const QString &file)
+{
+    QSqlDatabase db = connection();
+    qint64 id = fileId(db, file);
+    if (id < 0) return false;
+    if (!db.transaction()) return false;
+
+    //Move obsolete record(s) to trash, one row per address
+    QSqlQuery query(db);
+    query.prepare(
+        "INSERT INTO trash (address, path, hash_md5, context, removed) "
+        "SELECT addresses.address, files.path, files.hash_md5, files.context, ? "
+        "FROM files LEFT JOIN addresses ON addresses.file_id = files.id "
+        "WHERE files.id = ?");
+    query.addBindValue(QDateTime::currentSecsSinceEpoch());
+    query.addBindValue(id);
+    bool ok = query.exec();
+
+    query.prepare("DELETE FROM addresses WHERE file_id = ?");
+    query.addBindValue(id);
+    ok = ok && query.exec();
+    query.prepare("DELETE FROM files WHERE id = ?");
+    query.addBindValue(id);
+    ok = ok && query.exec();
+
+    if (!ok)
+    {
+        qWarning() << "failed to remove file from library:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+bool
+LibraryIndex::hasFingerprint(const QString &file)
+{
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+    query.prepare(
+        "SELECT 1 FROM fingerprints "
+        "JOIN files ON files.id = fingerprints.file_id "
+        "WHERE files.path = ? LIMIT 1");
+    query.addBindValue(file);
+    return query.exec() && query.next();
+}
+
+bool
+LibraryIndex::setFingerprint(const QString &file, const QList<quint64> &hashes)
+{
+    QSqlDatabase db = connection();
+    qint64 id = fileId(db, file);
+    if (id < 0) return false;
+    if (!db.transaction()) return false;
+
+    //Replace old fingerprint (file may have changed)
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM fingerprints WHERE file_id = ?");
+    query.addBindValue(id);
+    bool ok = query.exec();
+
+    query.prepare(
+        "INSERT INTO fingerprints (file_id, frame, hash, c0, c1, c2, c3) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?)");
+    for (int i = 0; ok && i < hashes.size(); i++)
+    {
+        quint64 hash = hashes[i];
+        query.addBindValue(id);
+        query.addBindValue(i);
+        query.addBindValue((qint64)hash); //SQLite integers are signed
+        for (int c = 0; c < 4; c++)
+            query.addBindValue((int)((hash >> (16 * c)) & 0xffff));
+        ok = query.exec();
+    }
+
+    if (!ok)
+    {
+        qWarning() << "failed to store fingerprint:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QStringList
+LibraryIndex::chunkNeighbours(int chunk, int radius, int first_bit)
+{
+    //The chunk itself and every value with up to radius other bits
+    QStringList values;
+    values << QString::number(chunk);
+    if (radius <= 0) return values;
+    for (int bit = first_bit; bit < 16; bit++)
+        values << chunkNeighbours(chunk ^ (1 << bit), radius - 1, bit + 1);
+    return values;
+}
+
+QString
+LibraryIndex::findByFingerprint(const QList<quint64> &hashes, qint64 duration, int max_distance)
+{
+    if (hashes.isEmpty()) return QString();
+    QSqlDatabase db = connection();
+    QSqlQuery query(db);
+
+    //If at most max_distance bits differ, at least one of the four chunks
+    //has at most max_distance / 4 different bits (pigeonhole),
+    //so each chunk is looked up with its neighbours within that radius
+    //(137 values per chunk for the default distance 10)
+    int radius = qBound(0, max_distance / 4, 3);
+
+    //Count matching frames per candidate file
+    //Frames are taken at the same relative positions in every video,
+    //so frame i is only compared to frame i
+    QMap<qint64, int> votes;
+    QMap<qint64, QString> paths;
+    int frames = 0;
+    for (int i = 0; i < hashes.size(); i++)
+    {
+        //Flat frame (black screen) would match any other video
+        quint64 hash = hashes[i];
+        if (!hash) continue;
+        frames++;
+        QStringList chunk_terms;
+        for (int c = 0; c < 4; c++)
+        {
+            int chunk = (int)((hash >> (16 * c)) & 0xffff);
+            chunk_terms << QString("c%1 IN (%2)").arg(c).arg(chunkNeighbours(chunk, radius).join(","));
+        }
+        query.prepare(
+            "SELECT fingerprints.file_id, fingerprints.hash, files.path, files.duration "
+            "FROM fingerprints JOIN files ON files.id = fingerprints.file_id "
+            "WHERE fingerprints.frame = ? AND (" + chunk_terms.join(" OR ") + ")");
+        query.addBindValue(i);
+        if (!query.exec()) return QString();
+        while (query.next())
+        {
+            //Candidate has at least one close chunk, check the whole hash
+            quint64 other = (quint64)query.value(1).toLongLong();
+            if (qPopulationCount(hash ^ other) > (uint)max_distance) continue;
+            //Re-encodes have (almost) the same duration
+            if (duration > 0 && !query.isNull(3))
+            {
+                qint64 diff = qAbs(query.value(3).toLongLong() - duration);
+                if (diff > qMax((qint64)2000, duration / 100)) continue;
+            }
+            qint64 id = query.value(0).toLongLong();
+            votes[id]++;
+            paths[id] = query.value(2).toString();
+        }
+    }
+
+    //Best candidate needs a majority of the frames
+    qint64 best_id = -1;
+    foreach (qint64 id, votes.keys())
+    {
+        if (best_id < 0 || votes[id] > votes[best_id])
+            best_id = id;
+    }
+    if (best_id < 0 || votes[best_id] * 2 <= frames) return QString();
+    return paths[best_id];
+}
+
+QSqlDatabase
+LibraryIndex::connection()
+{
+    //QSqlDatabase connections can only be used in the thread
+    //that created them, so every thread gets its own connection
+    if (m_connections.hasLocalData())
+        return QSqlDatabase::database(m_connections.localData()->name);
+
+    QString name = m_conn_prefix + QString::number(m_conn_count.fetchAndAddRelaxed(1));
+    ThreadConnection *thread_connection = new ThreadConnection;
+    thread_connection->name = name;
+    m_connections.setLocalData(thread_connection);
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(m_db_path);
+    if (!db.open())
+    {
+        qWarning() << "cannot open library index:" << m_db_path << db.lastError().text();
+        return db;
+    }
+    //Wait for other connections (threads) instead of failing immediately
+    //WAL: readers don't block the writer, commits are atomic and durable
+    QSqlQuery query(db);
+    query.exec("PRAGMA busy_timeout = 5000");
+    query.exec("PRAGMA journal_mode = WAL");
+    query.exec("PRAGMA synchronous = NORMAL");
+    query.exec("PRAGMA foreign_keys = ON");
+    return db;
+}
+
+LibraryIndex::ThreadConnection::~ThreadConnection()
+{
+    //Thread ends, its queries are gone
+    QSqlDatabase::database(name, false).close();
+    QSqlDatabase::removeDatabase(name);
+}
+
+bool
+LibraryIndex::initSchema()
+{
+    QMutexLocker locker(&m_init_mutex);
+    QSqlDatabase db = connection();
+    if (!db.isOpen()) return false;
+
+    QSqlQuery query(db);
+    query.exec("PRAGMA user_version");
+    int version = query.next() ? query.value(0).toInt() : 0;
+
+    //Schema version 1 - files, source addresses (aliases), trash
+    if (version < 1)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS files ("
+               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "path TEXT NOT NULL UNIQUE, "
+               "hash_md5 TEXT, "
+               "context TEXT, "
+               "added INTEGER)"
+            << "CREATE INDEX IF NOT EXISTS files_hash_md5 ON files (hash_md5)"
+            << "CREATE TABLE IF NOT EXISTS addresses ("
+               "address TEXT PRIMARY KEY, "
+               "file_id INTEGER NOT NULL REFERENCES files(id) ON DELETE CASCADE)"
+            << "CREATE INDEX IF NOT EXISTS addresses_file_id ON addresses (file_id)"
+            << "CREATE TABLE IF NOT EXISTS trash ("
+               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "address TEXT, "
+               "path TEXT, "
+               "hash_md5 TEXT, "
+               "context TEXT, "
+               "removed INTEGER)";
+        if (!migrate(db, 1, statements)) return false;
+        version = 1;
+    }
+
+    //Schema version 2 - attributes for the library scanner
+    //(change detection by size+mtime+inode, probed duration and resolution)
+    if (version < 2)
+    {
+        QStringList statements;
+        statements
+            << "ALTER TABLE files ADD COLUMN size INTEGER"
+            << "ALTER TABLE files ADD COLUMN mtime INTEGER"
+            << "ALTER TABLE files ADD COLUMN inode INTEGER"
+            << "ALTER TABLE files ADD COLUMN duration INTEGER"
+            << "ALTER TABLE files ADD COLUMN width INTEGER"
+            << "ALTER TABLE files ADD COLUMN height INTEGER";
+        if (!migrate(db, 2, statements)) return false;
+        version = 2;
+    }
+
+    //Schema version 3 - perceptual fingerprints (one 64 bit hash per frame)
+    //Multi-index hashing: each hash is split into four 16 bit chunks,
+    //each chunk is indexed, a near match (up to r bits differ) has
+    //at least one chunk within r / 4 bits, see findByFingerprint()
+    if (version < 3)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS fingerprints ("
+               "file_id INTEGER NOT NULL REFERENCES files(id) ON DELETE CASCADE, "
+               "frame INTEGER NOT NULL, "
+               "hash INTEGER NOT NULL, "
+               "c0 INTEGER NOT NULL, "
+               "c1 INTEGER NOT NULL, "
+               "c2 INTEGER NOT NULL, "
+               "c3 INTEGER NOT NULL, "
+               "PRIMARY KEY (file_id, frame))"
+            << "CREATE INDEX IF NOT EXISTS fingerprints_c0 ON fingerprints (c0)"
+            << "CREATE INDEX IF NOT EXISTS fingerprints_c1 ON fingerprints (c1)"
+            << "CREATE INDEX IF NOT EXISTS fingerprints_c2 ON fingerprints (c2)"
+            << "CREATE INDEX IF NOT EXISTS fingerprints_c3 ON fingerprints (c3)";
+        if (!migrate(db, 3, statements)) return false;
+        version = 3;
+    }
+
+    //Schema version 4 - resume positions (not tied to a file,
+    //a streamed video is identified by its source address)
+    if (version < 4)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS resume_positions ("
+               "key TEXT PRIMARY KEY, "
+               "time INTEGER NOT NULL, "
+               "duration INTEGER, "
+               "updated INTEGER)";
+        if (!migrate(db, 4, statements)) return false;
+        version = 4;
+    }
+
+    //Schema version 5 - subscription feed (newest videos of each subscribed channel,
+    //item is the json-encoded video item as returned by the site)
+    if (version < 5)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS feed_items ("
+               "subscription TEXT NOT NULL, "
+               "address TEXT NOT NULL, "
+               "published INTEGER, "
+               "item TEXT, "
+               "PRIMARY KEY (subscription, address))"
+            << "CREATE INDEX IF NOT EXISTS feed_items_published ON feed_items (subscription, published)";
+        if (!migrate(db, 5, statements)) return false;
+        version = 5;
+    }
+
+    //Schema version 6 - feed watermarks (newest video seen per subscription,
+    //a refresh only asks for videos after it)
+    if (version < 6)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS feed_watermarks ("
+               "subscription TEXT PRIMARY KEY, "
+               "published INTEGER, "
+               "address TEXT, "
+               "updated INTEGER)";
+        if (!migrate(db, 6, statements)) return false;
+        version = 6;
+    }
+
+    //Schema version 7 - catalog of all videos seen on the sites,
+    //with an inverted index for the search (token => videos, weighted),
+    //the primary key of video_tokens is also the index for prefix lookups
+    if (version < 7)
+    {
+        QStringList statements;
+        statements
+            << "CREATE TABLE IF NOT EXISTS videos ("
+               "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "address TEXT NOT NULL UNIQUE, "
+               "title TEXT, "
+               "description TEXT, "
+               "thumbnail TEXT, "
+               "channel TEXT, "
+               "site TEXT, "
+               "published INTEGER, "
+               "item TEXT, "
+               "seen INTEGER)"
+            << "CREATE TABLE IF NOT EXISTS video_tokens ("
+               "token TEXT NOT NULL, "
+               "video_id INTEGER NOT NULL REFERENCES videos(id) ON DELETE CASCADE, "
+               "weight INTEGER NOT NULL, "
+               "PRIMARY KEY (token, video_id)) WITHOUT ROWID"
+            << "CREATE INDEX IF NOT EXISTS video_tokens_video_id ON video_tokens (video_id)";
+        if (!migrate(db, 7, statements)) return false;
+        version = 7;
+    }
+
+    //Schema version 8 - mtime of the file when it was last fingerprinted,
+    //also if that failed, so it isn't tried again until the file changes
+    if (version < 8)
+    {
+        QStringList statements;
+        statements
+            << "ALTER TABLE files ADD COLUMN fingerprint_mtime INTEGER";
+        if (!migrate(db, 8, statements)) return false;
+        version = 8;
+    }
+
+    return true;
+}
+
+bool
+LibraryIndex::migrate(QSqlDatabase &db, int version, const QStringList &statements)
+{
+    //All statements of a version or none, the version is set last
+    QSqlQuery query(db);
+    db.transaction();
+    foreach (const QString &sql, statements + (QStringList() << QString("PRAGMA user_version = %1").arg(version)))
+    {
+        if (!query.exec(sql))
+        {
+            qWarning() << "cannot update library index to version" << version << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    return db.commit();
+}
+
+bool
+LibraryIndex::migrateSettings()
+{
+    //Older versions kept the library in the settings file:
+    //addr_map: src_addr => { url, file, hash_md5 }
+    //file_map: file => context
+    //trash_list: [ { url, file, hash_md5 } ]
+    ProfileSettings *settings = ProfileSettings::profile();
+    QVariantMap addr_map = settings->variant("addr_map").toMap();
+    QVariantMap file_map = settings->variant("file_map").toMap();
+    QVariantList trash_list = settings->variant("trash_list").toList();
+    if (addr_map.isEmpty() && file_map.isEmpty() && trash_list.isEmpty())
+        return true;
+    qInfo() << "moving library from settings to index:" << addr_map.size() << "addresses," << file_map.size() << "files";
+
+    QSqlDatabase db = connection();
+    if (!db.transaction()) return false;
+    QSqlQuery query(db);
+    bool ok = true;
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    //Files with context (file_map), hash is taken from addr_map below
+    foreach (QString file, file_map.keys())
+    {
+        query.prepare("INSERT OR IGNORE INTO files (path, context, added) VALUES (?, ?, ?)");
+        query.addBindValue(file);
+        query.addBindValue(encodeContext(file_map[file].toMap()));
+        query.addBindValue(now);
+        ok = ok && query.exec();
+    }
+
+    //Source addresses (addr_map)
+    foreach (QString address, addr_map.keys())
+    {
+        QVariant var = addr_map[address];
+        QString file;
+        QString md5;
+        if (var.canConvert<QVariantMap>())
+        {
+            QVariantMap vid_dl = var.toMap();
+            file = vid_dl["file"].toString();
+            md5 = vid_dl["hash_md5"].toString();
+        }
+        else if (var.canConvert<QString>())
+        {
+            file = var.toString();
+        }
+        if (file.isEmpty()) continue;
+
+        query.prepare("INSERT OR IGNORE INTO files (path, added) VALUES (?, ?)");
+        query.addBindValue(file);
+        query.addBindValue(now);
+        ok = ok && query.exec();
+        if (!md5.isEmpty())
+        {
+            query.prepare("UPDATE files SET hash_md5 = ? WHERE path = ?");
+            query.addBindValue(md5);
+            query.addBindValue(file);
+            ok = ok && query.exec();
+        }
+        query.prepare("INSERT OR REPLACE INTO addresses (address, file_id) VALUES (?, ?)");
+        query.addBindValue(address);
+        query.addBindValue(fileId(db, file));
+        ok = ok && query.exec();
+    }
+
+    //Trash list
+    foreach (QVariant var, trash_list)
+    {
+        QVariantMap vid_dl = var.toMap();
+        query.prepare("INSERT INTO trash (address, path, hash_md5, removed) VALUES (?, ?, ?, ?)");
+        query.addBindValue(vid_dl["url"].toString());
+        query.addBindValue(vid_dl["file"].toString());
+        query.addBindValue(vid_dl["hash_md5"].toString());
+        query.addBindValue(now);
+        ok = ok && query.exec();
+    }
+
+    if (!ok)
+    {
+        qWarning() << "failed to move library to index:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) return false;
+
+    //Index committed, drop the old maps from the settings file
+    settings->removeVariant("addr_map");
+    settings->removeVariant("file_map");
+    settings->removeVariant("trash_list");
+    settings->save();
+
+    return true;
+}
+
+qint64
+LibraryIndex::fileId(QSqlDatabase &db, const QString &file)
+{
+    QSqlQuery query(db);
+    query.prepare("SELECT id FROM files WHERE path = ?");
+    query.addBindValue(file);
+    if (!query.exec() || !query.next()) return -1;
+    return query.value(0).toLongLong();
+}
+
+QString
+LibraryIndex::encodeContext(const QVariantMap &context)
+{
+    if (context.isEmpty()) return QString();
+    QJsonDocument j_doc = QJsonDocument::fromVariant(context);
+    return QString::fromUtf8(j_doc.toJson(QJsonDocument::Compact));
+}
+
+QVariantMap
+LibraryIndex::decodeContext(const QString &text)
+{
+    if (text.isEmpty()) return QVariantMap();
+    return QJsonDocument::fromJson(text.toUtf8()).object().toVariantMap();
+}
+
@@ -0,0 +1,354 @@
+#include "libraryscanner.hpp"
+
+LibraryScanner*
+LibraryScanner::globalInstance()
+{
+    //Parent is the application, so the pool is stopped before it goes away
+    static QPointer<LibraryScanner> global_instance;
+    if (!global_instance)
+        global_instance = new LibraryScanner(qApp);
+    return global_instance;
+}
+
+LibraryScanner::LibraryScanner(QObject *parent)
+              : QObject(parent),
+                m_active_tasks(0),
+                m_stop(0),
+                m_vlc_instance(0),
+                m_recursive(true)
+{
+    //Hashing is mostly i/o, a few threads are enough to keep the disk busy
+    int threads = qBound(1, QThread::idealThreadCount() / 2, 4);
+    m_pool.setMaxThreadCount(threads);
+
+    //Watch scanned directories, rescan a directory when it's modified
+    //Events are collected for a moment because a copy triggers several
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, SIGNAL(directoryChanged(const QString&)), SLOT(scheduleDirectory(const QString&)));
+    m_tmr_dirs.setSingleShot(true);
+    m_tmr_dirs.setInterval(2000);
+    connect(&m_tmr_dirs, SIGNAL(timeout()), SLOT(scanPendingDirectories()));
+}
+
+LibraryScanner::~LibraryScanner()
+{
+    //Abort running hash jobs, drop queued ones
+    m_stop = 1;
+    m_pool.clear();
+    m_pool.waitForDone();
+
+    VlcInstance::release(m_vlc_instance);
+}
+
+bool
+LibraryScanner::isVideoFile(const QString &file)
+{
+    //Match by name only, opening every file to check its content is too slow
+    QMimeType mime = QMimeDatabase().mimeTypeForFile(file, QMimeDatabase::MatchExtension);
+    return mime.name().startsWith("video/");
+}
+
+bool
+LibraryScanner::isActive() const
+{
+    return m_active_tasks > 0 || !m_pending_dirs.isEmpty();
+}
+
+void
+LibraryScanner::start(const QString &dir_path, bool recursive)
+{
+    QFileInfo fi(dir_path);
+    if (!fi.isDir()) return;
+    qInfo() << "scanning library directory" << fi.absoluteFilePath() << (recursive ? "(recursive)" : "");
+    m_recursive = recursive;
+
+    emit scanStarted();
+    scanDirectory(fi.absoluteFilePath());
+}
+
+void
+LibraryScanner::scheduleFile(const QString &file)
+{
+    //Same file already queued (e.g., watcher and view)
+    QString file_path = QFileInfo(file).absoluteFilePath();
+    if (m_queued_files.contains(file_path)) return;
+    m_queued_files << file_path;
+
+    m_active_tasks++;
+    QtConcurrent::run(&m_pool, [this, file_path]()
+    {
+        indexFile(file_path);
+    });
+}
+
+void
+LibraryScanner::scheduleDirectory(const QString &dir_path)
+{
+    m_pending_dirs << dir_path;
+    m_tmr_dirs.start();
+}
+
+void
+LibraryScanner::scanPendingDirectories()
+{
+    QSet<QString> dirs = m_pending_dirs;
+    m_pending_dirs.clear();
+    if (!dirs.isEmpty()) emit scanStarted();
+    foreach (QString dir_path, dirs)
+    {
+        //Removed directory, the watcher has already dropped it
+        if (!QFileInfo(dir_path).isDir()) continue;
+        scanDirectory(dir_path);
+    }
+}
+
+void
+LibraryScanner::taskDone(const QString &file, bool indexed)
+{
+    m_active_tasks--;
+    m_queued_files.remove(file);
+    if (indexed)
+        emit fileIndexed(file);
+    if (!isActive())
+    {
+        qInfo() << "library scan finished";
+        emit scanFinished();
+    }
+}
+
+void
+LibraryScanner::scanDirectory(const QString &dir_path)
+{
+    watchDirectory(dir_path);
+
+    //List directory in the pool as well, it could be on a slow disk
+    m_active_tasks++;
+    QtConcurrent::run(&m_pool, [this, dir_path]()
+    {
+        QDir dir(dir_path);
+        QStringList files;
+        foreach (QFileInfo fi, dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot))
+        {
+            if (isVideoFile(fi.fileName()))
+                files << fi.absoluteFilePath();
+        }
+        QStringList sub_dirs;
+        foreach (QFileInfo fi, dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks))
+            sub_dirs << fi.absoluteFilePath();
+
+        //Files that have disappeared from this directory are moved to trash
+        LibraryIndex *library = LibraryIndex::globalInstance();
+        foreach (QString file, library->filesInDirectory(dir_path))
+        {
+            if (QFileInfo::exists(file)) continue;
+            qDebug() << "library scanner - file removed:" << file;
+            library->removeFile(file);
+        }
+
+        //Continue in main thread (watcher), hash files, enter new sub dirs
+        QMetaObject::invokeMethod(this, [this, dir_path, files, sub_dirs]()
+        {
+            foreach (QString file, files)
+                scheduleFile(file);
+            foreach (QString sub_dir, sub_dirs)
+            {
+                //Watched directories are already known, they have their own events
+                if (m_recursive && !m_watcher->directories().contains(sub_dir))
+                    scanDirectory(sub_dir);
+            }
+            taskDone(dir_path, false);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void
+LibraryScanner::watchDirectory(const QString &dir_path)
+{
+    if (m_watcher->directories().contains(dir_path)) return;
+    if (!m_watcher->addPath(dir_path))
+        qWarning() << "library scanner - cannot watch directory:" << dir_path;
+}
+
+void
+LibraryScanner::indexFile(const QString &file)
+{
+    //Runs in the thread pool
+    bool indexed = false;
+    LibraryIndex *library = LibraryIndex::globalInstance();
+    QVariantMap stat = LibraryIndex::statFile(file);
+
+    //A file that was modified a moment ago may still be written to
+    //(download, copy), look at it again later
+    qint64 age = QDateTime::currentSecsSinceEpoch() - stat.value("mtime").toLongLong();
+    if (!stat.isEmpty() && age < 10 && !m_stop)
+    {
+        QString dir_path = QFileInfo(file).absolutePath();
+        QMetaObject::invokeMethod(this, [this, dir_path]()
+        {
+            QTimer::singleShot(10000, this, [this, dir_path]() { scheduleDirectory(dir_path); });
+        }, Qt::QueuedConnection);
+    }
+    else if (!stat.isEmpty() && !m_stop)
+    {
+        //Compare with index, skip unchanged file (same size, mtime, inode)
+        QVariantMap info = library->fileInfo(file);
+        bool unchanged = !info.isEmpty();
+        foreach (QString key, stat.keys())
+        {
+            if (info.value(key).toLongLong() != stat[key].toLongLong())
+                unchanged = false;
+        }
+
+        QVariantMap update = stat;
+        if (!unchanged || info.value("hash_md5").toString().isEmpty())
+        {
+            qDebug() << "library scanner - hashing" << file;
+            QString md5 = VideoStorage::fileHash(file, &m_stop);
+            if (!md5.isEmpty())
+                update["hash_md5"] = md5;
+        }
+        if (!unchanged || !info.contains("duration"))
+        {
+            //Probed values replace older ones (unite() would keep both)
+            QVariantMap probed = probeFile(file);
+            foreach (const QString &key, probed.keys())
+                update[key] = probed[key];
+        }
+
+        //Write only if something new was found, stop flag means incomplete
+        if (update.size() > stat.size() && !m_stop)
+            indexed = library->updateFileInfo(file, update);
+
+        //Fingerprint after the file is in the index, it's the slow part
+        //A file that cannot be fingerprinted is tried again when it changes
+        qint64 mtime = stat["mtime"].toLongLong();
+        bool attempted = info.value("fingerprint_mtime").toLongLong() == mtime;
+        if ((!unchanged || (!attempted && !library->hasFingerprint(file))) && !m_stop)
+        {
+            indexed = fingerprintFile(file) || indexed;
+            if (!m_stop)
+            {
+                QVariantMap marker;
+                marker["fingerprint_mtime"] = mtime;
+                library->updateFileInfo(file, marker);
+            }
+        }
+    }
+
+    QMetaObject::invokeMethod(this, "taskDone", Qt::QueuedConnection,
+        Q_ARG(QString, file), Q_ARG(bool, indexed));
+}
+
+void
+LibraryScanner::matchRemote(const QString &address, const QUrl &url)
+{
+    //Decodes several seek positions of the stream, only if enabled
+    if (!ProfileSettings::profile()->setDefaultVariant("match_remote_videos", false).toBool()) return;
+
+    //Already known or being matched
+    if (address.isEmpty() || m_queued_files.contains(address)) return;
+    if (!LibraryIndex::globalInstance()->findByAddress(address).isEmpty()) return;
+    m_queued_files << address;
+
+    m_active_tasks++;
+    QtConcurrent::run(&m_pool, [this, address, url]()
+    {
+        FrameGrabber grabber(vlcInstance(), &m_stop);
+        QList<QImage> frames = grabber.grabFrames(url.toString(), FrameGrabber::fingerprintPositions());
+        QString file;
+        if (frames.size() == FrameGrabber::fingerprintPositions().size())
+        {
+            LibraryIndex *library = LibraryIndex::globalInstance();
+            file = library->findByFingerprint(FrameGrabber::fingerprint(frames), grabber.duration());
+            //Next time, the address is found directly
+            if (!file.isEmpty() && !library->addAddress(address, file))
+                file.clear();
+        }
+        QMetaObject::invokeMethod(this, [this, address, file]()
+        {
+            if (!file.isEmpty())
+            {
+                qInfo() << "remote video matches local file" << address << file;
+                emit remoteMatched(address, file);
+            }
+            taskDone(address, false);
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool
+LibraryScanner::fingerprintFile(const QString &file)
+{
+    FrameGrabber grabber(vlcInstance(), &m_stop);
+    QList<QImage> frames = grabber.grabFrames(file, FrameGrabber::fingerprintPositions());
+    //Incomplete fingerprint can't be compared by frame index
+    if (m_stop || frames.size() != FrameGrabber::fingerprintPositions().size())
+    {
+        qDebug() << "library scanner - cannot fingerprint" << file;
+        return false;
+    }
+    return LibraryIndex::globalInstance()->setFingerprint(file, FrameGrabber::fingerprint(frames));
+}
+
+QVariantMap
+LibraryScanner::probeFile(const QString &file)
+{
+    QVariantMap info;
+    libvlc_instance_t *vlc = vlcInstance();
+    if (!vlc) return info;
+
+    libvlc_media_t *media = libvlc_media_new_path(vlc, QFile::encodeName(file).constData());
+    if (!media) return info;
+
+    //Parse local file only (no network lookups), wait for the result
+    int timeout = 10000;
+    libvlc_media_parse_with_options(media, libvlc_media_parse_local, timeout);
+    QElapsedTimer timer;
+    timer.start();
+    while (libvlc_media_get_parsed_status(media) == 0 && timer.elapsed() < timeout + 1000)
+    {
+        if (m_stop) break;
+        QThread::msleep(20);
+    }
+
+    if (libvlc_media_get_parsed_status(media) == libvlc_media_parsed_status_done)
+    {
+        libvlc_time_t duration = libvlc_media_get_duration(media); //ms
+        if (duration >= 0)
+            info["duration"] = (qint64)duration;
+
+        libvlc_media_track_t **tracks = 0;
+        unsigned count = libvlc_media_tracks_get(media, &tracks);
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (tracks[i]->i_type != libvlc_track_video) continue;
+            info["width"] = tracks[i]->video->i_width;
+            info["height"] = tracks[i]->video->i_height;
+            break;
+        }
+        if (tracks) libvlc_media_tracks_release(tracks, count);
+    }
+    else
+    {
+        qDebug() << "library scanner - cannot probe" << file;
+    }
+
+    libvlc_media_release(media);
+    return info;
+}
+
+libvlc_instance_t*
+LibraryScanner::vlcInstance()
+{
+    //Shared instance, used to parse media and grab frames
+    //Audio is disabled per media (see FrameGrabber)
+    QMutexLocker locker(&m_vlc_mutex);
+    if (!m_vlc_instance)
+    {
+        m_vlc_instance = VlcInstance::acquire();
+        if (!m_vlc_instance)
+            qWarning() << "library scanner - failed to load libvlc";
+    }
+    return m_vlc_instance;
+}
+
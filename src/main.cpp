@@ -3,11 +3,19 @@
 
 int main(int argc, char *argv[])
 {
+    //Startup phases are printed with --startup-profile
+    QElapsedTimer startup_timer;
+    startup_timer.start();
+
     //Initialize QApplication
     QApplication app(argc, argv);
     app.setApplicationName(PROGRAM);
     app.setApplicationVersion(APP_VERSION);
     QString program = QString(PROGRAM).toLower();
+    StartupProfiler *profiler = StartupProfiler::globalInstance();
+    profiler->setEnabled(app.arguments().contains("--startup-profile"));
+    profiler->start(startup_timer);
+    profiler->mark("application");
 
     //Config
     ProfileSettings::useDefaultProfile();
@@ -15,6 +23,14 @@ int main(int argc, char *argv[])
     //if (config.setDefaultVariant("debug", false))
     //set profile prefix, use group accessor...
     initLogger();
+    profiler->mark("settings");
+
+    //Open library index (moves old addr_map/file_map out of the settings)
+    LibraryIndex::globalInstance();
+    profiler->mark("library index");
+
+    //Streamed videos are cached next to the downloads
+    CacheProxy::globalInstance()->setCacheDirectory(VideoStorage::tempPath());
 
     //Load our own font because we're special (and some Qt builds have no fonts)
     //Note that Qt no longer ships fonts. Deploy some (from https://dejavu-fonts.github.io/ for example) or switch to fontconfig.
@@ -26,12 +42,38 @@ int main(int argc, char *argv[])
         QFont font("PTSans");
         app.setFont(font);
     }
+    profiler->mark("fonts");
 
     //TODO Initialize QTranslator, load default translation
 
+    //All players share one libvlc instance, created with these arguments
+    //Caching values (ms): network caching is libvlc's default,
+    //file caching is shorter than libvlc's 1000 on purpose, so local files
+    //start and seek without a noticeable delay
+    ProfileSettings *settings = ProfileSettings::profile();
+    QStringList vlc_args;
+    vlc_args << "--file-caching=300" << "--network-caching=1000";
+    VlcInstance::setArguments(settings->setDefaultVariant("vlc_args", vlc_args).toStringList());
+
     //Load main window
+    //Only the current tab is loaded, the others when they're activated
     PeerPlayerMain *main = new PeerPlayerMain;
+    profiler->watchFirstFrame(main);
     main->show();
+    profiler->mark("show window");
+
+    //Index videos in import directory in the background, watch for changes
+    //Home directory (fallback import path) is not walked recursively
+    if (settings->setDefaultVariant("library_scan", true).toBool())
+    {
+        QString import_path = VideoStorage::importPath();
+        LibraryScanner::globalInstance()->start(import_path, import_path != QDir::homePath());
+    }
+
+    //Newest videos of the subscribed channels, refreshed in the background
+    FeedEngine::globalInstance()->startSchedule();
+    profiler->mark("background jobs");
+
     int code = app.exec();
 
     return code;
@@ -0,0 +1,285 @@
+#include "partialfile.hpp"
+
+//State of one libvlc input (opaque pointer of the media callbacks)
+struct PartialFileStream
+{
+    PartialFile *file;
+    int reader;
+    qint64 offset;
+};
+
+PartialFile::PartialFile(const QString &file_path, QObject *parent)
+           : QObject(parent),
+             m_file_path(file_path),
+             m_size(-1),
+             m_growing(false),
+             m_finished(false),
+             m_failed(false),
+             m_next_reader(1),
+             m_requested_offset(-1)
+{
+    //Own handle for positioned writes, the file exists already (temp file)
+    m_write_file.setFileName(file_path);
+}
+
+PartialFile::~PartialFile()
+{
+    interruptReaders();
+    foreach (QFile *file, m_readers)
+        delete file;
+}
+
+QString
+PartialFile::filePath() const
+{
+    return m_file_path;
+}
+
+qint64
+PartialFile::size()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_size;
+}
+
+void
+PartialFile::setSize(qint64 size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_size = size;
+    m_data_ready.wakeAll();
+}
+
+void
+PartialFile::setGrowing(bool growing)
+{
+    QMutexLocker locker(&m_mutex);
+    m_growing = growing;
+}
+
+bool
+PartialFile::write(qint64 offset, const QByteArray &data)
+{
+    if (data.isEmpty()) return true;
+    if (!m_write_file.isOpen() && !m_write_file.open(QIODevice::ReadWrite))
+    {
+        qWarning() << "cannot open partial file for writing:" << m_file_path;
+        return false;
+    }
+    //Data must be on disk before readers are told about it
+    if (!m_write_file.seek(offset) || m_write_file.write(data) != data.size())
+        return false;
+    m_write_file.flush();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        addRange(offset, offset + data.size());
+        m_data_ready.wakeAll();
+    }
+    emit dataWritten(offset, data.size());
+    return true;
+}
+
+void
+PartialFile::setFinished(bool failed)
+{
+    if (m_write_file.isOpen()) m_write_file.close();
+
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_failed = failed;
+    if (m_growing)
+    {
+        //Written by other process, it's all there now
+        qint64 size = QFileInfo(m_file_path).size();
+        addRange(0, size);
+        if (!failed) m_size = size;
+    }
+    m_data_ready.wakeAll();
+}
+
+bool
+PartialFile::isFinished()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_finished;
+}
+
+qint64
+PartialFile::availableFrom(qint64 offset)
+{
+    QMutexLocker locker(&m_mutex);
+    return availableFromLocked(offset);
+}
+
+qint64
+PartialFile::missingFrom(qint64 offset)
+{
+    QMutexLocker locker(&m_mutex);
+    offset += availableFromLocked(offset);
+    if (m_size >= 0 && offset >= m_size) return -1;
+    return offset;
+}
+
+qint64
+PartialFile::bytesAvailable()
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = 0;
+    for (QMap<qint64, qint64>::const_iterator it = m_ranges.constBegin(); it != m_ranges.constEnd(); ++it)
+        bytes += it.value() - it.key();
+    return bytes;
+}
+
+int
+PartialFile::openReader()
+{
+    QFile *file = new QFile(m_file_path);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        delete file;
+        return -1;
+    }
+    QMutexLocker locker(&m_mutex);
+    int reader = m_next_reader++;
+    m_readers[reader] = file;
+    return reader;
+}
+
+qint64
+PartialFile::read(int reader, qint64 offset, char *data, qint64 max_size)
+{
+    QFile *file = 0;
+    qint64 available = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        file = m_readers.value(reader);
+        while (file)
+        {
+            if (m_interrupted.contains(reader)) return -1;
+            available = availableFromLocked(offset);
+            if (available > 0) break;
+            if (m_size >= 0 && offset >= m_size) return 0; //EOF
+            if (m_finished) return m_failed ? -1 : 0;
+
+            if (m_growing)
+            {
+                //Other process writes the file sequentially
+                addRange(0, QFileInfo(m_file_path).size());
+                if (availableFromLocked(offset) > 0) continue;
+            }
+            else if (m_requested_offset != offset)
+            {
+                //Request data at offset unless the download is about to get there
+                qint64 front = 0;
+                QMap<qint64, qint64>::const_iterator it = m_ranges.upperBound(offset);
+                if (it != m_ranges.constBegin())
+                    front = (--it).value();
+                if (offset - front > 1024 * 1024)
+                {
+                    m_requested_offset = offset;
+                    emit rangeRequested(offset);
+                }
+            }
+            m_data_ready.wait(&m_mutex, 200);
+        }
+    }
+    if (!file) return -1;
+
+    //Read outside of lock, the range is written already
+    if (!file->seek(offset)) return -1;
+    return file->read(data, qMin(max_size, available));
+}
+
+void
+PartialFile::closeReader(int reader)
+{
+    QMutexLocker locker(&m_mutex);
+    delete m_readers.take(reader);
+    m_interrupted.remove(reader);
+}
+
+void
+PartialFile::interruptReaders()
+{
+    QMutexLocker locker(&m_mutex);
+    foreach (int reader, m_readers.keys())
+        m_interrupted << reader;
+    m_data_ready.wakeAll();
+}
+
+int
+PartialFile::vlcOpen(void *opaque, void **datap, uint64_t *sizep)
+{
+    PartialFile *file = static_cast<PartialFile*>(opaque);
+    int reader = file->openReader();
+    if (reader < 0) return -1;
+    PartialFileStream *stream = new PartialFileStream;
+    stream->file = file;
+    stream->reader = reader;
+    stream->offset = 0;
+    *datap = stream;
+    //Unknown size means a stream that can't be seeked by percentage yet
+    qint64 size = file->size();
+    *sizep = size >= 0 ? (uint64_t)size : UINT64_MAX;
+    return 0;
+}
+
+ssize_t
+PartialFile::vlcRead(void *opaque, unsigned char *buf, size_t len)
+{
+    PartialFileStream *stream = static_cast<PartialFileStream*>(opaque);
+    qint64 count = stream->file->read(stream->reader, stream->offset, (char*)buf, len);
+    if (count > 0) stream->offset += count;
+    return count;
+}
+
+int
+PartialFile::vlcSeek(void *opaque, uint64_t offset)
+{
+    //Nothing to do yet, the next read waits for the data
+    PartialFileStream *stream = static_cast<PartialFileStream*>(opaque);
+    stream->offset = offset;
+    return 0;
+}
+
+void
+PartialFile::vlcClose(void *opaque)
+{
+    PartialFileStream *stream = static_cast<PartialFileStream*>(opaque);
+    stream->file->closeReader(stream->reader);
+    delete stream;
+}
+
+void
+PartialFile::addRange(qint64 start, qint64 end)
+{
+    //Merge with overlapping or adjacent ranges
+    if (end <= start) return;
+    QMap<qint64, qint64>::iterator it = m_ranges.upperBound(start);
+    if (it != m_ranges.begin())
+    {
+        QMap<qint64, qint64>::iterator prev = it - 1;
+        if (prev.value() >= start)
+        {
+            start = prev.key();
+            end = qMax(end, prev.value());
+            it = m_ranges.erase(prev);
+        }
+    }
+    while (it != m_ranges.end() && it.key() <= end)
+    {
+        end = qMax(end, it.value());
+        it = m_ranges.erase(it);
+    }
+    m_ranges.insert(start, end);
+}
+
+qint64
+PartialFile::availableFromLocked(qint64 offset)
+{
+    QMap<qint64, qint64>::const_iterator it = m_ranges.upperBound(offset);
+    if (it == m_ranges.constBegin()) return 0;
+    --it;
+    return it.value() > offset ? it.value() - offset : 0;
+}
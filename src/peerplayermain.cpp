@@ -26,6 +26,7 @@ PeerPlayerMain::PeerPlayerMain(QWidget *parent, Qt::WindowFlags flags)
     m_tab_widget->setTabsClosable(true);
     m_tab_widget->setMovable(true);
     connect(m_tab_widget, SIGNAL(tabCloseRequested(int)), SLOT(closeTab(int)));
+    connect(m_tab_widget, SIGNAL(currentChanged(int)), SLOT(activateTab(int)));
     QPushButton *btn_menu = new QPushButton("...");
     m_tab_widget->setCornerWidget(btn_menu);
     QMenu *mnu = new QMenu;
@@ -34,11 +35,18 @@ PeerPlayerMain::PeerPlayerMain(QWidget *parent, Qt::WindowFlags flags)
     connect(act_open_channel_url, SIGNAL(triggered()), SLOT(showOpenChannelUrl()));
     m_act_subscriptions = mnu->addAction(tr("Subscriptions"));
     connect(m_act_subscriptions, SIGNAL(triggered()), SLOT(addSubscriptionsTab()));
+    m_act_downloads = mnu->addAction(tr("Downloads"));
+    connect(m_act_downloads, SIGNAL(triggered()), SLOT(addDownloadsTab()));
+    m_act_search = mnu->addAction(tr("Search videos"));
+    connect(m_act_search, SIGNAL(triggered()), SLOT(addSearchTab()));
     m_act_settings = mnu->addAction(tr("Settings"));
     connect(m_act_settings, SIGNAL(triggered()), SLOT(showSettings()));
+    StartupProfiler *profiler = StartupProfiler::globalInstance();
+    profiler->mark("main window");
 
     //Subscriptions view
     addSubscriptionsTab();
+    profiler->mark("subscriptions tab");
 
     //Restore window state settings
     ProfileSettings *settings = ProfileSettings::profile();
@@ -64,7 +72,10 @@ PeerPlayerMain::PeerPlayerMain(QWidget *parent, Qt::WindowFlags flags)
             resize(size);
         }
     }
-    //Restore open video tabs
+    //Restore open tabs as placeholders, the current one is loaded when it's shown
+    //(a site tab loads its site right away, a video tab its player)
+    //video tabs are restored paused, autoplay off
+    //it generally does not make sense to start playback in background
     v_settings = settings->variant("tabs");
     if (!v_settings.isNull())
     {
@@ -74,20 +85,43 @@ PeerPlayerMain::PeerPlayerMain(QWidget *parent, Qt::WindowFlags flags)
         QDataStream ds(&buffer);
         QVariantList tab_info_list;
         ds >> tab_info_list;
-        foreach (QVariant v, tab_info_list)
+        int current_index = settings->variant("tab_index", -1).toInt();
+        QWidget *current_tab = 0;
+        for (int i = 0; i < tab_info_list.size(); i++)
         {
-            QVariantMap tab_info = v.toMap();
+            QVariantMap tab_info = tab_info_list[i].toMap();
             QString type = tab_info["type"].toString();
             QString address = tab_info["address"].toString();
-            //video tabs are restored paused, autoplay off
-            //it generally does not make sense to start playback in background
-            if (type == "site")
-                addSiteTab(address);
-            else if (type == "video")
-                openVideo(address, tab_info["item"].toMap(), true);
+            if (type != "site" && type != "video") continue;
+            QString name = tab_info["name"].toString();
+            if (name.isEmpty())
+                name = type == "video" ? tab_info["item"].toMap()["title"].toString() : QUrl(address).host();
+            QWidget *tab = addTabPlaceholder(type, address, tab_info["item"].toMap(),
+                tab_info["state"].toMap(), name);
+            if (i == current_index) current_tab = tab;
         }
+        //Current tab is loaded after the window is shown
+        if (current_tab)
+        {
+            m_tab_widget->blockSignals(true);
+            m_tab_widget->setCurrentWidget(current_tab);
+            m_tab_widget->blockSignals(false);
+            QTimer::singleShot(0, this, [this]()
+            {
+                activateTab(m_tab_widget->currentIndex());
+            });
+        }
+        profiler->mark(QString("restore tabs (%1)").arg(tab_info_list.size()));
     }
 
+    //Video tabs that haven't been used for a while are replaced by placeholders
+    //which cost (almost) nothing, like background tabs after startup
+    settings->setDefaultVariant("tab_hibernate_minutes", 30);
+    m_tmr_hibernate = new QTimer(this);
+    m_tmr_hibernate->setInterval(60 * 1000);
+    connect(m_tmr_hibernate, SIGNAL(timeout()), SLOT(hibernateTabs()));
+    m_tmr_hibernate->start();
+
 }
 
 void PeerPlayerMain::closeEvent(QCloseEvent *event)
@@ -110,19 +144,34 @@ void PeerPlayerMain::closeEvent(QCloseEvent *event)
     buffer.open(QBuffer::WriteOnly | QIODevice::Truncate);
     {
         QVariantList tab_info_list;
+        int current_index = -1;
         for (int i = 0; i < m_tab_widget->count(); i++)
         {
             QVariant tab_id_v = m_tab_widget->widget(i)->property("tab_id");
             if (!tab_id_v.isValid()) continue;
             int tab_id = tab_id_v.toInt();
-            QVariant tab_info = m_loaded_tabs.value(tab_id);
+            QVariantMap tab_info = m_loaded_tabs.value(tab_id);
+            //Source and position of video tabs (placeholder: as it was hibernated)
+            QWidget *widget = m_tab_widget->widget(i);
+            if (VideoView *view = qobject_cast<VideoView*>(widget))
+                tab_info["state"] = view->state();
+            else if (widget->property("placeholder").toBool())
+                tab_info["state"] = widget->property("state");
+            tab_info["name"] = m_tab_widget->tabText(i);
+            if (i == m_tab_widget->currentIndex())
+                current_index = tab_info_list.size();
             tab_info_list << tab_info;
         }
         QDataStream ds(&buffer);
         ds << tab_info_list;
+        //Index in the list, -1 if the current tab is not restored (subscriptions)
+        settings->setVariant("tab_index", current_index);
     }
     settings->setVariant("tabs", buffer.data().toBase64()); //q_settings
 
+    //Playback positions are written in batches, write the last ones now
+    ResumePositions::globalInstance()->flush();
+
     settings->save();
 
     event->accept();
@@ -136,6 +185,9 @@ PeerPlayerMain::addSubscriptionsTab()
     connect(subscriptions_tab,
         SIGNAL(openRequested(const QString&)),
         SLOT(addSiteTab(const QString&)));
+    connect(subscriptions_tab,
+        SIGNAL(openVideoSignal(const QString&, const QVariantMap&)),
+        SLOT(openVideo(const QString&, const QVariantMap&)));
     int index = m_tab_widget->count();
     m_tab_widget->addTab(subscriptions_tab, tr("Subscriptions"));
     //m_tab_widget->tabBar()->tabButton(index, QTabBar::RightSide)->hide();
@@ -148,6 +200,43 @@ PeerPlayerMain::addSubscriptionsTab()
     });
 }
 
+void
+PeerPlayerMain::addDownloadsTab()
+{
+    //Downloads of all tabs (only one downloads tab)
+    DownloadsView *downloads_tab = new DownloadsView;
+    downloads_tab->setAttribute(Qt::WA_DeleteOnClose);
+    m_tab_widget->addTab(downloads_tab, tr("Downloads"));
+    m_tab_widget->setCurrentWidget(downloads_tab);
+
+    m_act_downloads->setEnabled(false);
+
+    connect(downloads_tab, &QObject::destroyed, this, [this]()
+    {
+        m_act_downloads->setEnabled(true);
+    });
+}
+
+void
+PeerPlayerMain::addSearchTab()
+{
+    //Search in the catalog of all videos seen (only one search tab)
+    SearchView *search_tab = new SearchView;
+    search_tab->setAttribute(Qt::WA_DeleteOnClose);
+    connect(search_tab,
+        SIGNAL(openVideoSignal(const QString&, const QVariantMap&)),
+        SLOT(openVideo(const QString&, const QVariantMap&)));
+    m_tab_widget->addTab(search_tab, tr("Search"));
+    m_tab_widget->setCurrentWidget(search_tab);
+
+    m_act_search->setEnabled(false);
+
+    connect(search_tab, &QObject::destroyed, this, [this]()
+    {
+        m_act_search->setEnabled(true);
+    });
+}
+
 void
 PeerPlayerMain::showSettings()
 {
@@ -173,10 +262,19 @@ PeerPlayerMain::showOpenChannelUrl()
 
 SiteView*
 PeerPlayerMain::addSiteTab(const QString &address)
+{
+    SiteView *site_tab = createSiteView(address);
+    m_tab_widget->addTab(site_tab, tr(""));
+    initNewTabWidget(site_tab, "site", address);
+
+    return site_tab;
+}
+
+SiteView*
+PeerPlayerMain::createSiteView(const QString &address)
 {
     SiteView *site_tab = new SiteView(address);
     site_tab->setAttribute(Qt::WA_DeleteOnClose);
-    m_tab_widget->addTab(site_tab, tr(""));
     connect(site_tab, SIGNAL(setName(const QString&, QWidget*)), SLOT(setTabName(const QString&, QWidget*)));
     connect(site_tab,
         SIGNAL(openVideoSignal(const QString&, const QVariantMap&)),
@@ -185,8 +283,6 @@ PeerPlayerMain::addSiteTab(const QString &address)
         SIGNAL(showPageSignal(const QString&, const ActionContextRef&)),
         SLOT(showPage(const QString&, const ActionContextRef&)));
 
-    initNewTabWidget(site_tab, "site", address);
-
     return site_tab;
 }
 
@@ -232,19 +328,24 @@ PeerPlayerMain::checkLastTabClosed()
 }
 
 void
-PeerPlayerMain::openVideo(const QString &url, const QVariantMap &item, bool in_background)
+PeerPlayerMain::openVideo(const QString &url, const QVariantMap &item, bool in_background, const QVariantMap &state)
 {
     //note that item["title"] may be blank/missing
     //the title updated via signal later
     QString name = item["title"].toString();
     //TODO animate tab name, rolling long titles and ">" play icon 
 
+    //Background tabs (restored) are created when they're shown
+    if (in_background)
+    {
+        addTabPlaceholder("video", url, item, state, name);
+        return;
+    }
+
     //Create video tab widget
-    VideoView *view = new VideoView(url, item, 0, !in_background); //TODO , site ref
-    view->setAttribute(Qt::WA_DeleteOnClose);
+    VideoView *view = createVideoView(url, item, state, !in_background); //TODO , site ref
     m_tab_widget->addTab(view, name);
     initNewTabWidget(view, "video", url, item); //store open tab
-    connect(view, SIGNAL(setName(const QString&, const QString&, QWidget*)), SLOT(setTabName(const QString&, const QString&, QWidget*)));
     //Switch to new tab and allow playback unless opened/restored in background
     //TODO there's no delay when adding local media,
     //it would already be added but paused at this point
@@ -259,92 +360,162 @@ PeerPlayerMain::openVideo(const QString &url, const QVariantMap &item, bool in_b
 
 }
 
+VideoView*
+PeerPlayerMain::createVideoView(const QString &url, const QVariantMap &item, const QVariantMap &state, bool autoplay)
+{
+    VideoView *view = new VideoView(url, item, 0, autoplay);
+    view->restoreState(state);
+    view->setAttribute(Qt::WA_DeleteOnClose);
+    connect(view, SIGNAL(setName(const QString&, const QString&, QWidget*)), SLOT(setTabName(const QString&, const QString&, QWidget*)));
+    return view;
+}
+
 /**
- * Displays an interactive web page in a new tab, returns result to action.
- *
- * QWebEngineProfile is a bit difficult to get running.
- * The QtWebEngineProcess executable should be copied to the bin/ directory,
- * otherwise the application may crash even if QTWEBENGINEPROCESS_PATH is set.
- *
- * The bin/ directory should contain a Qt config file called qt.conf:
- * [Paths]
- * Data = /build/.../qtwebengine/src/core/release
- * Translations = /build/.../qtwebengine/src/core/release
+ * Displays an interactive web page (login form), returns result to action.
  *
- * qDebug() << QLibraryInfo::location(QLibraryInfo::DataPath);
- * qDebug() << QLibraryInfo::location(QLibraryInfo::TranslationsPath);
+ * The page is shown by the peerplayer-auth helper (bin/, next to the player),
+ * so QtWebEngine is only loaded when a site actually needs it.
+ * The helper prints the result as JSON {url, ok, text} which is passed on
+ * to ctx->setValue(), like the web view did before.
  */
 void
 PeerPlayerMain::showPage(const QString &url, const ActionContextRef &ctx)
 {
     //VSite requested interactive page to be displayed
-    //The web view will be owned by the action (ctx), deleted on timeout
-    //Initialize QWebEngineView, connect it to action ctx
+    //The helper is stopped when the action (ctx) is deleted, on timeout
     qInfo() << "main: show page:" << url;
-    QWebEngineView *view = new QWebEngineView();
-    view->setAttribute(Qt::WA_DeleteOnClose); //timeout => view->deleteLater()
-    connect(ctx.data(), SIGNAL(destroyed()), view, SLOT(close())); //ctx = parent
-    m_tab_widget->addTab(view, "AUTHENTICATION");
-    m_tab_widget->setCurrentWidget(view);
-    view->pageAction(QWebEnginePage::ViewSource)->setEnabled(false);
-    view->pageAction(QWebEnginePage::SavePage)->setEnabled(false);
-    view->pageAction(QWebEnginePage::InspectElement)->setEnabled(false);
-    view->pageAction(QWebEnginePage::DownloadMediaToDisk)->setEnabled(false);
-    view->pageAction(QWebEnginePage::DownloadImageToDisk)->setEnabled(false);
-    view->pageAction(QWebEnginePage::DownloadLinkToDisk)->setEnabled(false);
-    //OpenLinkInNewBackgroundTab OpenLinkInNewTab OpenLinkInNewWindow OpenLinkInThisWindow
-    //Reload?
-
-    //Initialize page object with off-the-record profile, i.e., private mode
-    //profile should not be deleted before page; therefore connecting delete...
-    //[WARNING] Release of profile requested but WebEnginePage still not deleted. Expect troubles !
-    QWebEngineProfile *profile = new QWebEngineProfile(); //temp. profile
-    QWebEnginePage *page = new QWebEnginePage(profile, view);
-    connect(view, SIGNAL(destroyed()), profile, SLOT(deleteLater()));
-    view->setPage(page);
-    page->setUrl(QUrl(url));
-
-    //Install action handlers, load action returns page/result to action
-    connect(view,
-        &QWebEngineView::titleChanged,
-        [this, view](const QString &title) { this->setTabName(title, view); });
-    connect(view,
-        &QWebEngineView::loadFinished, this,
-        [this, view, ctx](bool ok) { this->handleLoadedPage(view, ok, ctx); });
+    QString program = QStandardPaths::findExecutable("peerplayer-auth",
+        QStringList() << QCoreApplication::applicationDirPath());
+    if (program.isEmpty())
+        program = QStandardPaths::findExecutable("peerplayer-auth");
+    if (program.isEmpty())
+    {
+        qWarning() << "login page helper not found (peerplayer-auth)";
+        QMessageBox::warning(this, tr("Authentication"),
+            tr("The login page cannot be shown, peerplayer-auth is missing."));
+        if (ctx) ctx->setError();
+        return;
+    }
+
+    QProcess *process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    connect(ctx.data(), &QObject::destroyed, process, [process]()
+    {
+        process->kill();
+    });
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [process, ctx](int code, QProcess::ExitStatus status)
+    {
+        process->deleteLater();
+        if (!ctx) return;
+        //Page closed, helper crashed or no usable result, the action fails
+        //instead of waiting for its timeout
+        QVariant result;
+        if (status == QProcess::NormalExit && code == 0)
+            result = QJsonDocument::fromJson(process->readAllStandardOutput()).toVariant();
+        if (!result.isValid())
+        {
+            qWarning() << ctx.data() << "no page result, exit code" << code;
+            ctx->setError();
+            return;
+        }
+        qInfo() << ctx.data() << "page result" << result.toMap().value("url").toString();
+        ctx->setValue(result);
+    });
+    connect(process, &QProcess::errorOccurred, this, [process, ctx](QProcess::ProcessError error)
+    {
+        qWarning() << "login page helper failed:" << error;
+        if (error != QProcess::FailedToStart) return; //finished follows
+        process->deleteLater();
+        if (ctx) ctx->setError();
+    });
+    process->start(program, QStringList() << url);
+
+}
 
+void
+PeerPlayerMain::activateTab(int index)
+{
+    //Remember when the previous tab was left, see hibernateTabs()
+    if (m_active_tab)
+        m_active_tab->setProperty("last_active", QDateTime::currentMSecsSinceEpoch());
+    m_active_tab = m_tab_widget->widget(index);
+    if (!m_active_tab) return;
+    m_active_tab->setProperty("last_active", QDateTime::currentMSecsSinceEpoch());
+
+    if (m_active_tab->property("placeholder").toBool())
+        materializeTab(index);
 }
 
 void
-PeerPlayerMain::handleLoadedPage(QWebEngineView *view, bool ok, const ActionContextRef &ctx)
+PeerPlayerMain::hibernateTabs()
 {
-    //A page has been loaded, first load is initial page (login form)
-    //second one is usually the expected result page
-    int count = view->property("load_count").toInt();
-    bool initial_page_loaded = count++ > 0;
-    view->setProperty("load_count", count);
-    qInfo() << ctx.data() << "page loaded" << ok << view->url().url() << "step" << count;
-
-    //count - first page is login page with username/password fields
-    //after entering credentials and confirming, that's the second page
-    //then we grab the result and forward it to be evaluated
-    //(action plan continues, finishes)
-    if (count == 2)
+    int minutes = ProfileSettings::profile()->variant("tab_hibernate_minutes").toInt();
+    if (minutes <= 0) return;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    for (int i = 0; i < m_tab_widget->count(); i++)
     {
-        //final step
-        qInfo() << "final step, finishing action...";
-        QVariantMap map;
-        map["url"] = view->url().url();
-        map["ok"] = ok;
-        view->page()->toPlainText([map, ctx](const QString &text)
-        {
-            QVariantMap map2(map);
-            map2["text"] = text;
-            qDebug() << map2;
-            ctx->setValue(QVariant(map2));
-        });
-        QTimer::singleShot(0, view, SLOT(deleteLater()));
+        VideoView *view = qobject_cast<VideoView*>(m_tab_widget->widget(i));
+        if (!view || view == m_tab_widget->currentWidget()) continue;
+        qint64 last_active = view->property("last_active").toLongLong();
+        if (now - last_active < minutes * 60 * 1000 || !view->canHibernate()) continue;
+
+        //Player, media, site and storage go away with the view
+        //Source and position are kept by the placeholder
+        int tab_id = view->property("tab_id").toInt();
+        QVariantMap tab_info = m_loaded_tabs.value(tab_id);
+        qInfo() << "hibernating video tab" << i << tab_info["address"].toString();
+        m_tab_widget->blockSignals(true);
+        addTabPlaceholder("video", tab_info["address"].toString(), tab_info["item"].toMap(),
+            view->state(), m_tab_widget->tabText(i), i);
+        m_tab_widget->setTabToolTip(i, m_tab_widget->tabToolTip(i + 1));
+        m_tab_widget->removeTab(i + 1);
+        m_tab_widget->blockSignals(false);
+        view->close();
     }
+}
 
+QWidget*
+PeerPlayerMain::addTabPlaceholder(const QString &type, const QString &url, const QVariantMap &item, const QVariantMap &state, const QString &name, int index)
+{
+    QWidget *placeholder = new QWidget;
+    placeholder->setAttribute(Qt::WA_DeleteOnClose);
+    placeholder->setProperty("placeholder", true);
+    placeholder->setProperty("state", state);
+    m_tab_widget->insertTab(index, placeholder, name);
+    if (type == "site") m_tab_widget->setTabToolTip(m_tab_widget->indexOf(placeholder), url);
+    initNewTabWidget(placeholder, type, url, item);
+    return placeholder;
+}
+
+void
+PeerPlayerMain::materializeTab(int index)
+{
+    QWidget *placeholder = m_tab_widget->widget(index);
+    int tab_id = placeholder->property("tab_id").toInt();
+    QVariantMap tab_info = m_loaded_tabs.value(tab_id);
+    QString type = tab_info["type"].toString();
+    QString url = tab_info["address"].toString();
+    QVariantMap item = tab_info["item"].toMap();
+
+    //Replace placeholder, without switching to the neighbors in between
+    QWidget *view;
+    if (type == "site")
+        view = createSiteView(url);
+    else
+        view = createVideoView(url, item, placeholder->property("state").toMap(), false);
+    m_tab_widget->blockSignals(true);
+    m_tab_widget->insertTab(index, view, m_tab_widget->tabText(index));
+    m_tab_widget->setTabToolTip(index, m_tab_widget->tabToolTip(index + 1));
+    m_tab_widget->removeTab(index + 1);
+    m_tab_widget->setCurrentIndex(index);
+    m_tab_widget->blockSignals(false);
+    placeholder->close();
+
+    initNewTabWidget(view, type, url, item);
+    view->setProperty("last_active", QDateTime::currentMSecsSinceEpoch());
+    m_active_tab = view;
 }
 
 void
@@ -0,0 +1,83 @@
+#include "resumepositions.hpp"
+
+ResumePositions*
+ResumePositions::globalInstance()
+{
+    static QPointer<ResumePositions> global_instance;
+    if (!global_instance)
+        global_instance = new ResumePositions(qApp);
+    return global_instance;
+}
+
+ResumePositions::ResumePositions(QObject *parent)
+               : QObject(parent)
+{
+    //Not restarted on every update, so it's written at least every few seconds
+    m_tmr_flush.setSingleShot(true);
+    m_tmr_flush.setInterval(10000);
+    connect(&m_tmr_flush, SIGNAL(timeout()), SLOT(flush()));
+    connect(qApp, SIGNAL(aboutToQuit()), SLOT(flush()));
+}
+
+ResumePositions::~ResumePositions()
+{
+    flush();
+}
+
+QStringList
+ResumePositions::keysFor(const QString &address, const QUrl &source)
+{
+    QStringList keys;
+    if (!address.isEmpty())
+        keys << "address:" + address;
+    if (source.isLocalFile())
+    {
+        QString file = source.toLocalFile();
+        QString hash = LibraryIndex::globalInstance()->fileInfo(file).value("hash_md5").toString();
+        keys << (hash.isEmpty() ? "file:" + file : "hash:" + hash);
+    }
+    else if (address.isEmpty() && source.isValid())
+    {
+        keys << "url:" + source.toString();
+    }
+    return keys;
+}
+
+qint64
+ResumePositions::position(const QStringList &keys)
+{
+    LibraryIndex *library = LibraryIndex::globalInstance();
+    foreach (const QString &key, keys)
+    {
+        QVariantMap position = m_pending.contains(key) ? m_pending[key] : library->resumePosition(key);
+        qint64 time = position.value("time").toLongLong();
+        if (time > 0) return time;
+    }
+    return 0;
+}
+
+void
+ResumePositions::setPosition(const QStringList &keys, qint64 time, qint64 duration)
+{
+    //Don't bother about the first seconds, forget it at the end (credits)
+    if (time < 10000 || (duration > 0 && duration - time < qMax((qint64)15000, duration / 50)))
+        time = 0;
+
+    QVariantMap position;
+    position["time"] = time;
+    position["duration"] = duration;
+    foreach (const QString &key, keys)
+        m_pending[key] = position;
+
+    if (!m_tmr_flush.isActive())
+        m_tmr_flush.start();
+}
+
+void
+ResumePositions::flush()
+{
+    m_tmr_flush.stop();
+    if (m_pending.isEmpty()) return;
+    LibraryIndex::globalInstance()->setResumePositions(m_pending);
+    m_pending.clear();
+}
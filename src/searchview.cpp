@@ -0,0 +1,90 @@
+#include "searchview.hpp"
+
+SearchView::SearchView(QWidget *parent)
+          : QWidget(parent),
+            m_search_serial(0)
+{
+    QVBoxLayout *vbox = new QVBoxLayout;
+    setLayout(vbox);
+
+    m_txt_query = new QLineEdit;
+    m_txt_query->setPlaceholderText(tr("Search videos of all channels seen so far"));
+    m_txt_query->setClearButtonEnabled(true);
+    vbox->addWidget(m_txt_query);
+    m_lbl_status = new QLabel;
+    vbox->addWidget(m_lbl_status);
+
+    m_model = new VideoListModel(this);
+    m_list = m_model->createListView();
+    connect(m_list, SIGNAL(clicked(const QModelIndex&)), SLOT(openVideo(const QModelIndex&)));
+    vbox->addWidget(m_list);
+
+    //Search while typing, after a short pause
+    m_tmr_search = new QTimer(this);
+    m_tmr_search->setSingleShot(true);
+    m_tmr_search->setInterval(200);
+    connect(m_tmr_search, SIGNAL(timeout()), SLOT(search()));
+    connect(m_txt_query, SIGNAL(textChanged(const QString&)), m_tmr_search, SLOT(start()));
+    connect(m_txt_query, SIGNAL(returnPressed()), SLOT(search()));
+
+    //Thumbnails are loaded when scrolling stops
+    m_tmr_visible = new QTimer(this);
+    m_tmr_visible->setSingleShot(true);
+    m_tmr_visible->setInterval(100);
+    connect(m_tmr_visible, SIGNAL(timeout()), SLOT(updateVisibleRows()));
+    connect(m_list->verticalScrollBar(), SIGNAL(valueChanged(int)), m_tmr_visible, SLOT(start()));
+    connect(m_model, SIGNAL(modelReset()), m_tmr_visible, SLOT(start()));
+
+    m_txt_query->setFocus();
+}
+
+void
+SearchView::search()
+{
+    m_tmr_search->stop();
+    QString query = m_txt_query->text().trimmed();
+    int serial = ++m_search_serial; //running search is outdated
+    if (query.isEmpty())
+    {
+        m_model->setItems(QVariantList());
+        m_lbl_status->clear();
+        return;
+    }
+
+    //Index lookup runs in the background, typing is not blocked
+    //Result of an older query (typed on) is dropped
+    int limit = ProfileSettings::profile()->setDefaultVariant("search_result_limit", 200).toInt();
+    QSharedPointer<QElapsedTimer> timer(new QElapsedTimer);
+    timer->start();
+    QFutureWatcher<QVariantList> *watcher = new QFutureWatcher<QVariantList>(this);
+    connect(watcher, &QFutureWatcher<QVariantList>::finished, this, [this, watcher, serial, timer]()
+    {
+        watcher->deleteLater();
+        if (serial != m_search_serial) return;
+        QVariantList items = watcher->result();
+        m_lbl_status->setText(tr("%1 videos found (%2 ms)").arg(items.size()).arg(timer->elapsed()));
+        m_model->setItems(items, 0, qMax(1, items.size()));
+        m_list->scrollToTop();
+    });
+    watcher->setFuture(QtConcurrent::run(VideoCatalog::globalInstance(), &VideoCatalog::search, query, limit));
+}
+
+void
+SearchView::updateVisibleRows()
+{
+    int first, last;
+    if (!VideoListModel::visibleRows(m_list, first, last)) return;
+    int margin = last - first + 1;
+    m_model->fetchThumbnails(first - margin, last + margin);
+}
+
+void
+SearchView::openVideo(const QModelIndex &index)
+{
+    QVariantMap item = m_model->item(index.row());
+    if (item.isEmpty()) return;
+    //Catalog items come from several sites, the address is the resolved video url
+    QString address = item.value("address").toString();
+    if (address.isEmpty()) address = item.value("url").toString();
+    emit openVideoSignal(address, item);
+}
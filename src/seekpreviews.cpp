@@ -0,0 +1,210 @@
+#include "seekpreviews.hpp"
+
+SeekPreviews*
+SeekPreviews::globalInstance()
+{
+    static QPointer<SeekPreviews> global_instance;
+    if (!global_instance)
+        global_instance = new SeekPreviews(qApp);
+    return global_instance;
+}
+
+SeekPreviews::SeekPreviews(QObject *parent)
+            : QObject(parent),
+              m_sheets(8),
+              m_stop(0),
+              m_playback_active(0),
+              m_vlc_instance(0)
+{
+    m_cache_dir = ProfileSettings::profile()->configDirectory(true).absoluteFilePath("previews");
+    QDir().mkpath(m_cache_dir);
+
+    //One file at a time, decoding must not slow anything else down
+    m_pool.setMaxThreadCount(1);
+
+    DownloadManager *manager = DownloadManager::globalInstance();
+    m_playback_active = manager->isPlaybackActive();
+    connect(manager, SIGNAL(playbackActiveChanged(bool)), SLOT(setPlaybackActive(bool)));
+}
+
+SeekPreviews::~SeekPreviews()
+{
+    m_stop = 1;
+    m_idle_mutex.lock();
+    m_idle.wakeAll();
+    m_idle_mutex.unlock();
+    m_pool.clear();
+    m_pool.waitForDone();
+
+    VlcInstance::release(m_vlc_instance);
+}
+
+bool
+SeekPreviews::hasPreview(const QString &file)
+{
+    return QFileInfo(sheetPath(file) + ".json").exists();
+}
+
+QImage
+SeekPreviews::frameAt(const QString &file, qint64 time)
+{
+    QString path = sheetPath(file);
+    Sheet *sheet = m_sheets.object(path);
+    if (!sheet)
+    {
+        //Load sheet and its grid description
+        QFile json_file(path + ".json");
+        if (!json_file.open(QIODevice::ReadOnly)) return QImage();
+        QVariantMap info = QJsonDocument::fromJson(json_file.readAll()).toVariant().toMap();
+        sheet = new Sheet;
+        sheet->image = QImage(path + ".jpg");
+        sheet->interval = info["interval"].toLongLong();
+        sheet->count = info["count"].toInt();
+        sheet->columns = info["columns"].toInt();
+        sheet->tile = QSize(info["width"].toInt(), info["height"].toInt());
+        if (sheet->image.isNull() || sheet->interval <= 0 || sheet->columns <= 0)
+        {
+            delete sheet;
+            return QImage();
+        }
+        m_sheets.insert(path, sheet);
+    }
+
+    int index = qBound(0, (int)(time / sheet->interval), sheet->count - 1);
+    QPoint pos((index % sheet->columns) * sheet->tile.width(), (index / sheet->columns) * sheet->tile.height());
+    return sheet->image.copy(QRect(pos, sheet->tile));
+}
+
+void
+SeekPreviews::request(const QString &file)
+{
+    if (file.isEmpty() || m_queued.contains(file)) return;
+    if (hasPreview(file))
+    {
+        emit previewReady(file);
+        return;
+    }
+
+    m_queued << file;
+    QString sheet_path = sheetPath(file);
+    QtConcurrent::run(&m_pool, [this, file, sheet_path]()
+    {
+        bool ok = generate(file, sheet_path);
+        QMetaObject::invokeMethod(this, [this, file, ok]()
+        {
+            generated(file, ok);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void
+SeekPreviews::generated(const QString &file, bool ok)
+{
+    m_queued.remove(file);
+    if (ok) emit previewReady(file);
+}
+
+void
+SeekPreviews::setPlaybackActive(bool active)
+{
+    QMutexLocker locker(&m_idle_mutex);
+    m_playback_active = active ? 1 : 0;
+    if (!active) m_idle.wakeAll();
+}
+
+QString
+SeekPreviews::sheetPath(const QString &file)
+{
+    //A modified file gets a new preview
+    QFileInfo fi(file);
+    QString id = QString("%1|%2|%3").arg(fi.absoluteFilePath()).arg(fi.size()).arg(fi.lastModified().toMSecsSinceEpoch());
+    QString key = QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir(m_cache_dir).absoluteFilePath(key);
+}
+
+bool
+SeekPreviews::generate(const QString &file, const QString &sheet_path)
+{
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+    const QSize tile(160, 90);
+    const int columns = 10;
+    FrameGrabber grabber(vlcInstance(), &m_stop, tile);
+    grabber.setKeepMissing(true);
+    grabber.setPauseFlag(&m_playback_active);
+
+    //Open once to get the duration
+    if (!waitForIdle()) return false;
+    grabber.grabFrames(file, QList<double>());
+    qint64 duration = grabber.duration();
+    if (duration <= 0 || m_stop)
+    {
+        qDebug() << "seek previews - cannot open" << file;
+        return false;
+    }
+    qint64 interval = qMax((qint64)10000, duration / 100);
+    int count = qMax(1, (int)(duration / interval));
+
+    //Frames are grabbed in batches, suspended in between while playing
+    QList<QImage> frames;
+    const int batch_size = 10;
+    for (int i = 0; i < count && waitForIdle(); i += batch_size)
+    {
+        QList<double> positions;
+        for (int j = i; j < qMin(count, i + batch_size); j++)
+            positions << (double)(j * interval) / duration;
+        QList<QImage> batch = grabber.grabFrames(file, positions);
+        if (batch.isEmpty()) return false;
+        frames << batch;
+    }
+    if (m_stop || frames.size() != count) return false;
+
+    //Grid of frames, missing ones stay black
+    int rows = (count + columns - 1) / columns;
+    QImage image(columns * tile.width(), rows * tile.height(), QImage::Format_RGB32);
+    image.fill(Qt::black);
+    QPainter painter(&image);
+    for (int i = 0; i < count; i++)
+    {
+        if (frames[i].isNull()) continue;
+        painter.drawImage(QPoint((i % columns) * tile.width(), (i / columns) * tile.height()), frames[i]);
+    }
+    painter.end();
+    if (!image.save(sheet_path + ".jpg", "JPG", 75))
+    {
+        qWarning() << "seek previews - cannot save" << sheet_path;
+        return false;
+    }
+
+    //Description is written last, it marks the preview as complete
+    QJsonObject info;
+    info["file"] = file;
+    info["duration"] = duration;
+    info["interval"] = interval;
+    info["count"] = count;
+    info["columns"] = columns;
+    info["width"] = tile.width();
+    info["height"] = tile.height();
+    QFile json_file(sheet_path + ".json");
+    if (!json_file.open(QIODevice::WriteOnly)) return false;
+    json_file.write(QJsonDocument(info).toJson(QJsonDocument::Compact));
+    qDebug() << "seek previews - generated" << count << "frames for" << file;
+    return true;
+}
+
+bool
+SeekPreviews::waitForIdle()
+{
+    QMutexLocker locker(&m_idle_mutex);
+    while (m_playback_active && !m_stop)
+        m_idle.wait(&m_idle_mutex);
+    return !m_stop;
+}
+
+libvlc_instance_t*
+SeekPreviews::vlcInstance()
+{
+    QMutexLocker locker(&m_vlc_mutex);
+    if (!m_vlc_instance)
+        m_vlc_instance = VlcInstance::acquire();
+    return m_vlc_instance;
+}
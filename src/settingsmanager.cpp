@@ -238,6 +238,32 @@ SettingsManager::setDefaultVariant(const QString &key, const QVariant &default_v
     return value;
 }
 
+void
+SettingsManager::removeVariant(const QString &key)
+{
+    //Path to requested dict element
+    if (key.isEmpty()) return;
+    QStringList dict_keys = splitItemKey(key).first;
+    QString item_key = splitItemKey(key).second;
+
+    if (dict_keys.isEmpty())
+    {
+        //Top-level element
+        m_data->remove(item_key);
+    }
+    else
+    {
+        //Get parent dict, remove element and put modified dict back
+        QString dict_key = dict_keys.takeLast();
+        QVariantMap dict = variant(dict_keys, dict_key, QVariant()).toMap();
+        if (!dict.contains(item_key)) return;
+        dict.remove(item_key);
+        setVariant(dict_keys, dict_key, dict);
+    }
+
+    m_state["dirty"] = true;
+}
+
 QStringList
 SettingsManager::keys(const QString &key, bool with_sub_maps) const
 {
@@ -51,9 +51,62 @@ MainSettingsWidget::MainSettingsWidget(QWidget *parent)
     connect(chk_dlp_auto, SIGNAL(toggled(bool)), SLOT(setDlpUpdate(bool)));
     form_dlp->addRow("", chk_dlp_auto);
 
+    //Downloads (all tabs)
+    QLabel *lbl_downloads_top = new QLabel(tr("Downloads"));
+    lbl_downloads_top->setStyleSheet("QLabel { font-size:14pt; }");
+    vbox->addWidget(lbl_downloads_top);
+    QFormLayout *form_downloads = new QFormLayout;
+    vbox->addLayout(form_downloads);
+    ProfileSettings *settings = ProfileSettings::profile();
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QSpinBox *spn_concurrent = new QSpinBox;
+    spn_concurrent->setRange(1, 16);
+    spn_concurrent->setValue(manager->maxConcurrent());
+    connect(spn_concurrent, QOverload<int>::of(&QSpinBox::valueChanged), this, [manager](int count)
+    {
+        manager->setMaxConcurrent(count);
+    });
+    form_downloads->addRow(tr("Simultaneous downloads"), spn_concurrent);
+    QSpinBox *spn_rate = new QSpinBox;
+    spn_rate->setRange(0, 1000000);
+    spn_rate->setSuffix(" KiB/s");
+    spn_rate->setSpecialValueText(tr("Unlimited"));
+    spn_rate->setValue(manager->rateLimit() / 1024);
+    connect(spn_rate, QOverload<int>::of(&QSpinBox::valueChanged), this, [manager](int kib)
+    {
+        manager->setRateLimit((qint64)kib * 1024);
+    });
+    form_downloads->addRow(tr("Bandwidth limit"), spn_rate);
+    QSpinBox *spn_rate_playing = new QSpinBox;
+    spn_rate_playing->setRange(0, 1000000);
+    spn_rate_playing->setSuffix(" KiB/s");
+    spn_rate_playing->setSpecialValueText(tr("Unlimited"));
+    spn_rate_playing->setToolTip(tr("Limit for downloads in the background while a video is playing, so playback does not stall."));
+    spn_rate_playing->setValue(settings->variant("download_rate_while_playing").toInt());
+    connect(spn_rate_playing, QOverload<int>::of(&QSpinBox::valueChanged), this, [settings](int kib)
+    {
+        settings->setVariant("download_rate_while_playing", kib);
+    });
+    form_downloads->addRow(tr("Limit while playing"), spn_rate_playing);
+
+    //Local video library
+    QLabel *lbl_library_top = new QLabel(tr("Video library"));
+    lbl_library_top->setStyleSheet("QLabel { font-size:14pt; }");
+    vbox->addWidget(lbl_library_top);
+    QFormLayout *form_library = new QFormLayout;
+    vbox->addLayout(form_library);
+    lbl_library_dups = new QLabel;
+    form_library->addRow(tr("Duplicate videos"), lbl_library_dups);
+    btn_library_link = new QPushButton(tr("Replace duplicates with links"));
+    btn_library_link->setToolTip(tr("Identical copies are replaced with hard links to one file, file names are kept."));
+    btn_library_link->setDisabled(true);
+    connect(btn_library_link, SIGNAL(clicked()), SLOT(linkDuplicates()));
+    form_library->addRow("", btn_library_link);
+
     vbox->addStretch();
 
     QTimer::singleShot(0, this, SLOT(updateDlpFields()));
+    QTimer::singleShot(0, this, SLOT(updateLibraryFields()));
 
 }
 
@@ -117,3 +170,49 @@ MainSettingsWidget::setDlpUpdate(bool enabled)
     updateDlpFields();
 }
 
+void
+MainSettingsWidget::updateLibraryFields()
+{
+    //Stats all duplicates, in the background
+    QFutureWatcher<QVariantMap> *watcher = new QFutureWatcher<QVariantMap>(this);
+    connect(watcher, &QFutureWatcher<QVariantMap>::finished, this, [this, watcher]()
+    {
+        watcher->deleteLater();
+        showLibraryReport(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run(&VideoStorage::duplicateReport));
+}
+
+void
+MainSettingsWidget::showLibraryReport(const QVariantMap &report)
+{
+    qint64 reclaimable = report["reclaimable"].toLongLong();
+    if (report["groups"].toInt())
+    {
+        lbl_library_dups->setText(tr("%1 videos in %2 files, %3 can be freed")
+            .arg(report["groups"].toInt())
+            .arg(report["files"].toInt())
+            .arg(locale().formattedDataSize(reclaimable)));
+    }
+    else
+    {
+        lbl_library_dups->setText(tr("None"));
+    }
+    btn_library_link->setDisabled(reclaimable == 0);
+}
+
+void
+MainSettingsWidget::linkDuplicates()
+{
+    btn_library_link->setDisabled(true);
+    QFutureWatcher<qint64> *watcher = new QFutureWatcher<qint64>(this);
+    connect(watcher, &QFutureWatcher<qint64>::finished, this, [this, watcher]()
+    {
+        watcher->deleteLater();
+        qint64 freed = watcher->result();
+        QMessageBox::information(this, tr("Video library"),
+            tr("Duplicates have been replaced, %1 freed.").arg(locale().formattedDataSize(freed)));
+        updateLibraryFields();
+    });
+    watcher->setFuture(QtConcurrent::run(&VideoStorage::linkDuplicates));
+}
@@ -166,26 +166,38 @@ SiteView::setVideoList(const QVariantList &items)
 
 VideoListView::VideoListView(VSiteBase *site, const QVariantMap &channel, QFrame *parent)
              : QFrame(parent),
-               m_current_page(0),
+               m_at_end(false),
                m_page_size(10)
 {
     m_site = site;
     m_ch_info = channel;
     QVariantList items = channel["items"].toList();
 
-    connect(m_site, SIGNAL(loadedVideoList(const QVariantList&)), SLOT(setVideoList(const QVariantList&)));
-    connect(m_site, SIGNAL(loadedThumbnail(const QPixmap&, QObject*)), SLOT(loadThumbnail(const QPixmap&, QObject*)));
+    //Further pages are loaded by this view (not the whole list, see SiteView)
+    connect(m_site, SIGNAL(loadedVideoPage(int, const QVariantList&)), SLOT(addVideoPage(int, const QVariantList&)));
     //connect(m_site, SIGNAL(loadedVideoUrl(const QString&, QObject*)), SLOT(loadVideoUrl(const QString&, QObject*))); //TODO
 
     //Local storage
     m_storage = new VideoStorage(this);
 
-    wid_list = new QWidget;
-    QVBoxLayout *vbox_list = new QVBoxLayout;
+    //List view, only visible rows are painted
+    m_model = new VideoListModel(this);
+    m_model->setSiteUrl(m_site->siteUrl());
+    m_list = m_model->createListView();
+    connect(m_list, SIGNAL(clicked(const QModelIndex&)), SLOT(openVideo(const QModelIndex&)));
+
+    //Pages and thumbnails are loaded when scrolling stops, not for every row passed by
+    m_tmr_visible = new QTimer(this);
+    m_tmr_visible->setSingleShot(true);
+    m_tmr_visible->setInterval(100);
+    connect(m_tmr_visible, SIGNAL(timeout()), SLOT(updateVisibleRows()));
+    connect(m_list->verticalScrollBar(), SIGNAL(valueChanged(int)), m_tmr_visible, SLOT(start()));
+    connect(m_model, SIGNAL(modelReset()), m_tmr_visible, SLOT(start()));
+    connect(m_model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), m_tmr_visible, SLOT(start()));
+
     QVBoxLayout *vbox = new QVBoxLayout;
-    wid_list->setLayout(vbox_list);
     setLayout(vbox);
-    vbox->addWidget(wid_list);
+    vbox->addWidget(m_list);
 
     setVideoList(items);
 
@@ -194,129 +206,70 @@ VideoListView::VideoListView(VSiteBase *site, const QVariantMap &channel, QFrame
 void
 VideoListView::setVideoList(const QVariantList &items)
 {
-    foreach (QObject *obj, wid_list->children())
-        obj->deleteLater();
-    QVBoxLayout *vbox = new QVBoxLayout;
-    if (wid_list->layout()) delete wid_list->layout();
-    wid_list->setLayout(vbox);
-
-    //Grid used to display two columns, thumbnails on the left
-    //We don't want to have a 9x9 grid or similar, it would obfuscate the order
-    //With two columns, thumbnail can be grown so you can actually see it well
-    QGridLayout *grid = new QGridLayout;
-    vbox->addLayout(grid);
-    int grid_row = -1;
-    foreach (const QVariant &var, items)
-    {
-        QVariantMap item = var.toMap();
-
-        //QGridLayout *grid_item = new QGridLayout;
-        grid_row++;
-
-        //Metadata - title, url, description, thumbnail
-        QString name = item["title"].toString();
-        QString description = item["description"].toString();
-        QString address = item["address"].toString();
-        QString thumbnail_url = item["thumbnail"].toString();
-        QString video_url = item["url"].toString();
-        if (video_url.startsWith("/"))
-        {
-            video_url = m_site->siteUrl().resolved(video_url).url();
-            item["url"] = video_url;
-        }
-
-        //Thumbnail widget (image yet to be loaded)
-        ImageWidget *wid_thumbnail = new ImageWidget(true);
-        wid_thumbnail->setMinimumWidth(300);
-        wid_thumbnail->setProperty("url", thumbnail_url);
-        grid->addWidget(wid_thumbnail, grid_row, 0);
-
-        //Button link
-        QPushButton *btn_name = new QPushButton(name);
-        btn_name->setFlat(true);
-        //btn_name->setCursor(Qt::PointingHandCursor);
-        QPalette pal1 = btn_name->palette();
-        pal1.setColor(QPalette::WindowText, QColor("blue"));
-        btn_name->setPalette(pal1);
-        btn_name->setStyleSheet(
-            //"QPushButton { text-align:left; } "
-            //"text-align:left "
-            "QPushButton { text-decoration:underline; } "
-            "QPushButton:hover { color:blue; } "
-        );
-        btn_name->setProperty("video_item", item);
-        //label->setWordWrap(true) doesn't work right
-        connect(btn_name, SIGNAL(clicked()), SLOT(openVideo()));
-        QHBoxLayout *hbox_title = new QHBoxLayout;
-        hbox_title->addWidget(btn_name);
-        hbox_title->addStretch(); //stretch right to move link to the left
-        grid->addLayout(hbox_title, grid_row, 1);
-
-        //Separator line
-        QFrame *line_below = new QFrame;
-        line_below->setFrameShape(QFrame::HLine);
-        grid->addWidget(line_below, ++grid_row, 0, 1, 2);
-
-        Item container;
-        container.thumb = wid_thumbnail;
-        m_items << container;
-
-        loadThumbnail(thumbnail_url, wid_thumbnail);
-    }
-    grid->setColumnStretch(0, 40);
-    grid->setColumnStretch(1, 60);
-
-    m_current_page = m_site->pageOffset();
+    //One row per video, no widgets are created
     m_page_size = m_site->pageSize();
-    QHBoxLayout *hbox_nav = new QHBoxLayout;
-    QPushButton *btn_prev = new QPushButton("<");
-    connect(btn_prev, SIGNAL(clicked()), SLOT(loadPreviousPage()));
-    hbox_nav->addWidget(btn_prev);
-    QLabel *lbl_page = new QLabel(QString("%1").arg(m_current_page + 1));
-    lbl_page->setAlignment(Qt::AlignHCenter);
-    hbox_nav->addWidget(lbl_page);
-    QPushButton *btn_next = new QPushButton(">");
-    connect(btn_next, SIGNAL(clicked()), SLOT(loadNextPage()));
-    hbox_nav->addWidget(btn_next);
-    vbox->addLayout(hbox_nav);
+    m_model->setItems(items, m_site->pageOffset(), m_page_size);
+    m_page_requests.clear();
+    m_at_end = items.size() < m_page_size;
+    m_list->scrollToTop();
 
 }
 
 void
 VideoListView::loadPage(int index)
 {
-    m_site->loadVideos(index);
+    //Failed request is tried again after a while
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (m_page_requests.contains(index) && now - m_page_requests[index] < 30000) return;
+    m_page_requests[index] = now;
+    m_site->loadVideoPage(index);
 }
 
 void
-VideoListView::loadPreviousPage()
+VideoListView::addVideoPage(int index, const QVariantList &items)
 {
-    int page_index = m_current_page;
-    if (page_index <= 0) return;
-    loadPage(page_index - 1);
+    bool requested = m_page_requests.contains(index);
+    m_page_requests.remove(index);
+    if (!requested) return; //first page, see SiteView
+
+    //Short page is the last one
+    if (index >= m_model->nextPage() - 1 && items.size() < m_page_size)
+        m_at_end = true;
+    m_model->setPage(index, items);
+    m_tmr_visible->start();
 }
 
 void
-VideoListView::loadNextPage()
+VideoListView::updateVisibleRows()
 {
-    int page_index = m_current_page;
-    loadPage(page_index + 1);
+    int first, last;
+    if (!VideoListModel::visibleRows(m_list, first, last)) return;
+    int count = m_model->rowCount();
+    int margin = last - first + 1;
+
+    //Next page when less than a screen is left below
+    if (!m_at_end && last + margin >= count)
+        loadPage(m_model->nextPage());
+
+    //Visible pages that have been evicted are loaded again
+    int first_page = m_model->pageOfRow(first);
+    int last_page = m_model->pageOfRow(last);
+    for (int page = first_page; page <= last_page; page++)
+        if (!m_model->isPageLoaded(page)) loadPage(page);
+
+    //Keep a window of pages around the viewport, drop the rest
+    int window = ProfileSettings::profile()->setDefaultVariant("video_list_page_window", 2).toInt();
+    m_model->evictPages(first_page - window, last_page + window);
+
+    //Thumbnails for the visible rows plus one screen above and below
+    m_model->fetchThumbnails(first - margin, last + margin);
 }
 
 void
-VideoListView::loadThumbnail(const QString &url, ImageWidget *thumb)
+VideoListView::resizeEvent(QResizeEvent *event)
 {
-    if (url.isEmpty()) return;
-    qDebug() << "site view - fetching thumbnail:" << url;
-    //TODO debug() << ... LogLogger
-
-    //Download thumbnail image and (callback) display it in ImageWidget
-    //auto ctx = _site->download(url);
-    m_storage->downloadFileToByteArray(url, [this, thumb](const QByteArray &b)
-    {
-        thumb->setPixmap(b);
-    });
-
+    QFrame::resizeEvent(event);
+    m_tmr_visible->start();
 }
 
 void
@@ -337,11 +290,10 @@ VideoListView::openVideo(const QVariantMap &item)
 }
 
 void
-VideoListView::openVideo()
+VideoListView::openVideo(const QModelIndex &index)
 {
-    QObject *obj = QObject::sender();
-    if (!obj) return;
-    QVariantMap item = obj->property("video_item").toMap();
+    QVariantMap item = m_model->item(index.row());
+    if (item.isEmpty()) return;
 
     //Video open signal - open by url
     openVideo(item);
@@ -0,0 +1,204 @@
+#include "sourceranker.hpp"
+
+//Probe size, enough to measure throughput, small enough to be cheap
+static const qint64 PROBE_BYTES = 256 * 1024;
+
+//Data the player buffers before it starts (roughly, at network-caching=1000)
+static const qint64 STARTUP_BYTES = 2 * 1024 * 1024;
+
+SourceRanker::SourceRanker(QObject *parent)
+            : QObject(parent),
+              m_network(new QNetworkAccessManager(this)),
+              m_good_enough(0),
+              m_ready_sent(false),
+              m_tmr_timeout(new QTimer(this))
+{
+    m_tmr_timeout->setSingleShot(true);
+    connect(m_tmr_timeout, SIGNAL(timeout()), SLOT(finishRanking()));
+}
+
+void
+SourceRanker::rank(const QList<QVariantMap> &items, int timeout, qint64 good_enough)
+{
+    m_items = items;
+    m_good_enough = good_enough;
+    m_ready_sent = false;
+
+    //Probe all remote sources at once, known ones are not probed again
+    foreach (const QVariantMap &item, items)
+    {
+        QUrl url = item.value("url").toUrl();
+        if (url.scheme() != "http" && url.scheme() != "https") continue;
+        if (m_probes.contains(url)) continue;
+        bool adaptive = item.value("hls").toBool() || url.path().endsWith(".m3u8");
+        startProbe(url, adaptive);
+    }
+
+    if (isProbing())
+        m_tmr_timeout->start(timeout);
+    else
+        QTimer::singleShot(0, this, SLOT(finishRanking()));
+}
+
+QList<QUrl>
+SourceRanker::order() const
+{
+    return m_order;
+}
+
+void
+SourceRanker::abort()
+{
+    m_tmr_timeout->stop();
+    m_items.clear();
+    m_ready_sent = true;
+    foreach (const QUrl &url, m_probes.keys())
+    {
+        if (m_probes[url].done) continue;
+        QNetworkReply *reply = m_probes.take(url).reply;
+        if (reply && reply->isRunning())
+            QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+    }
+}
+
+qint64
+SourceRanker::expectedStart(const QUrl &url) const
+{
+    if (url.isLocalFile()) return 0;
+    if (!m_probes.contains(url)) return -1;
+    const Probe &probe = m_probes[url];
+    if (probe.failed || probe.ttfb < 0) return -1;
+
+    //HLS: master playlist, media playlist and first segment, one round trip each
+    if (probe.adaptive) return probe.ttfb * 3;
+
+    //Throughput from the part of the response after the first byte
+    qint64 transfer_time = qMax((qint64)1, probe.elapsed - probe.ttfb);
+    if (probe.bytes < 16 * 1024) return probe.ttfb; //too little data to tell
+    return probe.ttfb + STARTUP_BYTES * transfer_time / probe.bytes;
+}
+
+void
+SourceRanker::finishRanking()
+{
+    m_tmr_timeout->stop();
+    if (m_items.isEmpty()) return; //aborted
+
+    //Slow probes count with what they got so far
+    foreach (const QUrl &url, m_probes.keys())
+    {
+        if (!m_probes[url].done)
+            finishProbe(url, m_probes[url].ttfb < 0);
+    }
+
+    //Sort key: local first, then by expected start (coarse, so site order
+    //decides between similar sources), unreachable sources last
+    QList<QPair<qint64, int>> keys;
+    for (int i = 0; i < m_items.size(); i++)
+    {
+        QUrl url = m_items[i].value("url").toUrl();
+        qint64 key;
+        if (url.isLocalFile())
+            key = -1;
+        else if (!m_probes.contains(url))
+            key = 1000000; //not probed (unknown scheme), after measured ones
+        else if (expectedStart(url) < 0)
+            key = 2000000;
+        else
+            key = expectedStart(url) / 250;
+        keys << qMakePair(key, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    m_order.clear();
+    for (int i = 0; i < keys.size(); i++)
+    {
+        QUrl url = m_items[keys[i].second].value("url").toUrl();
+        m_order << url;
+        qDebug() << "source ranker -" << i << url << "expected start" << expectedStart(url) << "ms";
+    }
+    emit ranked(m_order);
+}
+
+void
+SourceRanker::startProbe(const QUrl &url, bool adaptive)
+{
+    Probe probe;
+    probe.ttfb = -1;
+    probe.elapsed = -1;
+    probe.bytes = 0;
+    probe.adaptive = adaptive;
+    probe.done = false;
+    probe.failed = false;
+
+    QNetworkRequest req(url);
+    req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    req.setRawHeader("Range", QString("bytes=0-%1").arg(PROBE_BYTES - 1).toLatin1());
+    QNetworkReply *reply = m_network->get(req);
+    probe.reply = reply;
+    probe.timer.start();
+    m_probes[url] = probe;
+
+    connect(reply, &QNetworkReply::readyRead, this, [this, url, reply]()
+    {
+        if (!m_probes.contains(url) || m_probes[url].reply != reply) return;
+        Probe &probe = m_probes[url];
+        if (probe.ttfb < 0)
+            probe.ttfb = probe.timer.elapsed();
+        probe.bytes += reply->readAll().size();
+
+        //Server ignoring the range would send the whole file
+        if (probe.bytes >= PROBE_BYTES)
+        {
+            finishProbe(url, false);
+            checkReady(url);
+            if (!isProbing()) finishRanking();
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, url, reply]()
+    {
+        reply->deleteLater();
+        if (!m_probes.contains(url) || m_probes[url].reply != reply) return;
+        if (reply->error() != QNetworkReply::NoError)
+            qDebug() << "source ranker - probe failed" << url << reply->errorString();
+        finishProbe(url, reply->error() != QNetworkReply::NoError);
+        checkReady(url);
+        if (!isProbing()) finishRanking();
+    });
+}
+
+void
+SourceRanker::finishProbe(const QUrl &url, bool failed)
+{
+    Probe &probe = m_probes[url];
+    if (probe.done) return;
+    probe.done = true;
+    probe.failed = failed;
+    probe.elapsed = probe.timer.elapsed();
+
+    //Aborting emits finished, which is ignored now
+    QNetworkReply *reply = probe.reply;
+    probe.reply = 0;
+    if (reply && reply->isRunning())
+        QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+}
+
+bool
+SourceRanker::isProbing() const
+{
+    foreach (const Probe &probe, m_probes)
+        if (!probe.done) return true;
+    return false;
+}
+
+void
+SourceRanker::checkReady(const QUrl &url)
+{
+    if (m_good_enough <= 0 || m_ready_sent || !isProbing()) return;
+    qint64 start = expectedStart(url);
+    if (start < 0 || start > m_good_enough) return;
+
+    m_ready_sent = true;
+    qDebug() << "source ranker - good enough" << url << "expected start" << start << "ms";
+    emit sourceReady(url);
+}
@@ -0,0 +1,85 @@
+#include "startupprofiler.hpp"
+
+StartupProfiler*
+StartupProfiler::globalInstance()
+{
+    static QPointer<StartupProfiler> global_instance;
+    if (!global_instance)
+        global_instance = new StartupProfiler(qApp);
+    return global_instance;
+}
+
+StartupProfiler::StartupProfiler(QObject *parent)
+               : QObject(parent),
+                 m_enabled(false),
+                 m_last(0)
+{
+    m_timer.start();
+}
+
+void
+StartupProfiler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool
+StartupProfiler::isEnabled() const
+{
+    return m_enabled;
+}
+
+void
+StartupProfiler::start(const QElapsedTimer &timer)
+{
+    m_timer = timer;
+    m_last = 0;
+    m_phases.clear();
+}
+
+void
+StartupProfiler::mark(const QString &phase)
+{
+    if (!m_enabled) return;
+    qint64 now = m_timer.elapsed();
+    m_phases << qMakePair(phase, now - m_last);
+    m_last = now;
+}
+
+void
+StartupProfiler::watchFirstFrame(QWidget *window)
+{
+    if (!m_enabled) return;
+    window->installEventFilter(this);
+}
+
+void
+StartupProfiler::print()
+{
+    if (!m_enabled) return;
+    fprintf(stderr, "startup profile (ms):\n");
+    qint64 total = 0;
+    for (int i = 0; i < m_phases.size(); i++)
+    {
+        total += m_phases[i].second;
+        fprintf(stderr, "%8lld %8lld  %s\n", m_phases[i].second, total,
+            m_phases[i].first.toLocal8Bit().constData());
+    }
+    fflush(stderr);
+}
+
+bool
+StartupProfiler::eventFilter(QObject *obj, QEvent *event)
+{
+    //First paint of the window, the frame is out when the event loop is back
+    if (event->type() == QEvent::Paint)
+    {
+        obj->removeEventFilter(this);
+        QTimer::singleShot(0, this, [this]()
+        {
+            mark("first frame");
+            print();
+        });
+    }
+    return QObject::eventFilter(obj, event);
+}
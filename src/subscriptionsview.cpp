@@ -8,12 +8,45 @@ SubscriptionsView::SubscriptionsView(QWidget *parent, Qt::WindowFlags flags)
     QVBoxLayout *vbox = new QVBoxLayout;
     setLayout(vbox);
 
+    //Feed above the subscription list
+    QWidget *feed_box = new QWidget;
+    QVBoxLayout *vbox_feed = new QVBoxLayout;
+    vbox_feed->setContentsMargins(0, 0, 0, 0);
+    feed_box->setLayout(vbox_feed);
+    m_lbl_feed = new QLabel;
+    m_lbl_feed->setStyleSheet("QLabel { font-size:14pt; font-weight:bold; }");
+    vbox_feed->addWidget(m_lbl_feed);
+    m_feed_model = new VideoListModel(this);
+    m_feed_list = m_feed_model->createListView();
+    connect(m_feed_list, SIGNAL(clicked(const QModelIndex&)), SLOT(openFeedItem(const QModelIndex&)));
+    vbox_feed->addWidget(m_feed_list);
+
+    //Thumbnails are loaded when scrolling stops
+    m_tmr_visible = new QTimer(this);
+    m_tmr_visible->setSingleShot(true);
+    m_tmr_visible->setInterval(100);
+    connect(m_tmr_visible, SIGNAL(timeout()), SLOT(updateVisibleRows()));
+    connect(m_feed_list->verticalScrollBar(), SIGNAL(valueChanged(int)), m_tmr_visible, SLOT(start()));
+    connect(m_feed_model, SIGNAL(modelReset()), m_tmr_visible, SLOT(start()));
+
     m_scr_main = new QScrollArea;
     m_scr_main->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    vbox->addWidget(m_scr_main);
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical);
+    splitter->addWidget(feed_box);
+    splitter->addWidget(m_scr_main);
+    splitter->setStretchFactor(0, 3);
+    splitter->setStretchFactor(1, 1);
+    vbox->addWidget(splitter);
 
     loadSubscriptionList();
 
+    //Stored feed is shown right away, refreshed in the background
+    FeedEngine *feed = FeedEngine::globalInstance();
+    connect(feed, SIGNAL(feedChanged()), SLOT(updateFeed()));
+    connect(feed, SIGNAL(refreshFinished()), SLOT(updateFeed()));
+    updateFeed();
+
 }
 
 SubscriptionsView::~SubscriptionsView()
@@ -40,6 +73,7 @@ SubscriptionsView::keyPressEvent(QKeyEvent *event)
     if (event->key() == Qt::Key_F5)
     {
         loadSubscriptionList();
+        FeedEngine::globalInstance()->refresh();
         return;
     }
 
@@ -200,6 +234,8 @@ SubscriptionsView::checkAdd()
         sub_info["channel"] = info;
         subscription_list << sub_info;
         m_settings->setVariant("subscription_list", subscription_list);
+        //New channel in the feed
+        FeedEngine::globalInstance()->refresh();
         //Show success message
         QMessageBox::information(this, tr("Subscription"),
             tr("Channel added to list!"));
@@ -222,9 +258,10 @@ SubscriptionsView::removeItem(int index)
         tr("Do you want to unsubscribe from this channel?\n%1").arg(name)) != QMessageBox::Yes)
         return;
 
-    //Remove item from list
+    //Remove item from list (and its videos from the feed)
     m_sub_items.removeAt(index);
     save();
+    FeedEngine::globalInstance()->refresh();
 
     //Reload subscription list view
     QTimer::singleShot(0, this, SLOT(loadSubscriptionList()));
@@ -249,3 +286,42 @@ SubscriptionsView::renameItem(int index)
     QTimer::singleShot(0, this, SLOT(loadSubscriptionList()));
 }
 
+
+void
+SubscriptionsView::updateFeed()
+{
+    FeedEngine *feed = FeedEngine::globalInstance();
+    QVariantList items = feed->feed();
+    QString title = tr("Newest videos");
+    if (feed->isRefreshing())
+        title += " " + tr("(updating...)");
+    m_lbl_feed->setText(title);
+
+    //Keep the scroll position if the feed is refreshed while reading it
+    int scroll_pos = m_feed_list->verticalScrollBar()->value();
+    m_feed_model->setItems(items, 0, qMax(1, items.size()));
+    QTimer::singleShot(0, m_feed_list, [this, scroll_pos]()
+    {
+        m_feed_list->verticalScrollBar()->setValue(scroll_pos);
+    });
+}
+
+void
+SubscriptionsView::updateVisibleRows()
+{
+    int first, last;
+    if (!VideoListModel::visibleRows(m_feed_list, first, last)) return;
+    int margin = last - first + 1;
+    m_feed_model->fetchThumbnails(first - margin, last + margin);
+}
+
+void
+SubscriptionsView::openFeedItem(const QModelIndex &index)
+{
+    QVariantMap item = m_feed_model->item(index.row());
+    if (item.isEmpty()) return;
+    //Feed items come from several sites, the address is the resolved video url
+    QString address = item.value("address").toString();
+    if (address.isEmpty()) address = item.value("url").toString();
+    emit openVideoSignal(address, item);
+}
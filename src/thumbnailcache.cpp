@@ -0,0 +1,305 @@
+#include "thumbnailcache.hpp"
+
+//Thumbnails are shown small, larger images are scaled down when decoded
+static const int MAX_IMAGE_WIDTH = 640;
+
+//Broken urls (not found, not an image) are retried after that long (ms)
+static const qint64 FAILED_RETRY_DELAY = 15 * 60 * 1000;
+
+//Disk cache is pruned again after that many new files
+static const int PRUNE_INTERVAL = 200;
+
+ThumbnailCache*
+ThumbnailCache::globalInstance()
+{
+    static QPointer<ThumbnailCache> global_instance;
+    if (!global_instance)
+        global_instance = new ThumbnailCache(qApp);
+    return global_instance;
+}
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+              : QObject(parent),
+                m_stored_count(0),
+                m_network(new QNetworkAccessManager(this))
+{
+    ProfileSettings *settings = ProfileSettings::profile();
+    m_cache_dir = settings->configDirectory(true).absoluteFilePath("thumbnails");
+    QDir().mkpath(m_cache_dir);
+
+    //Memory cost is counted in KB (QCache cost is an int)
+    int memory_mb = settings->setDefaultVariant("thumbnail_memory_cache_mb", 64).toInt();
+    m_images.setMaxCost(memory_mb * 1024);
+
+    //Thumbnails hardly ever change, servers often don't send an expiry time
+    int max_age_days = settings->setDefaultVariant("thumbnail_max_age_days", 7).toInt();
+    m_max_age = (qint64)max_age_days * 24 * 3600 * 1000;
+    int disk_mb = settings->setDefaultVariant("thumbnail_disk_cache_mb", 256).toInt();
+    m_max_disk_size = (qint64)disk_mb * 1024 * 1024;
+
+    m_pool.setMaxThreadCount(2);
+    pruneDisk();
+}
+
+void
+ThumbnailCache::load(const QUrl &url, QObject *receiver, Callback cb, FailureCallback failed_cb)
+{
+    if (url.isEmpty() || !receiver) return;
+    QString key = url.toString();
+
+    //Decoded image in memory, no i/o at all
+    QImage *image = m_images.object(key);
+    if (image)
+    {
+        cb(*image);
+        return;
+    }
+
+    //Failed recently, don't hammer the server
+    if (m_failed.contains(key))
+    {
+        if (m_failed[key] > QDateTime::currentMSecsSinceEpoch())
+        {
+            if (failed_cb) failed_cb();
+            return;
+        }
+        m_failed.remove(key);
+    }
+
+    //Same image is already being loaded
+    Request request;
+    request.receiver = receiver;
+    request.cb = cb;
+    request.failed_cb = failed_cb;
+    bool running = m_pending.contains(key);
+    m_pending[key] << request;
+    if (running) return;
+
+    //Fresh copy on disk, otherwise download (revalidate stale copy)
+    Entry entry;
+    bool has_cached = readEntry(url, entry);
+    if (has_cached && entry.expires > QDateTime::currentMSecsSinceEpoch())
+        decode(url, QByteArray(), false);
+    else
+        fetch(url, entry, has_cached);
+}
+
+QImage
+ThumbnailCache::cachedImage(const QUrl &url)
+{
+    QImage *image = m_images.object(url.toString());
+    return image ? *image : QImage();
+}
+
+QImage
+ThumbnailCache::decodeImage(const QByteArray &bytes)
+{
+    //Called in the pool
+    QByteArray bytes_copy(bytes);
+    QBuffer buffer(&bytes_copy);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+    QSize size = reader.size();
+    if (size.width() > MAX_IMAGE_WIDTH)
+        reader.setScaledSize(size.scaled(MAX_IMAGE_WIDTH, size.height(), Qt::KeepAspectRatio));
+    QImage image = reader.read();
+    if (image.isNull())
+        qInfo() << "thumbnail cache - failed to decode image" << bytes.size() << reader.errorString();
+    return image;
+}
+
+QString
+ThumbnailCache::filePath(const QUrl &url, const QString &suffix) const
+{
+    QString key = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex();
+    return QDir(m_cache_dir).absoluteFilePath(key + suffix);
+}
+
+bool
+ThumbnailCache::readEntry(const QUrl &url, Entry &entry)
+{
+    QFile file(filePath(url, ".json"));
+    if (!file.open(QIODevice::ReadOnly) || !QFile::exists(filePath(url, ".img")))
+        return false;
+    QVariantMap map = QJsonDocument::fromJson(file.readAll()).toVariant().toMap();
+    if (map.value("url").toString() != url.toString()) return false;
+    entry.etag = map.value("etag").toString();
+    entry.last_modified = map.value("last_modified").toString();
+    entry.expires = map.value("expires").toLongLong();
+    return true;
+}
+
+void
+ThumbnailCache::writeEntry(const QUrl &url, const Entry &entry)
+{
+    QVariantMap map;
+    map["url"] = url.toString();
+    map["etag"] = entry.etag;
+    map["last_modified"] = entry.last_modified;
+    map["expires"] = entry.expires;
+    QFile file(filePath(url, ".json"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "thumbnail cache - cannot write" << file.fileName();
+        return;
+    }
+    file.write(QJsonDocument::fromVariant(map).toJson(QJsonDocument::Compact));
+}
+
+void
+ThumbnailCache::fetch(const QUrl &url, const Entry &cached, bool has_cached)
+{
+    QNetworkRequest req(url);
+    req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    if (has_cached && !cached.etag.isEmpty())
+        req.setRawHeader("If-None-Match", cached.etag.toLatin1());
+    if (has_cached && !cached.last_modified.isEmpty())
+        req.setRawHeader("If-Modified-Since", cached.last_modified.toLatin1());
+    QNetworkReply *reply = m_network->get(req);
+
+    connect(reply, &QNetworkReply::finished, this, [this, url, reply, cached, has_cached]()
+    {
+        reply->deleteLater();
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() != QNetworkReply::NoError && status != 304)
+        {
+            //Stale image is better than none
+            qDebug() << "thumbnail cache - download failed" << url << reply->errorString();
+            if (has_cached)
+                decode(url, QByteArray(), false);
+            else
+                deliver(url, QImage());
+            return;
+        }
+
+        //Keep validators for the next revalidation
+        Entry entry = cached;
+        if (reply->hasRawHeader("ETag"))
+            entry.etag = QString::fromLatin1(reply->rawHeader("ETag"));
+        if (reply->hasRawHeader("Last-Modified"))
+            entry.last_modified = QString::fromLatin1(reply->rawHeader("Last-Modified"));
+        //Server's max-age if it sends one, no-cache means revalidate every time
+        QString cache_control = QString::fromLatin1(reply->rawHeader("Cache-Control")).toLower();
+        bool no_store = cache_control.contains("no-store");
+        qint64 max_age = m_max_age;
+        QRegExp rx_max_age("max-age=(\\d+)");
+        if (cache_control.contains("no-cache"))
+            max_age = 0;
+        else if (rx_max_age.indexIn(cache_control) != -1)
+            max_age = rx_max_age.cap(1).toLongLong() * 1000;
+        entry.expires = QDateTime::currentMSecsSinceEpoch() + max_age;
+
+        if (status == 304 && has_cached)
+        {
+            writeEntry(url, entry);
+            decode(url, QByteArray(), false);
+            return;
+        }
+        QByteArray data = reply->readAll();
+        if (data.isEmpty())
+        {
+            deliver(url, QImage());
+            return;
+        }
+        if (no_store)
+        {
+            //Must not be kept, not even the old copy
+            QFile::remove(filePath(url, ".json"));
+            QFile::remove(filePath(url, ".img"));
+            decode(url, data, false);
+            return;
+        }
+        writeEntry(url, entry);
+        decode(url, data, true);
+        if (++m_stored_count >= PRUNE_INTERVAL) pruneDisk();
+    });
+}
+
+void
+ThumbnailCache::decode(const QUrl &url, const QByteArray &bytes, bool store)
+{
+    QString path = filePath(url, ".img");
+    QtConcurrent::run(&m_pool, [this, url, bytes, store, path]()
+    {
+        QByteArray data = bytes;
+        QFile file(path);
+        if (store)
+        {
+            if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                file.write(data);
+        }
+        else if (data.isEmpty() && file.open(QIODevice::ReadOnly))
+        {
+            data = file.readAll();
+        }
+        QImage image = decodeImage(data);
+        QMetaObject::invokeMethod(this, [this, url, image]()
+        {
+            deliver(url, image);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void
+ThumbnailCache::deliver(const QUrl &url, const QImage &image)
+{
+    QString key = url.toString();
+    QList<Request> requests = m_pending.take(key);
+    if (image.isNull())
+    {
+        m_failed[key] = QDateTime::currentMSecsSinceEpoch() + FAILED_RETRY_DELAY;
+        foreach (const Request &request, requests)
+        {
+            if (request.receiver && request.failed_cb) request.failed_cb();
+        }
+        return;
+    }
+
+    //Cost in KB, at least 1
+    m_images.insert(key, new QImage(image), image.sizeInBytes() / 1024 + 1);
+    foreach (const Request &request, requests)
+    {
+        if (request.receiver) request.cb(image);
+    }
+}
+
+void
+ThumbnailCache::pruneDisk()
+{
+    //Files that haven't been (re)validated for a long time are removed,
+    //then the least recently validated ones above the size limit
+    m_stored_count = 0;
+    QString cache_dir = m_cache_dir;
+    qint64 max_age = qMax(m_max_age * 4, (qint64)30 * 24 * 3600 * 1000);
+    qint64 max_size = m_max_disk_size;
+    QtConcurrent::run(&m_pool, [cache_dir, max_age, max_size]()
+    {
+        QDateTime limit = QDateTime::currentDateTime().addMSecs(-max_age);
+        QDir dir(cache_dir);
+        qint64 total = 0;
+        QList<QFileInfo> kept;
+        foreach (const QFileInfo &fi, dir.entryInfoList(QStringList() << "*.json", QDir::Files, QDir::Time))
+        {
+            QFileInfo img_fi(dir.absoluteFilePath(fi.completeBaseName() + ".img"));
+            if (fi.lastModified() >= limit)
+            {
+                total += fi.size() + img_fi.size();
+                kept << fi;
+                continue;
+            }
+            QFile::remove(fi.filePath());
+            QFile::remove(img_fi.filePath());
+        }
+
+        //Newest first, remove from the end
+        while (max_size > 0 && total > max_size && !kept.isEmpty())
+        {
+            QFileInfo fi = kept.takeLast();
+            QFileInfo img_fi(dir.absoluteFilePath(fi.completeBaseName() + ".img"));
+            total -= fi.size() + img_fi.size();
+            QFile::remove(fi.filePath());
+            QFile::remove(img_fi.filePath());
+        }
+    });
+}
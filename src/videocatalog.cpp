@@ -0,0 +1,140 @@
+#include "videocatalog.hpp"
+
+//Weights of a token found in the title, channel name, description
+static const int TITLE_WEIGHT = 4;
+static const int CHANNEL_WEIGHT = 2;
+static const int DESCRIPTION_WEIGHT = 1;
+static const int MAX_WEIGHT = 100;
+
+//Long descriptions (link lists, credits) would bloat the index
+static const int MAX_DESCRIPTION_LENGTH = 2000;
+
+VideoCatalog*
+VideoCatalog::globalInstance()
+{
+    static QPointer<VideoCatalog> global_instance;
+    if (!global_instance)
+        global_instance = new VideoCatalog(qApp);
+    return global_instance;
+}
+
+QStringList
+VideoCatalog::tokenize(const QString &text)
+{
+    //Decomposed form, accents are separate marks which are dropped
+    QString normalized = text.normalized(QString::NormalizationForm_KD).toLower();
+    QStringList tokens;
+    QString token;
+    foreach (const QChar &c, normalized)
+    {
+        if (c.category() == QChar::Mark_NonSpacing) continue;
+        if (c.isLetterOrNumber())
+        {
+            token += c;
+            continue;
+        }
+        if (token.size() >= 2) tokens << token.left(40);
+        token.clear();
+    }
+    if (token.size() >= 2) tokens << token.left(40);
+    return tokens;
+}
+
+qint64
+VideoCatalog::publishedTime(const QVariantMap &item)
+{
+    QString published = item.value("published").toString();
+    if (published.isEmpty()) return 0;
+
+    //Unix time in seconds (Odysee, VK) or ms (already converted)
+    bool ok = false;
+    qint64 number = published.toLongLong(&ok);
+    if (ok) return number < 100000000000LL ? number * 1000 : number;
+
+    //ISO date (Peertube)
+    QDateTime date = QDateTime::fromString(published, Qt::ISODateWithMs);
+    if (!date.isValid()) date = QDateTime::fromString(published, Qt::ISODate);
+    return date.isValid() ? date.toMSecsSinceEpoch() : 0;
+}
+
+VideoCatalog::VideoCatalog(QObject *parent)
+            : QObject(parent)
+{
+    //One writer, batches are stored in order
+    m_pool.setMaxThreadCount(1);
+}
+
+void
+VideoCatalog::addItems(const QUrl &site_url, const QString &channel, const QVariantList &items)
+{
+    if (items.isEmpty()) return;
+    if (!ProfileSettings::profile()->setDefaultVariant("video_catalog", true).toBool()) return;
+
+    QtConcurrent::run(&m_pool, [this, site_url, channel, items]()
+    {
+        QList<QVariantMap> videos = prepareVideos(site_url, channel, items);
+        if (!LibraryIndex::globalInstance()->addVideos(videos)) return;
+        QMetaObject::invokeMethod(this, "updated", Qt::QueuedConnection);
+    });
+}
+
+QVariantList
+VideoCatalog::search(const QString &query, int limit)
+{
+    QStringList terms = tokenize(query);
+    terms.removeDuplicates();
+    if (terms.isEmpty()) return QVariantList();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVariantList results = LibraryIndex::globalInstance()->searchVideos(terms, limit);
+    qDebug() << "video search" << terms << results.size() << timer.elapsed() << "ms";
+    return results;
+}
+
+QList<QVariantMap>
+VideoCatalog::prepareVideos(const QUrl &site_url, const QString &channel, const QVariantList &items)
+{
+    //Called in the pool
+    QList<QVariantMap> videos;
+    foreach (const QVariant &var, items)
+    {
+        QVariantMap item = var.toMap();
+        QString video_url = item.value("url").toString();
+        if (video_url.isEmpty()) continue;
+
+        //Items of all sites in one list, relative addresses are resolved
+        QVariantMap video;
+        video["address"] = site_url.resolved(QUrl(video_url)).toString();
+        QString thumbnail_url = item.value("thumbnail").toString();
+        if (thumbnail_url.startsWith("/"))
+            thumbnail_url = site_url.resolved(QUrl(thumbnail_url)).toString();
+        item["thumbnail"] = thumbnail_url;
+        item["_site_url"] = site_url.url();
+        QString title = item.value("title").toString();
+        QString description = item.value("description").toString().left(MAX_DESCRIPTION_LENGTH);
+        video["title"] = title;
+        video["description"] = description;
+        video["thumbnail"] = thumbnail_url;
+        video["channel"] = channel;
+        video["site"] = site_url.host();
+        video["published"] = publishedTime(item);
+        video["item"] = item;
+
+        //Weight of a token is the sum of its occurrences
+        QMap<QString, int> weights;
+        foreach (const QString &token, tokenize(title))
+            weights[token] += TITLE_WEIGHT;
+        foreach (const QString &token, tokenize(channel))
+            weights[token] += CHANNEL_WEIGHT;
+        foreach (const QString &token, tokenize(description))
+            weights[token] += DESCRIPTION_WEIGHT;
+        QVariantMap tokens;
+        for (auto it = weights.constBegin(); it != weights.constEnd(); ++it)
+            tokens[it.key()] = qMin(it.value(), MAX_WEIGHT);
+        video["tokens"] = tokens;
+
+        videos << video;
+    }
+    return videos;
+}
@@ -0,0 +1,278 @@
+#include "videolistmodel.hpp"
+
+VideoListModel::VideoListModel(QObject *parent)
+              : QAbstractListModel(parent),
+                m_first_page(0),
+                m_page_size(20)
+{
+}
+
+void
+VideoListModel::setSiteUrl(const QUrl &url)
+{
+    m_site_url = url;
+}
+
+void
+VideoListModel::setItems(const QVariantList &items, int page, int page_size)
+{
+    beginResetModel();
+    m_items.clear();
+    m_loaded_pages.clear();
+    m_first_page = page;
+    m_page_size = qMax(1, page_size);
+    foreach (const QVariant &var, items)
+        m_items << prepareItem(var.toMap());
+    m_loaded_pages << page;
+    endResetModel();
+}
+
+bool
+VideoListModel::setPage(int page, const QVariantList &items)
+{
+    int row = (page - m_first_page) * m_page_size;
+    if (page < m_first_page || row > m_items.size()) return false;
+    m_loaded_pages << page;
+    if (items.isEmpty()) return true;
+
+    //Rows that exist already (page reloaded after eviction)
+    int i = 0;
+    for (; i < items.size() && row + i < m_items.size(); i++)
+        m_items[row + i] = prepareItem(items[i].toMap());
+    if (i > 0)
+        emit dataChanged(index(row), index(row + i - 1));
+
+    //New rows (next page)
+    if (i < items.size())
+    {
+        beginInsertRows(QModelIndex(), row + i, row + items.size() - 1);
+        for (; i < items.size(); i++)
+            m_items << prepareItem(items[i].toMap());
+        endInsertRows();
+    }
+    return true;
+}
+
+void
+VideoListModel::evictPages(int first_keep, int last_keep)
+{
+    foreach (int page, m_loaded_pages.values())
+    {
+        if (page >= first_keep && page <= last_keep) continue;
+        m_loaded_pages.remove(page);
+        int row = (page - m_first_page) * m_page_size;
+        int last = qMin(row + m_page_size, m_items.size()) - 1;
+        for (int i = row; i <= last; i++)
+            m_items[i] = QVariant();
+        if (last >= row)
+            emit dataChanged(index(row), index(last));
+    }
+}
+
+bool
+VideoListModel::isPageLoaded(int page) const
+{
+    return m_loaded_pages.contains(page);
+}
+
+int
+VideoListModel::pageOfRow(int row) const
+{
+    return m_first_page + row / m_page_size;
+}
+
+int
+VideoListModel::firstPage() const
+{
+    return m_first_page;
+}
+
+int
+VideoListModel::nextPage() const
+{
+    return m_first_page + (m_items.size() + m_page_size - 1) / m_page_size;
+}
+
+QVariantMap
+VideoListModel::item(int row) const
+{
+    if (row < 0 || row >= m_items.size()) return QVariantMap();
+    return m_items[row].toMap();
+}
+
+int
+VideoListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return m_items.size();
+}
+
+QVariant
+VideoListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size()) return QVariant();
+    QVariantMap item = m_items[index.row()].toMap();
+
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        return item.value("title");
+    case Qt::ToolTipRole:
+        return item.value("description");
+    case Qt::DecorationRole:
+    {
+        //Only what's in memory, see fetchThumbnails()
+        QImage image = ThumbnailCache::globalInstance()->cachedImage(item.value("thumbnail").toUrl());
+        if (image.isNull()) return QVariant();
+        return image;
+    }
+    case ItemRole:
+        return item;
+    case ThumbnailUrlRole:
+        return item.value("thumbnail");
+    }
+    return QVariant();
+}
+
+void
+VideoListModel::fetchThumbnails(int first, int last)
+{
+    ThumbnailCache *cache = ThumbnailCache::globalInstance();
+    first = qMax(first, 0);
+    last = qMin(last, m_items.size() - 1);
+    for (int row = first; row <= last; row++)
+    {
+        QUrl url = m_items[row].toMap().value("thumbnail").toUrl();
+        QString key = url.toString();
+        if (url.isEmpty() || m_fetching.contains(key)) continue;
+        if (!cache->cachedImage(url).isNull()) continue;
+
+        //Row may have moved when it arrives (list reset), look it up by url
+        m_fetching << key;
+        cache->load(url, this, [this, key](const QImage &image)
+        {
+            m_fetching.remove(key);
+            for (int i = 0; i < m_items.size(); i++)
+            {
+                if (m_items[i].toMap().value("thumbnail").toUrl().toString() != key) continue;
+                QModelIndex idx = index(i);
+                emit dataChanged(idx, idx, QVector<int>() << Qt::DecorationRole);
+            }
+        }, [this, key]()
+        {
+            //Row keeps its placeholder, the cache doesn't retry it for a while
+            m_fetching.remove(key);
+        });
+    }
+}
+
+QListView*
+VideoListModel::createListView(QWidget *parent)
+{
+    QListView *list = new QListView(parent);
+    list->setModel(this);
+    list->setItemDelegate(new VideoListDelegate(list));
+    list->setUniformItemSizes(true);
+    list->setResizeMode(QListView::Adjust);
+    list->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    list->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    list->setSelectionMode(QAbstractItemView::NoSelection);
+    list->setMouseTracking(true);
+    list->setCursor(Qt::PointingHandCursor);
+    return list;
+}
+
+bool
+VideoListModel::visibleRows(QListView *list, int &first, int &last)
+{
+    int count = list->model() ? list->model()->rowCount() : 0;
+    if (!count) return false;
+    QRect viewport = list->viewport()->rect();
+    QModelIndex top = list->indexAt(viewport.topLeft());
+    if (!top.isValid()) return false; //not laid out yet
+    QModelIndex bottom = list->indexAt(QPoint(viewport.left(), viewport.bottom()));
+    first = top.row();
+    last = bottom.isValid() ? bottom.row() : count - 1;
+    return true;
+}
+
+QVariantMap
+VideoListModel::prepareItem(const QVariantMap &item) const
+{
+    QVariantMap prepared = item;
+    QString video_url = item.value("url").toString();
+    if (video_url.startsWith("/") && m_site_url.isValid())
+        prepared["url"] = m_site_url.resolved(video_url).url();
+    QString thumbnail_url = item.value("thumbnail").toString();
+    if (thumbnail_url.startsWith("/") && m_site_url.isValid())
+        prepared["thumbnail"] = m_site_url.resolved(thumbnail_url).url();
+    return prepared;
+}
+
+VideoListDelegate::VideoListDelegate(QObject *parent)
+                 : QStyledItemDelegate(parent)
+{
+}
+
+void
+VideoListDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    painter->save();
+    if (option.state & QStyle::State_MouseOver)
+        painter->fillRect(option.rect, option.palette.alternateBase());
+
+    //Thumbnail, gray box until it's loaded
+    QRect thumb_rect = thumbnailRect(option.rect);
+    painter->fillRect(thumb_rect, Qt::gray);
+    QImage image = index.data(Qt::DecorationRole).value<QImage>();
+    if (!image.isNull())
+    {
+        QSize size = image.size().scaled(thumb_rect.size(), Qt::KeepAspectRatio);
+        QString key = QString("videolist:%1:%2x%3").arg(index.data(VideoListModel::ThumbnailUrlRole).toString())
+            .arg(size.width()).arg(size.height());
+        QPixmap pixmap;
+        if (!QPixmapCache::find(key, &pixmap))
+        {
+            pixmap = QPixmap::fromImage(image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+            QPixmapCache::insert(key, pixmap);
+        }
+        QRect pix_rect(QPoint(), size);
+        pix_rect.moveCenter(thumb_rect.center());
+        painter->drawPixmap(pix_rect.topLeft(), pixmap);
+    }
+    painter->setPen(Qt::black);
+    painter->drawRect(thumb_rect.adjusted(0, 0, -1, -1));
+
+    //Title link
+    QRect text_rect = option.rect.adjusted(thumb_rect.right() + 12, 6, -6, -6);
+    QFont font = option.font;
+    font.setUnderline(true);
+    painter->setFont(font);
+    painter->setPen(QColor("blue"));
+    painter->drawText(text_rect, Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, index.data(Qt::DisplayRole).toString());
+
+    //Separator line
+    painter->setPen(option.palette.color(QPalette::Mid));
+    painter->drawLine(option.rect.bottomLeft(), option.rect.bottomRight());
+    painter->restore();
+}
+
+QSize
+VideoListDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    //All rows have the same height (uniform item sizes), 16:9 thumbnail
+    //Height depends on the width of the view (thumbnail column grows with it)
+    int width = option.rect.width();
+    const QAbstractItemView *view = qobject_cast<const QAbstractItemView*>(option.widget);
+    if (view) width = view->viewport()->width();
+    QRect row_rect(0, 0, width, 0);
+    return QSize(width, thumbnailRect(row_rect).height() + 13);
+}
+
+QRect
+VideoListDelegate::thumbnailRect(const QRect &row_rect)
+{
+    //Left column is 40% of the width (at least 300 px), as in the old grid layout
+    int width = qMax(row_rect.width() * 40 / 100, 300);
+    return QRect(row_rect.left() + 6, row_rect.top() + 6, width - 6, width * 9 / 16);
+}
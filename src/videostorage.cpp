@@ -1,15 +1,24 @@
 #include "videostorage.hpp"
 
 VideoStorage::VideoStorage(QObject *parent)
-            : QObject(parent)
+            : QObject(parent),
+              m_download_priority(DownloadManager::Normal)
 {
     m_settings = *ProfileSettings::profile();
 
+    //Players keep their partial file (shared pointer) as long as they need it
+    connect(this, SIGNAL(downloadFinished(const QString&)), SLOT(releasePartialFile(const QString&)));
+    connect(this, SIGNAL(downloadFailed(const QString&)), SLOT(releasePartialFile(const QString&)));
+
     if (downloadToolUpdates()) updateDownloadToolOnce();
 }
 
 VideoStorage::~VideoStorage()
 {
+    //Network replies are destroyed with this instance, free their slots
+    foreach (int job, m_download_jobs)
+        DownloadManager::globalInstance()->finishJob(job, true);
+
     //Clean up temp files - no action, it happens automatically
     //this is just to add logging
     foreach (QTemporaryFile *file, m_temp_files)
@@ -257,6 +266,25 @@ VideoStorage::downloadViaTool(const QString &address, QString temp_file) //start
         temp_file = makeTempFilePath();
     dl_watcher = new DLWatcher(address, temp_file, this);
 
+    //The downloader writes the file itself, sequentially
+    QSharedPointer<PartialFile> partial(new PartialFile(temp_file));
+    partial->setGrowing(true);
+    m_partial_files[temp_file] = partial;
+    connect(dl_watcher, &DLWatcher::downloadFailed, partial.data(), [partial]()
+    {
+        partial->setFinished(true);
+    });
+    connect(dl_watcher, &DLWatcher::downloadFinished, partial.data(), [partial]()
+    {
+        partial->setFinished();
+    });
+    //Reads stop at the size, an estimate (total_bytes_estimate) could be too small
+    connect(dl_watcher, &DLWatcher::downloadBytesProgressed, partial.data(), [partial, dl_watcher](qint64 bytes, qint64 total)
+    {
+        Q_UNUSED(bytes);
+        if (total > 0 && dl_watcher->isTotalExact()) partial->setSize(total);
+    });
+
     //Hook up signals to notify caller about status and success
     connect(dl_watcher, &DLWatcher::downloadStarted, this, [this, address, dl_watcher]()
     {
@@ -284,15 +312,143 @@ VideoStorage::downloadViaTool(const QString &address, QString temp_file) //start
         emit suggestFilename(filename);
     });
 
-    //Start process
-    QTimer::singleShot(0, dl_watcher, SLOT(start()));
+    //Start process when the download manager has a free slot
+    //The downloader cannot be throttled later, it gets its share on start
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QPointer<DLWatcher> watcher_ptr(dl_watcher);
+    int job = manager->addJob(address, m_download_priority, [manager, watcher_ptr](int job_id)
+    {
+        if (!watcher_ptr)
+        {
+            manager->finishJob(job_id, true);
+            return;
+        }
+        watcher_ptr->setRateLimit(manager->rateLimitFor(job_id));
+        watcher_ptr->start();
+    }, [watcher_ptr]()
+    {
+        if (watcher_ptr) watcher_ptr->stop();
+    });
+    m_download_jobs << job;
+    connect(dl_watcher, &DLWatcher::downloadBytesProgressed, manager, [manager, job](qint64 bytes, qint64 total)
+    {
+        manager->updateJob(job, bytes, total);
+    });
+    connect(dl_watcher, &DLWatcher::downloadFailed, manager, [manager, job]()
+    {
+        manager->finishJob(job, true);
+    });
+    connect(dl_watcher, &DLWatcher::downloadFinished, manager, [manager, job]()
+    {
+        manager->finishJob(job);
+    });
+    connect(dl_watcher, &QObject::destroyed, manager, [manager, job]()
+    {
+        manager->finishJob(job, true); //no effect if already done
+    });
 
     return dl_watcher;
 }
 
+QSharedPointer<PartialFile>
+VideoStorage::partialFile(const QString &file_path)
+{
+    return m_partial_files.value(file_path);
+}
+
+void
+VideoStorage::releasePartialFile(const QString &file_path)
+{
+    m_partial_files.remove(file_path);
+    m_range_replies.remove(file_path);
+}
+
+void
+VideoStorage::fetchRange(const QString &file_path, qint64 offset)
+{
+    QSharedPointer<PartialFile> partial = m_partial_files.value(file_path);
+    if (!partial || partial->isFinished()) return;
+    QUrl url = partial->property("url").toUrl();
+    if (url.isEmpty() || partial->availableFrom(offset) > 0) return;
+
+    //Only the latest seek matters, cancel the previous range request
+    if (m_range_replies.value(file_path))
+        m_range_replies[file_path]->abort();
+
+    //Range request is played right away, so it has playback priority
+    qDebug() << "fetching range for seek:" << url << offset;
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QPointer<VideoStorage> storage(this);
+    QWeakPointer<PartialFile> partial_weak(partial);
+    int job = manager->addJob(tr("%1 (seek)").arg(url.fileName()), DownloadManager::Playback,
+        [storage, manager, url, offset, partial_weak](int job_id)
+    {
+        QSharedPointer<PartialFile> partial = partial_weak.toStrongRef();
+        if (!storage || !partial)
+        {
+            manager->finishJob(job_id, true);
+            return;
+        }
+        if (!storage->m_network) storage->m_network = new QNetworkAccessManager(storage);
+        QNetworkRequest req(url);
+        req.setRawHeader("Range", QString("bytes=%1-").arg(offset).toLatin1());
+        QNetworkReply *reply = storage->m_network->get(req);
+        reply->setProperty("offset", offset);
+        storage->m_range_replies[partial->filePath()] = reply;
+        manager->attachReply(job_id, reply, [reply, partial_weak](const QByteArray &data)
+        {
+            QSharedPointer<PartialFile> partial = partial_weak.toStrongRef();
+            //Server must honor the range, otherwise the data is at offset 0
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (!partial || status != 206)
+            {
+                QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+                return;
+            }
+            qint64 pos = reply->property("offset").toLongLong();
+            partial->write(pos, data);
+            pos += data.size();
+            reply->setProperty("offset", pos);
+            //Stop when the range runs into data that's already there
+            if (partial->availableFrom(pos) > 0 || partial->isFinished())
+                QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+        });
+        connect(reply, &QNetworkReply::finished, manager, [manager, job_id, reply]()
+        {
+            manager->finishJob(job_id);
+            reply->deleteLater();
+        });
+    }, [this, file_path]()
+    {
+        if (m_range_replies.value(file_path))
+            m_range_replies[file_path]->abort();
+    });
+    m_download_jobs << job;
+}
+
+void
+VideoStorage::setDownloadPriority(int priority)
+{
+    //Applies to running and future downloads of this instance
+    m_download_priority = priority;
+    foreach (int job, m_download_jobs)
+        DownloadManager::globalInstance()->setPriority(job, priority);
+}
+
 void
 VideoStorage::downloadFile(const QUrl &url, const QString &temp_file, QFile *fh)
 {
+    //Video has been streamed through the cache proxy, only fetch what's missing
+    if (!fh && temp_file.isEmpty())
+    {
+        QSharedPointer<PartialFile> cache = CacheProxy::globalInstance()->cacheFile(url);
+        if (cache && cache->bytesAvailable() > 0)
+        {
+            downloadPartialFile(url, cache);
+            return;
+        }
+    }
+
     //Initialize HTTP file download
     //It does not need to run in another thread as i/o is already async
     //If no temp file path is provided, one is created, check with filePath()
@@ -305,15 +461,176 @@ VideoStorage::downloadFile(const QUrl &url, const QString &temp_file, QFile *fh)
         file = new QFile(temp_file, this);
     if (!file->isOpen()) file->open(QIODevice::WriteOnly | QIODevice::Truncate);
 
+    //Temp file can be played while it's downloaded (see partialFile())
+    //A seek beyond the downloaded data starts a range request from there,
+    //the download skips what that range request has fetched
+    if (!fh)
+    {
+        QString file_path = file->fileName();
+        file->close();
+        QSharedPointer<PartialFile> partial(new PartialFile(file_path));
+        partial->setProperty("url", url);
+        connect(partial.data(), &PartialFile::rangeRequested, this, [this, file_path](qint64 offset)
+        {
+            fetchRange(file_path, offset);
+        });
+        downloadPartialFile(url, partial);
+        return;
+    }
+
+    //Queue download, the download manager starts it when there's a free slot
+    //and reads the reply, so the bandwidth is shared with other downloads
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QSharedPointer<QPointer<QNetworkReply>> reply_ptr(new QPointer<QNetworkReply>);
+    QPointer<VideoStorage> storage(this);
+    QPointer<QFile> file_ptr(file);
+    int job = manager->addJob(url.fileName(), m_download_priority, [storage, manager, url, file_ptr, reply_ptr](int job_id)
+    {
+        //View closed while the download was queued
+        if (!storage || !file_ptr)
+        {
+            manager->finishJob(job_id, true);
+            return;
+        }
+        *reply_ptr = storage->startHttpDownload(job_id, url, file_ptr);
+    }, [reply_ptr]()
+    {
+        if (*reply_ptr) (*reply_ptr)->abort();
+    });
+    m_download_jobs << job;
+
+}
+
+void
+VideoStorage::downloadPartialFile(const QUrl &url, QSharedPointer<PartialFile> cache)
+{
+    //The partial file is the temp file of this download
+    QString file_path = cache->filePath();
+    m_partial_files[file_path] = cache;
+    qDebug() << "downloading missing ranges:" << url << file_path << cache->bytesAvailable() << "B there";
+
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QSharedPointer<QPointer<QNetworkReply>> reply_ptr(new QPointer<QNetworkReply>);
+    QPointer<VideoStorage> storage(this);
+    int job = manager->addJob(url.fileName(), m_download_priority, [storage, manager, url, cache, reply_ptr](int job_id)
+    {
+        if (!storage)
+        {
+            manager->finishJob(job_id, true);
+            return;
+        }
+        emit storage->downloadStarted(url, cache->filePath());
+        emit storage->downloadStarted(cache->filePath());
+        storage->fetchMissingRange(job_id, url, cache, reply_ptr);
+    }, [reply_ptr]()
+    {
+        if (*reply_ptr) (*reply_ptr)->abort();
+    });
+    m_download_jobs << job;
+}
+
+void
+VideoStorage::fetchMissingRange(int job, const QUrl &url, QSharedPointer<PartialFile> cache, QSharedPointer<QPointer<QNetworkReply>> reply_ptr)
+{
+    DownloadManager *manager = DownloadManager::globalInstance();
+    QString file_path = cache->filePath();
+    qint64 offset = cache->missingFrom(0);
+    if (offset < 0)
+    {
+        //All there
+        qDebug() << "cached stream complete:" << file_path;
+        cache->setFinished();
+        manager->finishJob(job);
+        emit downloadFinished(file_path);
+        return;
+    }
+
+    //Fetch next gap, until it runs into cached data
+    if (!m_network) m_network = new QNetworkAccessManager(this);
+    QNetworkRequest req(url);
+    req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    if (offset > 0)
+        req.setRawHeader("Range", QString("bytes=%1-").arg(offset).toLatin1());
+    QNetworkReply *reply = m_network->get(req);
+    *reply_ptr = reply;
+    reply->setProperty("offset", offset);
+    manager->attachReply(job, reply, [this, manager, job, reply, cache](const QByteArray &data)
+    {
+        //Server ignored the range, data starts at the beginning
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 200 && !reply->property("data_received").toBool())
+            reply->setProperty("offset", 0);
+        reply->setProperty("data_received", true);
+        if (status == 200 && cache->size() < 0)
+            cache->setSize(reply->header(QNetworkRequest::ContentLengthHeader).toLongLong());
+
+        qint64 pos = reply->property("offset").toLongLong();
+        cache->write(pos, data);
+        pos += data.size();
+        reply->setProperty("offset", pos);
+
+        qint64 size = cache->size();
+        if (size > 0)
+        {
+            manager->updateJob(job, cache->bytesAvailable(), size);
+            emit downloadProgressed(100.0 * cache->bytesAvailable() / size);
+        }
+        if (cache->availableFrom(pos) > 0)
+        {
+            reply->setProperty("stopped", true);
+            QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, manager, job, url, reply, cache, reply_ptr]()
+    {
+        if (reply->error() != QNetworkReply::NoError && !reply->property("stopped").toBool())
+        {
+            reply->deleteLater();
+            qWarning() << "cannot complete download:" << url << reply->errorString();
+            //Readers of our own temp file stop waiting (a proxy cache file is the proxy's)
+            if (cache->property("url").isValid()) cache->setFinished(true);
+            manager->finishJob(job, true);
+            emit downloadFailed(cache->filePath());
+            return;
+        }
+
+        //Rest of the read buffer, at the job's rate like the rest
+        manager->drainReply(job, [this, job, url, reply, cache, reply_ptr]()
+        {
+            reply->deleteLater();
+            //Without content length, the first complete response defines the size
+            if (cache->size() < 0 && !reply->property("stopped").toBool())
+                cache->setSize(cache->availableFrom(0));
+            fetchMissingRange(job, url, cache, reply_ptr);
+        });
+    });
+}
+
+QNetworkReply*
+VideoStorage::startHttpDownload(int job, const QUrl &url, QFile *file)
+{
     //Prepare request, acquire handle to network manager (conn pool...)
     if (!m_network) m_network = new QNetworkAccessManager(this);
     QNetworkRequest req(url);
 
     //Initiate download (GET), write received data to temp file
+    //Data is read by the download manager (rate limit)
+    DownloadManager *manager = DownloadManager::globalInstance();
     QNetworkReply *reply = m_network->get(req);
     reply->setProperty("data_received", false);
     reply->setProperty("is_failed", false);
-    connect(reply, &QNetworkReply::downloadProgress, this, [this, reply, url, file]
+    manager->attachReply(job, reply, [this, reply, file](const QByteArray &data)
+    {
+        qint64 total_written = reply->property("written").toLongLong();
+        qint64 now_written = file->write(data);
+        total_written += now_written;
+        reply->setProperty("written", total_written);
+
+        qint64 total = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        if (total > 0)
+            emit downloadProgressed(100.0 * total_written / total);
+    });
+    connect(reply, &QNetworkReply::downloadProgress, this, [this, manager, job, reply, url, file]
     (qint64 received, qint64 total)
     {
         if (!reply->property("data_received").toBool())
@@ -324,36 +641,34 @@ VideoStorage::downloadFile(const QUrl &url, const QString &temp_file, QFile *fh)
             emit downloadStarted(file_path);
             qDebug() << "http download started:" << url.url() << file_path;
         }
-
-        qint64 now_written = file->write(reply->read(received));
-        qint64 total_received = received;
-        qint64 total_written = reply->property("written").toLongLong();
-        total_written += now_written;
-        reply->setProperty("written", total_written);
-
-        double p = std::div(total_written * 100, total).quot;
-        emit downloadProgressed(p);
+        manager->updateJob(job, reply->property("written").toLongLong(), total);
     });
-    connect(reply, &QNetworkReply::errorOccurred, this, [this, reply, file](QNetworkReply::NetworkError code)
+    connect(reply, &QNetworkReply::errorOccurred, this, [this, manager, job, reply, file](QNetworkReply::NetworkError code)
     {
         reply->setProperty("is_failed", true);
+        manager->finishJob(job, true);
         emit downloadFailed(file->fileName());
 
         reply->deleteLater();
     });
-    connect(reply, &QNetworkReply::finished, this, [this, reply, file]()
+    connect(reply, &QNetworkReply::finished, this, [this, manager, job, reply, file]()
     {
         bool is_failed = reply->property("is_failed").toBool();
         if (is_failed) return;
         qDebug() << "http download completed:" << file->fileName();
 
-        file->write(reply->readAll());
-        file->close();
+        //Rest of the read buffer, at the job's rate like the rest
+        manager->drainReply(job, [this, manager, job, reply, file]()
+        {
+            file->close();
 
-        emit downloadFinished(file->fileName());
-        reply->deleteLater();
+            manager->finishJob(job);
+            emit downloadFinished(file->fileName());
+            reply->deleteLater();
+        });
     });
 
+    return reply;
 }
 
 void
@@ -439,36 +754,19 @@ QString
 VideoStorage::findFileByAddress(const QString &address)
 {
     QString file_path;
-    ProfileSettings *settings = ProfileSettings::profile();
-    //addr_map contains vid_dl item(s) src_addr => {file_path + metadata}
-    QVariantMap addr_map = settings->variant("addr_map").toMap();
-    if (addr_map.contains(address))
+    LibraryIndex *library = LibraryIndex::globalInstance();
+    //Indexed lookup: src_addr => vid_dl {file_path + metadata}
+    QVariantMap vid_dl = library->findByAddress(address);
+    if (!vid_dl.isEmpty())
     {
-        //Get item from map with address as key
-        QVariant var = addr_map[address];
-        if (var.canConvert<QVariantMap>())
-        {
-            QVariantMap vid_dl = var.toMap();
-            file_path = vid_dl["file"].toString();
-        }
-        else if (var.canConvert<QString>())
-        {
-            file_path = var.toString(); //TODO testing only
-        }
+        file_path = vid_dl["file"].toString();
         //Check if file still exists, otherwise don't return this item
         if (!file_path.isEmpty() && !QFileInfo(file_path).exists())
         {
             //Referenced file does not exist anymore
-            qDebug() << "removed deleted file from addr_map" << file_path;
-            //Move obsolete item to trash list
-            QVariantList trash_list = settings->variant("trash_list").toList(); //TODO settings.getList / append ...
-            QVariantMap file_map = settings->variant("file_map").toMap();
-            trash_list.append(var);
-            addr_map.remove(address);
-            file_map.remove(file_path);
-            settings->setVariant("trash_list", trash_list); //TODO
-            settings->setVariant("addr_map", addr_map);
-            settings->setVariant("file_map", file_map);
+            //Move obsolete item to trash (removes all its addresses)
+            qDebug() << "removed deleted file from library index" << file_path;
+            library->removeFile(file_path);
             //Do not return invalid file path
             file_path = "";
         }
@@ -496,15 +794,7 @@ VideoStorage::findFileByAddress(const QString &address)
 QVariantMap
 VideoStorage::findFileContext(const QString &file)
 {
-    QVariantMap result;
-    //TODO
-    ProfileSettings *settings = ProfileSettings::profile();
-    QVariantMap map = settings->variant("file_map").toMap();
-    if (map.contains(file))
-    {
-        result = map[file].toMap();
-    }
-    return result;
+    return LibraryIndex::globalInstance()->findFileContext(file);
 }
 
 //bool
@@ -513,11 +803,145 @@ VideoStorage::findFileContext(const QString &file)
 //    return !find(context).isNull();
 //}
 
+QString
+VideoStorage::fileHash(const QString &file_path, const QAtomicInt *abort)
+{
+    QFile file(file_path);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    //Read in chunks to be able to abort (on exit)
+    QCryptographicHash hash_md5(QCryptographicHash::Md5);
+    QByteArray chunk;
+    while (!(chunk = file.read(1 << 20)).isEmpty())
+    {
+        if (abort && abort->loadRelaxed()) return QString();
+        hash_md5.addData(chunk);
+    }
+    if (file.error() != QFile::NoError) return QString();
+    return hash_md5.result().toHex();
+}
+
 QVariantMap
 VideoStorage::findMatchingFile(const QString &copy_file_path)
 {
-    //TODO
-    return QVariantMap();
+    QVariantMap match;
+    QString md5 = fileHash(copy_file_path);
+    if (md5.isEmpty()) return match;
+    match["hash_md5"] = md5;
+
+    //Same hash and same size, the size is checked to rule out a stale index
+    qint64 size = QFileInfo(copy_file_path).size();
+    foreach (QString file, LibraryIndex::globalInstance()->findFilesByHash(md5))
+    {
+        QFileInfo fi(file);
+        if (!fi.isFile() || fi.size() != size) continue;
+        if (fi.canonicalFilePath() == QFileInfo(copy_file_path).canonicalFilePath()) continue;
+        match["file"] = fi.filePath();
+        break;
+    }
+    return match;
+}
+
+QVariantMap
+VideoStorage::duplicateReport()
+{
+    int group_count = 0, file_count = 0;
+    qint64 reclaimable = 0;
+    foreach (QVariant v_group, LibraryIndex::globalInstance()->duplicateGroups())
+    {
+        QVariantMap group = v_group.toMap();
+        //Count distinct inodes, hard links share their data
+        QSet<qint64> inodes;
+        qint64 size = 0;
+        int copies = 0;
+        foreach (QString file, group["files"].toStringList())
+        {
+            QVariantMap stat = LibraryIndex::statFile(file);
+            if (stat.isEmpty()) continue;
+            size = stat["size"].toLongLong();
+            copies++;
+            if (stat.contains("inode"))
+            {
+                qint64 inode = stat["inode"].toLongLong();
+                if (inodes.contains(inode)) continue;
+                inodes << inode;
+            }
+            if (copies > 1) reclaimable += size;
+        }
+        if (copies < 2) continue;
+        group_count++;
+        file_count += copies;
+    }
+
+    QVariantMap report;
+    report["groups"] = group_count;
+    report["files"] = file_count;
+    report["reclaimable"] = reclaimable;
+    return report;
+}
+
+qint64
+VideoStorage::linkDuplicates()
+{
+    qint64 freed = 0;
+#if defined(Q_OS_UNIX)
+    LibraryIndex *library = LibraryIndex::globalInstance();
+    foreach (QVariant v_group, library->duplicateGroups())
+    {
+        QVariantMap group = v_group.toMap();
+        QStringList files = group["files"].toStringList();
+
+        //Keep the oldest existing copy that is unchanged since it was hashed,
+        //otherwise the duplicates would be replaced with different content
+        QString keep;
+        QVariantMap keep_stat;
+        foreach (QString file, files)
+        {
+            keep_stat = LibraryIndex::statFile(file);
+            if (keep_stat.isEmpty()) continue;
+            QVariantMap info = library->fileInfo(file);
+            if (info.contains("mtime") && info["mtime"].toLongLong() != keep_stat["mtime"].toLongLong()) continue;
+            keep = file;
+            break;
+        }
+        if (keep.isEmpty()) continue;
+
+        foreach (QString file, files)
+        {
+            if (file == keep) continue;
+            QVariantMap stat = LibraryIndex::statFile(file);
+            if (stat.isEmpty() || stat.value("inode") == keep_stat.value("inode")) continue;
+            if (stat["size"] != keep_stat["size"]) continue;
+            //Skip file if it has been modified since it was hashed
+            QVariantMap info = library->fileInfo(file);
+            if (info.contains("mtime") && info["mtime"].toLongLong() != stat["mtime"].toLongLong()) continue;
+            //Data is only released with the last link (other duplicates, files outside the library)
+            struct stat st;
+            if (::stat(QFile::encodeName(file).constData(), &st) != 0) continue;
+            bool last_link = st.st_nlink == 1;
+
+            //Link next to the duplicate, then rename over it (atomic)
+            QString tmp = file + ".dedup";
+            if (::link(QFile::encodeName(keep).constData(), QFile::encodeName(tmp).constData()) != 0)
+            {
+                qDebug() << "cannot hard link duplicate (other volume?)" << file;
+                continue;
+            }
+            if (::rename(QFile::encodeName(tmp).constData(), QFile::encodeName(file).constData()) != 0)
+            {
+                QFile::remove(tmp);
+                continue;
+            }
+            library->updateFileInfo(file, LibraryIndex::statFile(file));
+            if (last_link)
+                freed += stat["size"].toLongLong();
+            qDebug() << "replaced duplicate with hard link" << file << "->" << keep;
+        }
+    }
+#else
+    qWarning() << "hard links to deduplicate library are not supported on this system";
+#endif
+    return freed;
 }
 
 QString
@@ -576,6 +1000,30 @@ VideoStorage::importFile(const QString &file_path, const QString &src_address, c
     QDir dst_dir(dst_dir_path);
     if (!dst_dir.exists()) return;
 
+    //Look for a file with identical content in the library
+    //A re-import (e.g., embed url of a known video) becomes an alias
+    //of the existing file instead of another copy
+    QVariantMap match = findMatchingFile(file_path);
+    QString md5 = match.value("hash_md5").toString();
+    if (md5.isEmpty()) return; //TODO error signal
+    if (match.contains("file"))
+    {
+        QString existing_file = match["file"].toString();
+        LibraryIndex *library = LibraryIndex::globalInstance();
+        bool ok;
+        //Keep existing context, only add the source address
+        if (library->findFileContext(existing_file).isEmpty())
+            ok = library->addImportedFile(existing_file, src_address, md5, context);
+        else
+            ok = library->addAddress(src_address, existing_file);
+        if (!ok) return; //TODO error signal
+        qDebug() << "import is a duplicate, added address to existing file" << existing_file << src_address;
+        if (move_file && in_file.remove()) //temp copy not needed
+            releaseCacheFile(file_path);
+        emit fileImported(existing_file);
+        return;
+    }
+
     //Destination filename
     QString filename = determineImportFilename(file_path, context);
     QFileInfo fi_new(dst_dir, filename);
@@ -584,7 +1032,11 @@ VideoStorage::importFile(const QString &file_path, const QString &src_address, c
     //or rename it, if the caller told us that it can be removed (temp file)
     if (move_file)
     {
-        if (!in_file.rename(fi_new.filePath()))
+        if (in_file.rename(fi_new.filePath()))
+        {
+            releaseCacheFile(file_path);
+        }
+        else
         {
             //Rename failed, that's ok though (e.g., different volume)
             if (!in_file.copy(fi_new.filePath())) return; //TODO error signal
@@ -595,47 +1047,35 @@ VideoStorage::importFile(const QString &file_path, const QString &src_address, c
         if (!in_file.copy(fi_new.filePath())) return; //TODO error signal
     }
 
-    //TODO use central storage instance (mutex) for safe db access
     //TODO consider QSaveFile
     //
     //TODO open fh first, so we don't lose it if it's removed in the meantime
 
-    //Calculate file hash
-    QString md5;
+    //Add file with context and source address to library index
+    //(hash of the source file calculated above, before copying)
+    //Both are written in one transaction, the rest of the index is untouched
+    //The context is saved under the file, the address points to the file
+    if (!LibraryIndex::globalInstance()->addImportedFile(fi_new.filePath(), src_address, md5, context))
     {
-        QFile file(fi_new.filePath());
-        QCryptographicHash hash_md5(QCryptographicHash::Md5);
-        hash_md5.addData(&file);
-        md5 = hash_md5.result().toHex();
+        qWarning() << "failed to add imported file to library index" << fi_new.filePath();
+        return; //TODO error signal
     }
-
-    //Access global settings
-    ProfileSettings *settings = ProfileSettings::profile();
-
-    //Add context, info for lookup by filename
-    QVariantMap file_map = settings->variant("file_map").toMap();
-    file_map[fi_new.filePath()] = context;
-    settings->setVariant("file_map", file_map);
-    qDebug() << "added file to file_map" << fi_new.filePath();
-    QVariantMap ctx_mod = context;
-    ctx_mod["file"] = fi_new.filePath();
-    ctx_mod["hash_md5"] = md5;
-    //TODO convenience function to directly add map item
-
-    //Add download item to address map for lookup by source address
-    //Download item means this points to the downloaded, imported filename
-    QVariantMap addr_map = settings->variant("addr_map").toMap();
-    QVariantMap vid_dl;
-    vid_dl["url"] = src_address;
-    vid_dl["file"] = fi_new.filePath();
-    vid_dl["hash_md5"] = md5;
-    addr_map[src_address] = vid_dl;
-    settings->setVariant("addr_map", addr_map);
-    qDebug() << "added file to addr_map" << fi_new.filePath();
+    qDebug() << "added file to library index" << fi_new.filePath() << src_address;
+    //Store size/mtime/inode as well, so the library scanner won't hash it again
+    LibraryIndex::globalInstance()->updateFileInfo(fi_new.filePath(), LibraryIndex::statFile(fi_new.filePath()));
 
     emit fileImported(fi_new.filePath());
 }
 
+void
+VideoStorage::releaseCacheFile(const QString &file_path)
+{
+    //Moved file may have been streamed through the cache proxy
+    //Import runs in a worker thread, the proxy lives in the main thread
+    QMetaObject::invokeMethod(CacheProxy::globalInstance(), "releaseFile",
+        Qt::QueuedConnection, Q_ARG(QString, file_path));
+}
+
 void
 VideoStorage::scheduleImportFile(const QString &file_path, const QString &src_address, const QVariantMap &context, bool move_file)
 {
@@ -657,9 +1097,17 @@ VideoStorage::scheduleImportFile(const QString &file_path, const QString &src_ad
 DLWatcher::DLWatcher(const QString &address, QObject *parent)
          : QObject(parent),
            m_src_addr(address),
-           m_start_confirmed(false)
+           m_start_confirmed(false),
+           m_bytes_done(-1),
+           m_bytes_total(-1),
+           m_bytes_total_exact(false),
+           m_percent(-1)
 {
-    connect(&tmr_status, SIGNAL(timeout()), SLOT(checkStatus()));
+    //Progress is reported by the downloader many times per second,
+    //the signal is throttled (last value is emitted when the timer fires)
+    tmr_status.setSingleShot(true);
+    tmr_status.setInterval(250);
+    connect(&tmr_status, SIGNAL(timeout()), SLOT(emitProgress()));
 }
 DLWatcher::DLWatcher(const QString &address, const QString &dst_file, QObject *parent)
          : DLWatcher(address, parent)
@@ -692,6 +1140,7 @@ DLWatcher::init_proc()
 
     connect(m_proc, SIGNAL(started()), SLOT(checkStateStarted()));
     connect(m_proc, SIGNAL(readyReadStandardOutput()), SLOT(transferChunk()));
+    connect(m_proc, SIGNAL(readyReadStandardError()), SLOT(readStatusError()));
     connect(m_proc, SIGNAL(finished(int, QProcess::ExitStatus)), SLOT(checkStateFinished(int, QProcess::ExitStatus)));
     connect(m_proc, SIGNAL(error(QProcess::ProcessError)), SLOT(checkStateError(QProcess::ProcessError)));
 
@@ -713,7 +1162,7 @@ DLWatcher::init_dst(const QString &dst_file)
     QStringList args;
     args << "-o" << dst_file;
     args << "--no-part";
-    args << "-q" << "--progress" << "--newline";
+    args << progressArguments();
     args << m_src_addr;
     m_proc->setArguments(args);
     qDebug() << args;
@@ -734,7 +1183,7 @@ DLWatcher::init_dst(QFile *dst_file)
     QStringList args;
     args << "-o" << "-";
     args << "--no-part";
-    args << "-q" << "--progress" << "--newline";
+    args << progressArguments();
     args << m_src_addr;
     m_proc->setArguments(args);
     qDebug() << args;
@@ -742,6 +1191,19 @@ DLWatcher::init_dst(QFile *dst_file)
     tmr_status.stop();
 }
 
+QStringList
+DLWatcher::progressArguments()
+{
+    //Machine-readable progress, one line per update:
+    //[peerplayer] <downloaded_bytes> <total_bytes> <total_bytes_estimate>
+    //Values are "NA" if unknown (e.g., total size of a live stream)
+    QStringList args;
+    args << "-q" << "--progress" << "--newline";
+    args << "--progress-template";
+    args << "download:[peerplayer] %(progress.downloaded_bytes)s %(progress.total_bytes)s %(progress.total_bytes_estimate)s";
+    return args;
+}
+
 void
 DLWatcher::tryDetermineFilename()
 {
@@ -778,13 +1240,30 @@ DLWatcher::filePath()
     return m_dst_file_path;
 }
 
+void
+DLWatcher::setRateLimit(qint64 bytes_per_sec)
+{
+    //Must be set before start, the downloader can't be changed later
+    if (!m_proc || bytes_per_sec <= 0) return;
+    QStringList args = m_proc->arguments();
+    args.prepend(QString::number(bytes_per_sec));
+    args.prepend("--limit-rate");
+    m_proc->setArguments(args);
+}
+
+void
+DLWatcher::stop()
+{
+    if (m_proc && m_proc->state() != QProcess::NotRunning)
+        m_proc->kill();
+}
+
 void
 DLWatcher::start()
 {
     tryDetermineFilename();
 
     m_proc->start();
-    tmr_status.start(1);
 }
 
 void
@@ -801,53 +1280,98 @@ void
 DLWatcher::transferChunk()
 {
     //Read downloaded chunk from process and write it to file handle
-    if (!m_dst_file_obj) return;
+    //If the downloader saves to a file, stdout has status lines instead
+    if (!m_dst_file_obj)
+    {
+        readStatus(m_proc->readAllStandardOutput(), m_out_buffer);
+        return;
+    }
 
     QByteArray bytes = m_proc->readAllStandardOutput();
     qint64 written = m_dst_file_obj->write(bytes);
 }
 
 void
-DLWatcher::checkStatus(const QString &line)
+DLWatcher::readStatusError()
 {
-    QString percent_str;
-    qDebug() << "dl/proc line:" << line;
-    QRegExp rx("\\s(\\d+[.]\\d+)%"); //TODO static
-    if (rx.indexIn(line) != -1)
+    //Status lines end up here when stdout is used for streaming
+    readStatus(m_proc->readAllStandardError(), m_err_buffer);
+}
+
+void
+DLWatcher::readStatus(const QByteArray &data, QByteArray &buffer)
+{
+    //Handle all complete lines that are available, keep the rest
+    buffer += data;
+    int end = buffer.lastIndexOf('\n');
+    if (end == -1) return;
+    QList<QByteArray> lines = buffer.left(end).split('\n');
+    buffer.remove(0, end + 1);
+
+    bool progressed = false;
+    foreach (QByteArray line, lines)
+        progressed = checkStatus(line.trimmed()) || progressed;
+    if (!progressed) return;
+
+    //Report start once, then progress at most every few hundred ms
+    if (!m_start_confirmed)
     {
-        percent_str = rx.cap(1);
+        emit downloadStarted();
+        m_start_confirmed = true;
     }
+    if (!tmr_status.isActive())
+    {
+        emitProgress();
+        tmr_status.start();
+    }
+}
 
-    if (!percent_str.isEmpty())
+bool
+DLWatcher::checkStatus(const QByteArray &line)
+{
+    //Parse progress line (see progressArguments), only the last one counts
+    static const QByteArray prefix("[peerplayer] ");
+    if (!line.startsWith(prefix))
     {
-        if (!m_start_confirmed)
+        //Anything else is kept for the error message
+        if (!line.isEmpty())
         {
-            emit downloadStarted();
-            m_start_confirmed = true;
+            m_err_output += line + '\n';
+            if (m_err_output.size() > 65536) m_err_output.remove(0, m_err_output.size() - 65536);
         }
-        bool ok;
-        double p = percent_str.toDouble(&ok);
-        if (ok)
-            emit downloadProgressed(p);
+        return false;
     }
 
+    QList<QByteArray> fields = line.mid(prefix.size()).split(' ');
+    if (fields.size() < 3) return false;
+    bool ok;
+    qint64 done = (qint64)fields[0].toDouble(&ok); //may be printed as float
+    if (!ok) return false;
+    qint64 total = (qint64)fields[1].toDouble(&ok);
+    bool exact = ok;
+    if (!ok) total = (qint64)fields[2].toDouble(&ok);
+    if (!ok) total = -1;
+
+    m_bytes_done = done;
+    m_bytes_total = total;
+    m_bytes_total_exact = exact;
+    m_percent = total > 0 ? 100.0 * done / total : -1;
+    return true;
 }
 
-void
-DLWatcher::checkStatus()
+bool
+DLWatcher::isTotalExact() const
 {
-    //Read status from process and report progress IF status in stdout
-    //The downloader will print status text to its stdout by default
-    //when it is saving to a file; it won't if stdout is used for streaming
-    if (m_dst_file_path.isEmpty())
-        return;
+    return m_bytes_total_exact;
+}
 
-    //Read line from subprocess, if possible
-    if (m_proc->canReadLine())
-    {
-        QString line(m_proc->readLine());
-        checkStatus(line);
-    }
+void
+DLWatcher::emitProgress()
+{
+    if (m_bytes_done < 0) return;
+    if (m_percent >= 0)
+        emit downloadProgressed(m_percent);
+    emit downloadBytesProgressed(m_bytes_done, m_bytes_total);
 }
 
 void
@@ -858,17 +1382,16 @@ DLWatcher::checkStateError(QProcess::ProcessError error)
 void
 DLWatcher::checkStateFinished(int rc, QProcess::ExitStatus status)
 {
-    //Stop monitoring, collect remaining output from pipe
+    //Collect remaining output from pipes (last line may lack newline),
+    //report final progress
+    if (m_dst_file_obj)
+        transferChunk();
+    else
+        readStatus(m_proc->readAllStandardOutput() + '\n', m_out_buffer);
+    readStatus(m_proc->readAllStandardError() + '\n', m_err_buffer);
     tmr_status.stop();
-    QByteArray err_output = m_proc->readAllStandardError();
-    QByteArray raw_out_rest = m_proc->readAllStandardOutput();
-    if (!raw_out_rest.isEmpty())
-    {
-        //Process remaining lines from stdout, handle status signals
-        QTextStream reader(&raw_out_rest);
-        while (!reader.atEnd())
-            checkStatus(reader.readLine());
-    }
+    emitProgress();
+    QByteArray err_output = m_err_output;
 
     qDebug() << "dl/proc finished, rc:" << rc; //TODO LogLogger ...
 
@@ -16,14 +16,21 @@
 VideoView::VideoView(QWidget *parent)
          : QWidget(parent),
            m_src_index(-1),
+           m_src_user_selected(false),
+           m_src_ready_selected(false),
            m_download_active(false),
            m_import_requested(false),
-           m_play_on_select(false)
+           m_play_on_select(false),
+           m_match_requested(false),
+           m_restore_time(0)
 {
     setAttribute(Qt::WA_DeleteOnClose);
     initWidgets();
 
     m_storage = new VideoStorage(this);
+    m_ranker = new SourceRanker(this);
+    connect(m_ranker, SIGNAL(ranked(const QList<QUrl>&)), SLOT(sourcesRanked(const QList<QUrl>&)));
+    connect(m_ranker, SIGNAL(sourceReady(const QUrl&)), SLOT(sourceReady(const QUrl&)));
     //We use strings instead of QFileInfo objects because we need the path and:
     //> Warning: If filePath() is empty the behavior of this function is undefined.
     //https://doc.qt.io/qt-5/qfileinfo.html#absoluteFilePath
@@ -46,6 +53,8 @@ VideoView::VideoView(QWidget *parent)
             tr("The video has been imported."));
         m_notifications->hideNotification("import");
     });
+    connect(LibraryScanner::globalInstance(), SIGNAL(remoteMatched(const QString&, const QString&)),
+        SLOT(handleRemoteMatch(const QString&, const QString&)));
 
     //Base ctor - no further action, see below
 }
@@ -212,7 +221,9 @@ VideoView::VideoView(const QFileInfo &fi, bool play_on_select, QWidget *parent)
     //but the context map would give us goodies like description or title.
     m_src_context = m_storage->findFileContext(fi.filePath());
     //addContext(m_storage->find(fi));
-    //TODO schedule hash in background
+    //Hash and probe file in background, if it's new or has changed
+    if (ProfileSettings::profile()->setDefaultVariant("library_scan", true).toBool())
+        LibraryScanner::globalInstance()->scheduleFile(fi.filePath());
     if (!m_src_context.isEmpty()) contextLoaded();
 
 }
@@ -245,9 +256,8 @@ VideoView::initWidgets()
     m_vbox_player_container->setContentsMargins(QMargins());
     m_wid_player->setLayout(m_vbox_player_container);
     vbox->addWidget(m_wid_player);
-    //Create player, see reinit function...
-    m_vlc = new VlcPlayer();
-    m_vbox_player_container->addWidget(m_vlc);
+    //Player is created when the view is shown, see ensurePlayer()
+    m_vlc = 0;
 
     //Set dark mode or custom stylesheet
     QString css =
@@ -259,9 +269,6 @@ VideoView::initWidgets()
     ;
     setStyleSheet(css); //css on QWidget causes flicker
 
-    connect(m_vlc, SIGNAL(started()), m_lbl_title, SLOT(hide()));
-    connect(m_vlc, SIGNAL(stopped()), m_lbl_title, SLOT(show()));
-
     //Description preview and control buttons: Import, Source (version/res.)
     QHBoxLayout *hbox_bottom1 = new QHBoxLayout;
     m_txt_desc = new QTextEdit;
@@ -299,9 +306,29 @@ VideoView::initWidgets()
 
 }
 
+void
+VideoView::ensurePlayer()
+{
+    if (m_vlc) return;
+
+    //Create player, see reinit function...
+    m_vlc = new VlcPlayer();
+    m_vbox_player_container->addWidget(m_vlc);
+    connectPlayer();
+
+    //Load source that has been selected in the meantime
+    if (m_src_index >= 0) selectSource(m_src_index);
+}
+
 void
 VideoView::recreatePlayer()
 {
+    if (!m_vlc)
+    {
+        ensurePlayer();
+        return;
+    }
+
     //Copy VLC player by creating new one which tries to copy playlist item
     VlcPlayer *vlc_old = m_vlc;
     VlcPlayer *vlc_new = new VlcPlayer(*vlc_old);
@@ -312,6 +339,82 @@ VideoView::recreatePlayer()
     m_vbox_player_container->removeWidget(vlc_old);
     vlc_old->deleteLater();
     m_vbox_player_container->addWidget(vlc_new);
+    connectPlayer();
+}
+
+void
+VideoView::connectPlayer()
+{
+    connect(m_vlc, SIGNAL(started()), m_lbl_title, SLOT(hide()));
+    connect(m_vlc, SIGNAL(stopped()), m_lbl_title, SLOT(show()));
+
+    //Downloads in the background are slowed down while a video is playing
+    //(not while it's paused)
+    VlcPlayer *vlc = m_vlc;
+    connect(vlc, &VlcPlayer::playingChanged, this, [vlc](bool playing)
+    {
+        DownloadManager::globalInstance()->setPlaybackActive(vlc, playing);
+    });
+
+    //Slow or broken source, try the next one
+    vlc->setStallTimeout(ProfileSettings::profile()->setDefaultVariant("source_stall_seconds", 10).toInt() * 1000);
+    connect(vlc, SIGNAL(stalled()), SLOT(handlePlaybackStall()));
+    connect(vlc, SIGNAL(failed()), SLOT(handlePlaybackStall()));
+
+    //Remember where the video was left (saved in batches)
+    connect(vlc, &VlcPlayer::timeChanged, this, [this, vlc](qint64 time)
+    {
+        if (!m_resume_keys.isEmpty())
+            ResumePositions::globalInstance()->setPosition(m_resume_keys, time, vlc->duration());
+    });
+}
+
+void
+VideoView::showEvent(QShowEvent *event)
+{
+    //A view that is never shown (background tab) does not need a player
+    ensurePlayer();
+    QWidget::showEvent(event);
+}
+
+bool
+VideoView::isPlaying()
+{
+    return m_vlc && m_vlc->isPlaying();
+}
+
+bool
+VideoView::canHibernate()
+{
+    //Downloads and imports belong to this view
+    return !isPlaying() && !m_download_active && !m_import_requested;
+}
+
+QVariantMap
+VideoView::state()
+{
+    //Temp files are gone when the view is closed
+    QVariantMap state;
+    if (m_src_index >= 0 && m_src_index < m_video_items.count())
+    {
+        QUrl url = m_video_items[m_src_index].value("url").toUrl();
+        if (!(url.isLocalFile() && url.toLocalFile() == m_temp_file))
+            state["source"] = url;
+    }
+    else if (m_restore_source.isValid())
+    {
+        state["source"] = m_restore_source;
+    }
+    qint64 time = m_vlc ? m_vlc->time() : -1;
+    state["time"] = time > 0 ? time : m_restore_time;
+    return state;
+}
+
+void
+VideoView::restoreState(const QVariantMap &state)
+{
+    m_restore_source = state.value("source").toUrl();
+    m_restore_time = state.value("time").toLongLong();
 }
 
 void
@@ -386,6 +489,7 @@ VideoView::downloadExternally(const QString &address)
     {
         QMessageBox::critical(this, tr("Download"),
             tr("Cannot start another download, video is already being downloaded."));
+        return;
     }
     m_download_active = true;
 
@@ -415,6 +519,7 @@ VideoView::downloadFile(const QUrl &url)
     {
         QMessageBox::critical(this, tr("Download"),
             tr("Cannot start another download, video is already being downloaded."));
+        return;
     }
     m_download_active = true;
     m_http_download_requested = true;
@@ -534,9 +639,11 @@ VideoView::handleDownloadStarted(const QString &temp_file)
     m_download_active = true;
     m_download_ready = false;
 
-    //not yet starting playback at 0%, it would fail at this point
-    //see progress handler
-    //note that we want to play the temporary file before it's complete
+    //Play the temporary file before it's complete, right away
+    //It's read through the partial file (see VideoStorage::partialFile()),
+    //reads block until the bytes have been downloaded
+    if (!isSourceFile(m_temp_file))
+        addVideoSource(m_temp_file);
 }
 
 void
@@ -544,23 +651,6 @@ VideoView::handleDownloadProgress(double p)
 {
     m_notifications->showNotification("download", tr("Downloading: %1%").arg(p, 0, 'f', 1));
 
-    //Add partial/temp file as source and play after given % downloaded
-    //because if we loaded it at 0%, nothing would happen: cannot pre fill buffer
-    double play_after_percent = 3; //play_after_min
-    if (!isSourceFile(m_temp_file) && p > play_after_percent) //TODO very ugly, unreliable
-    {
-        //Try to add partial video file as source and start playback
-        //If this fails, it should probably remove the bad source?
-        addVideoSource(m_temp_file);
-    }
-
-    //TODO check if playback could be started! remove source on error
-    //This happens when playback is started too early (file empty):
-    //cache_read stream error: cannot pre fill buffer
-    //mjpeg demux error: cannot peek
-    //main input error: Your input can't be opened
-    //main input error: VLC is unable to open the MRL
-
     //TODO update position bar of player?
 }
 
@@ -599,6 +689,7 @@ VideoView::completeDownloadedVideo()
     //because it was defined before the type of video was known
     qInfo() << "video view - download completed" << m_temp_file;
     m_notifications->showNotification("download", "Download completed!", 30);
+    SeekPreviews::globalInstance()->request(m_temp_file);
 
     //Now import downloaded file if requested
     if (m_import_requested)
@@ -749,11 +840,44 @@ VideoView::useVideoSources()
         QAction *action = menu->addAction(label); //label is source/file name
         action->setCheckable(true);
         action->setProperty("i", i);
+        action->setProperty("label", label);
         m_src_acts[i] = QPointer<QAction>(action);
 
-        //Select first source to be played
-        if (i == 0 && !m_vlc->isPlaying())
-            selectSource(0);
+        //Select the source played before right away, others are ranked first
+        int first = indexOfSourceItem(m_restore_source);
+        if (i == first && !isPlaying())
+            selectSource(i);
+    }
+
+    //Probe remote sources in parallel, the fastest one is selected when they're done
+    //A local copy always goes first, no need to probe anything then
+    int first_local = -1;
+    for (int i = 0; i < m_video_items.count() && first_local < 0; i++)
+        if (m_video_items[i].value("url").toUrl().isLocalFile()) first_local = i;
+    //A source expected to start quickly enough is played before the others are done
+    ProfileSettings *settings = ProfileSettings::profile();
+    bool ranking = settings->setDefaultVariant("source_ranking", true).toBool();
+    qint64 good_enough = settings->setDefaultVariant("source_good_enough_ms", 1500).toLongLong();
+    if (first_local < 0 && ranking && m_video_items.count() > 1)
+    {
+        //New ranking, sources that stalled before get another chance
+        m_stalled_sources.clear();
+        m_src_ready_selected = false;
+        m_ranker->rank(m_video_items, 3000, good_enough);
+    }
+    else if (indexOfSourceItem(m_restore_source) < 0 && !isPlaying() && !m_video_items.isEmpty())
+        selectSource(qMax(first_local, 0));
+
+    //Look for a local copy in another encoding (re-upload on another site)
+    //The remote stream is fingerprinted in the background
+    if (!m_match_requested && !m_src_address.isEmpty() && !m_video_items.isEmpty())
+    {
+        QUrl url = m_video_items.first().value("url").toUrl();
+        if (first_local < 0 && url.isValid() && !url.isLocalFile())
+        {
+            m_match_requested = true;
+            LibraryScanner::globalInstance()->matchRemote(m_src_address, url);
+        }
     }
 
     //Update title to show video being played
@@ -761,6 +885,25 @@ VideoView::useVideoSources()
     m_tmr_title->start();
 }
 
+void
+VideoView::handleRemoteMatch(const QString &address, const QString &file)
+{
+    if (address != m_src_address || isSourceFile(file)) return;
+
+    //Local copy goes first, play it unless the remote one is already playing
+    qInfo() << this << "found local copy of remote video:" << file;
+    QVariantMap item;
+    item["url"] = QUrl::fromLocalFile(file);
+    m_video_items.prepend(item);
+    if (m_src_index >= 0) m_src_index++;
+    //Ranking of the remote sources is pointless now, it must not replace the local copy
+    m_ranker->abort();
+    m_src_order.clear();
+    if (isPlaying())
+        m_notifications->showNotification("download", "This video has been found on your computer, see video sources", 30);
+    useVideoSources();
+}
+
 void
 VideoView::loadingFailed()
 {
@@ -782,7 +925,7 @@ VideoView::updateTitle()
     {
         //Show truncated part of video title in tab
         QString title_cut = full_title.mid(0, max_title) + "…"; // ...
-        if (m_vlc->isPlaying())
+        if (isPlaying())
         {
             //Slide animation
             //TODO animation disabled because tab size not fixed
@@ -824,9 +967,57 @@ VideoView::selectSource(int index)
     m_src_index = index;
     foreach (int i, m_src_acts.keys())
         m_src_acts[i]->setChecked(i == index);
+    //Player is created when the view is shown, it loads the selection then
+    if (!m_vlc) return;
+
+    //Saved position of this video (any source), unless a tab is restored
+    QUrl src_url = item["url"].toUrl();
+    m_resume_keys = ResumePositions::keysFor(m_src_address, src_url);
+    if (m_restore_time <= 0 && m_vlc->time() <= 0)
+    {
+        m_restore_time = ResumePositions::globalInstance()->position(m_resume_keys);
+        m_restore_source = src_url;
+    }
+
+    //Continue where it was before (seek by media option, no decoding from 0)
+    if (m_restore_time > 0 && src_url == m_restore_source)
+    {
+        m_vlc->setStartTime(m_restore_time);
+        m_restore_time = 0;
+    }
+
     //Start playback
     //NOTE loading again may cause a new VLC window to pop up
-    m_vlc->load(v_url.toUrl());
+    //A file that is still being downloaded is played through its partial file,
+    //the download is the playback stream now
+    QUrl url = v_url.toUrl();
+    QSharedPointer<PartialFile> partial;
+    if (url.isLocalFile())
+        partial = m_storage->partialFile(url.toLocalFile());
+    if (partial && !partial->isFinished())
+    {
+        m_vlc->load(partial);
+        m_storage->setDownloadPriority(DownloadManager::Playback);
+    }
+    else if (isAdaptiveStream(item))
+    {
+        //HLS: libvlc fetches the segments, the rendition is chosen by throughput
+        //"rate" starts low (no estimate yet) and goes up as segments arrive fast enough
+        QString logic = ProfileSettings::profile()->setDefaultVariant("hls_adaptive_logic", "rate").toString();
+        if (!logic.isEmpty())
+            m_vlc->addMediaOption(":adaptive-logic=" + logic);
+        m_vlc->load(url);
+    }
+    else if ((url.scheme() == "http" || url.scheme() == "https") &&
+        ProfileSettings::profile()->setDefaultVariant("stream_cache", true).toBool())
+    {
+        //Streamed through the local cache, an import won't download it again
+        m_vlc->load(CacheProxy::globalInstance()->proxyUrl(url));
+    }
+    else
+    {
+        m_vlc->load(url);
+    }
     if (m_play_on_select)
         m_vlc->play();
 
@@ -835,7 +1026,9 @@ VideoView::selectSource(int index)
 void
 VideoView::selectSource(QAction *action)
 {
+    //Picked in the menu, not replaced by the ranking
     int i = action->property("i").toInt();
+    m_src_user_selected = true;
     selectSource(i);
 }
 
@@ -846,6 +1039,83 @@ VideoView::selectSource()
     if (action) selectSource(action);
 }
 
+void
+VideoView::sourcesRanked(const QList<QUrl> &order)
+{
+    m_src_order = order;
+
+    //Show expected start time in the sources menu
+    foreach (int i, m_src_acts.keys())
+    {
+        if (!m_src_acts[i] || i >= m_video_items.count()) continue;
+        QString label = m_src_acts[i]->property("label").toString();
+        qint64 start = m_ranker->expectedStart(m_video_items[i].value("url").toUrl());
+        if (start > 0)
+            label += QString(" (~%1 s)").arg(start / 1000.0, 0, 'f', 1);
+        else if (start < 0)
+            label += " " + tr("(unreachable)");
+        m_src_acts[i]->setText(label);
+    }
+
+    //Select the best source, unless one has been chosen (or restored) already
+    if (order.isEmpty() || isPlaying() || m_src_user_selected || m_src_ready_selected) return;
+    if (m_restore_time > 0 && indexOfSourceItem(m_restore_source) >= 0) return;
+    int index = indexOfSourceItem(order.first());
+    if (index >= 0 && index != m_src_index)
+        selectSource(index);
+}
+
+void
+VideoView::sourceReady(const QUrl &url)
+{
+    int index = indexOfSourceItem(url);
+    if (index < 0 || isPlaying() || m_src_user_selected) return;
+    if (m_restore_time > 0 && indexOfSourceItem(m_restore_source) >= 0) return;
+    m_src_ready_selected = true;
+    if (index != m_src_index)
+        selectSource(index);
+}
+
+void
+VideoView::handlePlaybackStall()
+{
+    if (!m_vlc || m_src_index < 0 || m_src_index >= m_video_items.count()) return;
+
+    //A local file waits for its download, another server wouldn't help
+    QUrl url = m_video_items[m_src_index].value("url").toUrl();
+    if (url.isLocalFile()) return;
+    if (!m_stalled_sources.contains(url)) m_stalled_sources << url;
+
+    //Next best source that hasn't stalled yet (site order if not ranked)
+    QList<QUrl> order = m_src_order;
+    for (int i = 0; i < m_video_items.count(); i++)
+    {
+        QUrl item_url = m_video_items[i].value("url").toUrl();
+        if (!order.contains(item_url)) order << item_url;
+    }
+    int next = -1;
+    foreach (const QUrl &next_url, order)
+    {
+        if (m_stalled_sources.contains(next_url)) continue;
+        next = indexOfSourceItem(next_url);
+        if (next >= 0) break;
+    }
+    if (next < 0)
+    {
+        m_notifications->showNotification("online", "Video source is not responding, no other source available", 10);
+        return;
+    }
+
+    //Continue at the same time on the other source
+    qInfo() << this << "source stalled, switching to" << next;
+    qint64 time = m_vlc->time();
+    m_restore_source = m_video_items[next].value("url").toUrl();
+    m_restore_time = time;
+    selectSource(next);
+    if (!m_play_on_select) m_vlc->play();
+    m_notifications->showNotification("online", "Video source is not responding, switched to another one", 10);
+}
+
 /**
  * Import video to local video storage (download location defined in profile).
  * When requested, what happens next depends on the available sources.
@@ -874,6 +1144,18 @@ VideoView::importVideo()
     QVariantMap src_item = m_video_items[m_src_index];
     QUrl url = src_item["url"].toUrl();
 
+    //A playlist (HLS) can't be downloaded as file, use a progressive version
+    if (isAdaptiveStream(src_item))
+    {
+        url.clear();
+        foreach (const QVariantMap &item, m_video_items)
+        {
+            if (isAdaptiveStream(item)) continue;
+            url = item["url"].toUrl();
+            break;
+        }
+    }
+
     //No action if download already in progress
     if (m_download_active)
     {
@@ -887,6 +1169,14 @@ VideoView::importVideo()
     //Schedule file to be imported when downloaded
     if (m_temp_file.isEmpty())
     {
+        //Only a playlist, the external downloader can fetch and merge the segments
+        if (url.isEmpty() && isAdaptiveStream(src_item) && !m_src_address.isEmpty())
+        {
+            m_storage->setDownloadPriority(DownloadManager::Background);
+            downloadExternally();
+            m_import_requested = true;
+            return;
+        }
         //Check if we have a remote file to be downloaded
         if (url.isEmpty() || url.isLocalFile())
         {
@@ -898,6 +1188,8 @@ VideoView::importVideo()
         m_notifications->showNotification("download", "Download requested...");
         QMessageBox::information(this, tr("Download"),
             tr("The video will be downloaded and imported. Do not close this video tab during the download."));
+        //Not played, must not slow down the stream that's being watched
+        m_storage->setDownloadPriority(DownloadManager::Background);
         downloadFile(url);
         m_import_requested = true;
         return;
@@ -921,6 +1213,12 @@ VideoView::importVideo()
 
 }
 
+bool
+VideoView::isAdaptiveStream(const QVariantMap &item)
+{
+    return item.value("hls").toBool() || item.value("url").toUrl().path().endsWith(".m3u8");
+}
+
 bool
 VideoView::isEmpty()
 {
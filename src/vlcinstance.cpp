@@ -0,0 +1,70 @@
+#include "vlcinstance.hpp"
+
+QMutex
+VlcInstance::m_mutex;
+
+QStringList
+VlcInstance::m_args;
+
+libvlc_instance_t*
+VlcInstance::m_instance = 0;
+
+int
+VlcInstance::m_refs = 0;
+
+void
+VlcInstance::setArguments(const QStringList &args)
+{
+    QMutexLocker locker(&m_mutex);
+    m_args = args;
+}
+
+QStringList
+VlcInstance::arguments()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_args;
+}
+
+libvlc_instance_t*
+VlcInstance::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_instance)
+    {
+        libvlc_retain(m_instance);
+        m_refs++;
+        return m_instance;
+    }
+
+    //Arguments must stay valid during libvlc_new()
+    QList<QByteArray> args_bytes;
+    foreach (QString arg, m_args)
+        args_bytes << arg.toLocal8Bit();
+    QVector<const char*> argv;
+    foreach (const QByteArray &arg, args_bytes)
+        argv << arg.constData();
+
+    m_instance = libvlc_new(argv.size(), argv.constData());
+    if (!m_instance)
+    {
+        qWarning() << "failed to load libvlc" << m_args;
+        return 0;
+    }
+    m_refs = 1;
+    qDebug() << "libvlc instance created" << m_args;
+    return m_instance;
+}
+
+void
+VlcInstance::release(libvlc_instance_t *instance)
+{
+    if (!instance) return;
+    QMutexLocker locker(&m_mutex);
+    libvlc_release(instance);
+    if (instance == m_instance && --m_refs == 0)
+    {
+        qDebug() << "libvlc instance released";
+        m_instance = 0;
+    }
+}
@@ -5,11 +5,25 @@ VlcPlayer::VlcPlayer(const QUrl &url, QWidget *parent)
            m_vlc_instance(0),
            m_vlc_player(0),
            m_vlc_media(0),
-           m_last_volume(0)
+           m_start_time(0),
+           m_media_serial(0),
+           m_position(0),
+           m_duration(0),
+           m_last_volume(0),
+           m_lbl_preview(0),
+           m_tmr_stall(new QTimer(this))
 {
+    //Restarted whenever the playback time changes
+    m_tmr_stall->setSingleShot(true);
+    m_tmr_stall->setInterval(0);
+    connect(m_tmr_stall, &QTimer::timeout, this, [this]()
+    {
+        qWarning() << "vlc player stalled" << m_url;
+        emit stalled();
+    });
 
-    // Initialize libVLC instance
-    m_vlc_instance = libvlc_new(0, 0); //0, NULL
+    // Acquire libVLC instance (shared by all players)
+    m_vlc_instance = VlcInstance::acquire();
     if (!m_vlc_instance)
     {
         QMessageBox::critical(this, tr("Cannot load video player"),
@@ -44,17 +58,15 @@ VlcPlayer::VlcPlayer(const QUrl &url, QWidget *parent)
     m_position_slider = new QSlider(Qt::Horizontal);
     m_position_slider->setMaximum(1000);
     connect(m_position_slider, SIGNAL(sliderMoved(int)), this, SLOT(setPosition(int)));
-    //TODO on (ctrl) hover show a second player in a tiny overlay window
+    //Hovering over the slider shows a frame from that time (if a preview exists)
+    m_position_slider->setMouseTracking(true);
+    m_position_slider->installEventFilter(this);
     m_lbl_position = new QLabel;
     m_lbl_duration = new QLabel;
     hbox_position->addWidget(m_lbl_position);
     hbox_position->addWidget(m_position_slider);
     hbox_position->addWidget(m_lbl_duration);
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateInterface()));
-    timer->start(100);
-
     m_video_widget = new QWidget;
     m_video_widget->setAutoFillBackground(true);
     QPalette palette = m_video_widget->palette();
@@ -70,6 +82,7 @@ VlcPlayer::VlcPlayer(const QUrl &url, QWidget *parent)
 
     // Initialize VLC player
     m_vlc_player = libvlc_media_player_new(m_vlc_instance);
+    attachEvents();
     // Integrate VLC player into interface, display video in video widget
     integrateWidget();
 
@@ -78,18 +91,57 @@ VlcPlayer::VlcPlayer(const QUrl &url, QWidget *parent)
 }
 
 VlcPlayer::VlcPlayer(const VlcPlayer &other, QWidget *parent)
-         : VlcPlayer(other.m_url, parent)
+         : VlcPlayer(QUrl(), parent)
 {
-    double pos = other.position();
-    if (pos > 0) setPosition(pos);
+    //Continue where the other player is (it may not be playing, can't seek)
+    qint64 time = other.time();
+    if (time > 0) setStartTime(time);
+    if (other.m_stream)
+        load(other.m_stream);
+    else if (!other.m_url.isEmpty())
+        load(other.m_url);
 }
 
 VlcPlayer::~VlcPlayer()
 {
+    //No more events, a callback may not be running while the player goes away
+    detachEvents();
     stop();
     libvlc_media_player_release(m_vlc_player);
     m_vlc_player = 0;
-    if (m_vlc_instance) libvlc_release(m_vlc_instance);
+    VlcInstance::release(m_vlc_instance);
+}
+
+qint64
+VlcPlayer::time() const
+{
+    if (!m_vlc_player) return -1;
+    return libvlc_media_player_get_time(m_vlc_player);
+}
+
+void
+VlcPlayer::setStartTime(qint64 time)
+{
+    m_start_time = time;
+}
+
+void
+VlcPlayer::addMediaOption(const QString &option)
+{
+    m_media_options << option;
+}
+
+qint64
+VlcPlayer::duration() const
+{
+    return m_duration;
+}
+
+void
+VlcPlayer::setStallTimeout(int timeout)
+{
+    m_tmr_stall->stop();
+    m_tmr_stall->setInterval(timeout);
 }
 
 bool
@@ -111,17 +163,52 @@ void
 VlcPlayer::load(const QUrl &url)
 {
     if (isPlaying()) stop();
+    releaseStream();
     m_url = url;
 
     // Load media
     QByteArray url_bytes = url.url().toUtf8();
-    m_vlc_media = libvlc_media_new_location(m_vlc_instance, url_bytes.constData());
+    setMedia(libvlc_media_new_location(m_vlc_instance, url_bytes.constData()));
+
+    //Previews are generated for complete local files only
+    m_preview_file = url.isLocalFile() ? url.toLocalFile() : QString();
+    if (!m_preview_file.isEmpty())
+        SeekPreviews::globalInstance()->request(m_preview_file);
+
+}
+
+void
+VlcPlayer::load(QSharedPointer<PartialFile> stream)
+{
+    if (isPlaying()) stop();
+    releaseStream();
+    m_stream = stream;
+    m_url = QUrl::fromLocalFile(stream->filePath());
+    m_preview_file = stream->filePath(); //requested when the download is complete
+
+    // Load media, read through callbacks (file is still being downloaded)
+    setMedia(libvlc_media_new_callbacks(m_vlc_instance,
+        PartialFile::vlcOpen, PartialFile::vlcRead, PartialFile::vlcSeek, PartialFile::vlcClose,
+        stream.data()));
+
+}
+
+void
+VlcPlayer::setMedia(libvlc_media_t *media)
+{
+    if (m_vlc_media) libvlc_media_release(m_vlc_media);
+    m_vlc_media = media;
+    //Events of the previous media may still be queued
+    m_media_serial.ref();
+    m_position = 0;
+    m_duration = 0;
     if (!m_vlc_media)
     {
         QMessageBox::critical(this, tr("Cannot load video"),
             tr("Failed to load video."));
         return;
     }
+    applyMediaOptions();
 
     // Load media in player
     if (m_vlc_player)
@@ -132,6 +219,7 @@ VlcPlayer::load(const QUrl &url)
     {
         // Initialize player
         m_vlc_player = libvlc_media_player_new_from_media(m_vlc_media);
+        attachEvents();
 
         // Integrate VLC player into interface, display video in video widget
         integrateWidget();
@@ -141,6 +229,29 @@ VlcPlayer::load(const QUrl &url)
 
 }
 
+void
+VlcPlayer::applyMediaOptions()
+{
+    //Start time is a media option, the player can't seek before playback has started
+    if (m_start_time > 0)
+        m_media_options << QString(":start-time=%1").arg(m_start_time / 1000.0, 0, 'f', 3);
+    foreach (const QString &option, m_media_options)
+        libvlc_media_add_option(m_vlc_media, option.toUtf8().constData());
+    m_media_options.clear();
+    m_start_time = 0;
+}
+
+void
+VlcPlayer::releaseStream()
+{
+    //The input thread may be waiting for data, wake it up
+    //before stopping, otherwise stop would wait forever
+    if (!m_stream) return;
+    m_stream->interruptReaders();
+    if (m_vlc_player) libvlc_media_player_stop(m_vlc_player);
+    m_stream.clear();
+}
+
 void
 VlcPlayer::integrateWidget()
 {
@@ -170,6 +281,7 @@ VlcPlayer::play()
         // Pause
         libvlc_media_player_pause(m_vlc_player);
         m_btn_play->setText("Play");
+        m_tmr_stall->stop();
     }
     else
     {
@@ -196,6 +308,7 @@ VlcPlayer::stop()
     if (!m_vlc_player) return;
 
     //libvlc_media_player_stop_async(_vlc_player); // NOT DECLARED
+    if (m_stream) m_stream->interruptReaders();
     libvlc_media_player_stop(m_vlc_player);
 
     // Release media
@@ -204,6 +317,10 @@ VlcPlayer::stop()
         libvlc_media_release(m_vlc_media);
         m_vlc_media = 0;
     }
+    m_media_serial.ref();
+    m_position = 0;
+    m_duration = 0;
+    m_tmr_stall->stop();
 
     m_position_slider->setValue(0);
     m_btn_play->setText(tr("Play"));
@@ -211,6 +328,7 @@ VlcPlayer::stop()
     m_lbl_position->setText("");
     m_lbl_duration->setText("");
 
+    emit playingChanged(false);
     emit stopped();
 }
 
@@ -265,20 +383,18 @@ VlcPlayer::setPosition(int position)
 void
 VlcPlayer::updateInterface()
 {
-    if (!m_vlc_player) return;
+    //Hidden (background tab), updated when it's shown again
+    if (!m_vlc_player || !isVisible()) return;
 
-    float pos = libvlc_media_player_get_position(m_vlc_player);
-    int slider_pos = (int)(pos * 1000.0);
-    if (m_position_slider->value() != slider_pos)
+    int slider_pos = (int)(m_position * 1000.0);
+    if (m_position_slider->value() != slider_pos || m_lbl_duration->text().isEmpty())
     {
         //Update position slider
         m_position_slider->setValue(slider_pos);
 
         //Update position text
-        qint64 duration = 0;
-        if (m_vlc_media)
-            duration = libvlc_media_get_duration(m_vlc_media) / (qint64)1000;
-        qint64 est_pos = (float)duration * pos;
+        qint64 duration = m_duration / 1000;
+        qint64 est_pos = (float)duration * m_position;
         QString pos_str = QDateTime::fromTime_t(est_pos).toUTC().toString("hh:mm:ss");
         QString dur_str = QDateTime::fromTime_t(duration).toUTC().toString("hh:mm:ss");
         m_position_slider->setToolTip(QString("%1/%2").arg(pos_str).arg(dur_str));
@@ -287,8 +403,156 @@ VlcPlayer::updateInterface()
 
     }
 
-    if (libvlc_media_player_get_state(m_vlc_player) == libvlc_Stopped)
-        stop();
+}
 
+void
+VlcPlayer::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    updateInterface();
+}
+
+bool
+VlcPlayer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_position_slider)
+    {
+        if (event->type() == QEvent::MouseMove)
+            showSeekPreview(static_cast<QMouseEvent*>(event)->pos().x());
+        else if (event->type() == QEvent::Leave || event->type() == QEvent::Hide)
+            if (m_lbl_preview) m_lbl_preview->hide();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void
+VlcPlayer::showSeekPreview(int x)
+{
+    if (m_preview_file.isEmpty() || m_duration <= 0) return;
+    int value = QStyle::sliderValueFromPosition(m_position_slider->minimum(), m_position_slider->maximum(),
+        x, m_position_slider->width());
+    qint64 time = m_duration * value / m_position_slider->maximum();
+    QImage frame = SeekPreviews::globalInstance()->frameAt(m_preview_file, time);
+    if (frame.isNull())
+    {
+        if (m_lbl_preview) m_lbl_preview->hide();
+        return;
+    }
+
+    //Time of the frame in the corner
+    QString time_str = QDateTime::fromTime_t(time / 1000).toUTC().toString("hh:mm:ss");
+    QPainter painter(&frame);
+    QRect text_rect = painter.fontMetrics().boundingRect(time_str).adjusted(-3, -1, 3, 1);
+    text_rect.moveBottomRight(frame.rect().bottomRight() - QPoint(2, 2));
+    painter.fillRect(text_rect, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    painter.drawText(text_rect, Qt::AlignCenter, time_str);
+    painter.end();
+
+    if (!m_lbl_preview)
+    {
+        m_lbl_preview = new QLabel(this, Qt::ToolTip);
+        m_lbl_preview->setAttribute(Qt::WA_TransparentForMouseEvents);
+    }
+    m_lbl_preview->setPixmap(QPixmap::fromImage(frame));
+    m_lbl_preview->resize(frame.size());
+    QPoint pos = m_position_slider->mapToGlobal(QPoint(x - frame.width() / 2, -frame.height() - 4));
+    m_lbl_preview->move(pos);
+    m_lbl_preview->show();
+}
+
+void
+VlcPlayer::attachEvents()
+{
+    if (!m_vlc_player) return;
+    libvlc_event_manager_t *events = libvlc_media_player_event_manager(m_vlc_player);
+    foreach (int type, playerEventTypes())
+        libvlc_event_attach(events, type, vlcEvent, this);
+}
+
+void
+VlcPlayer::detachEvents()
+{
+    if (!m_vlc_player) return;
+    libvlc_event_manager_t *events = libvlc_media_player_event_manager(m_vlc_player);
+    foreach (int type, playerEventTypes())
+        libvlc_event_detach(events, type, vlcEvent, this);
+}
+
+QList<int>
+VlcPlayer::playerEventTypes()
+{
+    QList<int> types;
+    types << libvlc_MediaPlayerPositionChanged << libvlc_MediaPlayerLengthChanged;
+    types << libvlc_MediaPlayerTimeChanged;
+    types << libvlc_MediaPlayerPlaying << libvlc_MediaPlayerPaused;
+    types << libvlc_MediaPlayerEndReached << libvlc_MediaPlayerEncounteredError;
+    return types;
+}
+
+void
+VlcPlayer::vlcEvent(const libvlc_event_t *event, void *opaque)
+{
+    //Called in a libvlc thread, handled in the GUI thread
+    //The event is dropped if the player is deleted in the meantime
+    VlcPlayer *player = static_cast<VlcPlayer*>(opaque);
+    int serial = player->m_media_serial.loadRelaxed();
+    int type = event->type;
+    double position = 0;
+    qint64 ms = 0;
+    if (type == libvlc_MediaPlayerPositionChanged)
+        position = event->u.media_player_position_changed.new_position;
+    else if (type == libvlc_MediaPlayerLengthChanged)
+        ms = event->u.media_player_length_changed.new_length;
+    else if (type == libvlc_MediaPlayerTimeChanged)
+        ms = event->u.media_player_time_changed.new_time;
+
+    QMetaObject::invokeMethod(player, [player, serial, type, position, ms]()
+    {
+        player->handleEvent(serial, type, position, ms);
+    }, Qt::QueuedConnection);
+}
+
+void
+VlcPlayer::handleEvent(int serial, int type, double position, qint64 ms)
+{
+    //Event of a previous media (loaded another video since)
+    if (serial != m_media_serial.loadRelaxed()) return;
+
+    switch (type)
+    {
+    case libvlc_MediaPlayerPositionChanged:
+        m_position = position;
+        updateInterface();
+        break;
+    case libvlc_MediaPlayerLengthChanged:
+        m_duration = ms;
+        updateInterface();
+        break;
+    case libvlc_MediaPlayerTimeChanged:
+        if (m_tmr_stall->isActive()) m_tmr_stall->start();
+        emit timeChanged(ms);
+        break;
+    case libvlc_MediaPlayerPlaying:
+        m_btn_play->setText(tr("Pause"));
+        //Progress is expected from now on, opening the media may take longer
+        if (m_tmr_stall->interval() > 0) m_tmr_stall->start();
+        emit playingChanged(true);
+        break;
+    case libvlc_MediaPlayerPaused:
+        m_btn_play->setText(tr("Play"));
+        m_tmr_stall->stop();
+        emit playingChanged(false);
+        break;
+    case libvlc_MediaPlayerEncounteredError:
+        qWarning() << "vlc player error" << m_url;
+        m_tmr_stall->stop();
+        emit failed();
+        stop();
+        break;
+    case libvlc_MediaPlayerEndReached:
+        stop();
+        break;
+    }
 }
 
@@ -51,6 +51,12 @@ ActionContext::setValue(const QVariant &value)
     emit gotResult(value, ActionContextRef(this));
 }
 
+void
+ActionContext::setError()
+{
+    emit gotError(ActionContextRef(this));
+}
+
 QByteArray
 VSiteBase::encodeJson(const QVariant &var, bool *ok)
 {
@@ -224,6 +230,9 @@ VSite::load(const QString &address, QObject *parent)
 //    timeout_timer->setInterval(2000);
 //    timeout_timer->start();
 //    connect(timeout_timer, SIGNAL(timeout()), SLOT(checkTimeouts()));
+
+    //Pages scrolled past are dropped by the view, loaded again from here
+    _page_cache.setMaxCost(5000);
 //
 //}
 //
@@ -558,7 +567,8 @@ VSite::loadChannelVideos(int index)
     if (index >= 0)
         _page_o = index;
     _get_action = "get_channel_videos"; // remember type of search query
-    callWhenReady("get_channel_videos");
+    ActionContextPtr ctx = callWhenReady("get_channel_videos");
+    if (ctx) ctx->map["page"] = _page_o;
 }
 
 void
@@ -572,7 +582,58 @@ VSite::loadVideos(int index)
         qWarning() << "cannot load video list: no search defined";
         return;
     }
-    callWhenReady(get_action);
+    ActionContextPtr ctx = callWhenReady(get_action);
+    if (ctx) ctx->map["page"] = _page_o;
+}
+
+void
+VSite::loadVideoPage(int index)
+{
+    QString get_action = _get_action;
+    if (get_action.isEmpty() || index < 0)
+    {
+        qWarning() << "cannot load video page: no search defined";
+        return;
+    }
+
+    //Recently loaded page, no request (scrolled back to an evicted page)
+    QString key = pageCacheKey(get_action, index);
+    CachedPage *cached = _page_cache.object(key);
+    int max_age = ProfileSettings::profile()->setDefaultVariant("page_cache_minutes", 15).toInt() * 60 * 1000;
+    if (cached && QDateTime::currentMSecsSinceEpoch() - cached->time < max_age)
+    {
+        QVariantList items = cached->items;
+        QTimer::singleShot(0, this, [this, index, items]()
+        {
+            emit loadedVideoPage(index, items);
+        });
+        return;
+    }
+
+    //Page variables override the ones of the cursor (pageOffset())
+    ActionContextPtr ctx = callWhenReady(get_action, pageVariables(index));
+    if (!ctx) return;
+    ctx->map["page"] = index;
+    ctx->map["page_request"] = true;
+}
+
+ActionContextPtr
+VSite::loadChannelVideosSince(qint64 since, int index)
+{
+    //SINCE (unix time) and SINCE_DATE (ISO) are optional plan variables,
+    //plans that don't use them return the whole page
+    QVariantMap params = pageVariables(index);
+    if (since > 0)
+    {
+        params["SINCE"] = since / 1000;
+        params["SINCE_DATE"] = QDateTime::fromMSecsSinceEpoch(since, Qt::UTC).toString(Qt::ISODateWithMs);
+    }
+    ActionContextPtr ctx = callWhenReady("get_channel_videos", params);
+    if (!ctx) return ctx;
+    ctx->map["page"] = index;
+    ctx->map["page_request"] = true;
+    ctx->map["since"] = since;
+    return ctx;
 }
 
 void
@@ -583,12 +644,12 @@ VSite::loadThumbnail(const QString &url, QObject *obj)
     {
         req_url = siteUrl().resolved(QUrl(url));
     }
-    QNetworkRequest req(req_url);
-    req.setOriginatingObject(obj);
-    QNetworkReply *reply = _net->get(req);
-    reply->setProperty("name", "get_thumbnail");
-    //TODO add action?
-    connect(reply, SIGNAL(finished()), SLOT(parseReply()));
+    //Shared thumbnail cache, no download if it's been loaded before
+    QPointer<QObject> obj_ptr(obj);
+    ThumbnailCache::globalInstance()->load(req_url, this, [this, obj_ptr](const QImage &image)
+    {
+        if (obj_ptr) emit loadedThumbnail(QPixmap::fromImage(image), obj_ptr);
+    });
 }
 
 /**
@@ -649,6 +710,14 @@ VSite::actionResult(ActionContextPtr ctx, const QVariant &var)
     //not any sub result of previous steps
     ctx->map["value"] = var;
 
+    //Every video list returned by the site goes into the catalog (search)
+    if (action == "get_channel_videos" && var.canConvert<QVariantList>())
+    {
+        QString channel_title = _vars.value("CHANNEL").toMap().value("title").toString();
+        if (channel_title.isEmpty()) channel_title = currentChannel();
+        VideoCatalog::globalInstance()->addItems(siteUrl(), channel_title, var.toList());
+    }
+
     //If enabled (by action initiator, view), result signal is sent via ctx,
     //not to all listeners of site instance.
     //finished is emitted after the last action before ctx goes out of scope
@@ -669,6 +738,22 @@ VSite::actionResult(ActionContextPtr ctx, const QVariant &var)
             emit gotChannelInfo(var.toMap());
         else
             emit gotChannelName(var.toString());
+    else if (ctx->map.contains("page") && var.canConvert<QVariantList>())
+    {
+        //Video list page, kept in the response cache (unless it's filtered)
+        int page = ctx->map["page"].toInt();
+        QVariantList items = var.toList();
+        if (!ctx->map.contains("since"))
+        {
+            CachedPage *cached = new CachedPage;
+            cached->items = items;
+            cached->time = QDateTime::currentMSecsSinceEpoch();
+            _page_cache.insert(pageCacheKey(action, page), cached, qMax(1, items.size()));
+        }
+        emit loadedVideoPage(page, items);
+        if (!ctx->map["page_request"].toBool() && action == "get_channel_videos")
+            emit loadedVideoList(items);
+    }
     else if (action == "get_channel_videos")
         if (var.canConvert<QVariantList>())
             emit loadedVideoList(var.toList());
@@ -746,6 +831,12 @@ VSite::handleError(const ActionContextPtr ctx)
     _act_active.removeAll(ctx);
 }
 
+void
+VSite::handleError(const ActionContextRef ref)
+{
+    handleError(getPendingActCtx(ref));
+}
+
 void
 VSite::parseReply(QNetworkReply *reply)
 {
@@ -1274,6 +1365,10 @@ VSite::actShowPage(const ActionContextPtr &ctx, bool &ok)
     connect(ctx.data(),
         SIGNAL(gotResult(QVariant, ActionContextRef)),
         SLOT(handleResult(QVariant, ActionContextRef)));
+    //Or ctx->setError() if the page cannot be shown, the action fails right away
+    connect(ctx.data(),
+        SIGNAL(gotError(ActionContextRef)),
+        SLOT(handleError(ActionContextRef)));
 
     return true;
 }
@@ -1786,10 +1881,9 @@ VSite::globalVariables()
     vars["URL"] = siteUrl().url();
     vars["DOMAIN"] = domain();
     // channel set by setChannel()
-    vars["PAGE_INDEX"] = pageOffset();
-    vars["PAGE_NUMBER"] = pageOffset() + 1;
-    vars["PAGE_SIZE"] = pageSize();
-    vars["PAGE_OFFSET"] = pageOffset() * pageSize();
+    QVariantMap page_vars = pageVariables(pageOffset());
+    foreach (QString k, page_vars.keys())
+        vars[k] = page_vars[k];
     qDebug() << this << "initializing global VARS" << _vars;
 
     QUrl api_url = siteUrl();
@@ -1823,6 +1917,23 @@ VSite::globalVariables()
     return vars;
 }
 
+QVariantMap
+VSite::pageVariables(int index)
+{
+    QVariantMap vars;
+    vars["PAGE_INDEX"] = index;
+    vars["PAGE_NUMBER"] = index + 1;
+    vars["PAGE_SIZE"] = pageSize();
+    vars["PAGE_OFFSET"] = index * pageSize();
+    return vars;
+}
+
+QString
+VSite::pageCacheKey(const QString &action, int index)
+{
+    return QString("%1|%2|%3|%4").arg(action).arg(_channel).arg(pageSize()).arg(index);
+}
+
 VSite*
 VSite::getOrCreateControlInstance()
 {